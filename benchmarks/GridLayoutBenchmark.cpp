@@ -0,0 +1,90 @@
+// Compares the speed of a step for every grid layout on wide and tall worlds.
+// Usage: GridLayoutBenchmark [cells] [steps]
+#include "snaps/Grid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+// Walls around the world, a floor of terrain every 32 rows and randomly scattered sand.
+void FillWorld(snaps::Grid& grid) {
+    const auto put = [&grid](const int x, const int y, const bool isDynamic) {
+        grid.At(x, y) = snaps::Block {
+            .WorldPosition = {static_cast<float>(x * snaps::BLOCK_SIZE), static_cast<float>(y * snaps::BLOCK_SIZE)},
+            .IsDynamic = isDynamic
+        };
+    };
+    for (int x = 0; x < grid.Width(); x++) {
+        for (int y = 0; y < grid.Height(); y += 32) {
+            put(x, y, false);
+        }
+        put(x, grid.Height() - 1, false);
+    }
+    for (int y = 0; y < grid.Height(); y++) {
+        put(0, y, false);
+        put(grid.Width() - 1, y, false);
+    }
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (int y = 1; y < grid.Height() - 1; y++) {
+        for (int x = 1; x < grid.Width() - 1; x++) {
+            if (not grid.IsOccupied(x, y) and percent(random) < 30) put(x, y, true);
+        }
+    }
+}
+
+double MeasureMillisecondsPerStep(const int width, const int height, const int steps, const snaps::GridLayout layout) {
+    snaps::Grid grid(width, height, layout);
+    snaps::SnapsEngine engine(grid);
+    FillWorld(grid);
+
+    engine.Step(DELTA_TIME); // Warm up
+    const auto start = std::chrono::steady_clock::now();
+    engine.StepN(steps, DELTA_TIME);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / steps;
+}
+
+const char* GetName(const snaps::GridLayout layout) {
+    switch (layout) {
+        case snaps::GridLayout::RowMajor: return "row-major";
+        case snaps::GridLayout::Tiled: return "tiled";
+        case snaps::GridLayout::Morton: return "morton";
+    }
+    return "?";
+}
+}
+
+int main(const int argc, char** argv) {
+    const int cells = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    struct Shape {
+        const char* Name;
+        int Width;
+        int Height;
+    };
+    const Shape shapes[] = {
+        {"wide", cells / 128, 128},
+        {"square", static_cast<int>(std::sqrt(cells)), static_cast<int>(std::sqrt(cells))},
+        {"tall", 128, cells / 128},
+    };
+
+    std::printf("%d cells, %d steps\n\n", cells, steps);
+    std::printf("%-8s %12s %-10s %10s %8s\n", "shape", "size", "layout", "ms/step", "speedup");
+    for (const Shape& shape : shapes) {
+        double rowMajor = 0.0;
+        for (const snaps::GridLayout layout : {snaps::GridLayout::RowMajor, snaps::GridLayout::Tiled, snaps::GridLayout::Morton}) {
+            const double milliseconds = MeasureMillisecondsPerStep(shape.Width, shape.Height, steps, layout);
+            if (layout == snaps::GridLayout::RowMajor) rowMajor = milliseconds;
+            std::printf("%-8s %5dx%-6d %-10s %10.3f %8.2f\n", shape.Name, shape.Width, shape.Height, GetName(layout), milliseconds, rowMajor / milliseconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Measures how the parallel step scales with the number of threads.
+// Usage: ThreadScalingBenchmark [width] [height] [steps]
+#include "snaps/Grid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+// Walls around the world and randomly scattered sand, so that every chunk has something falling.
+void FillWorld(snaps::Grid& grid) {
+    const auto put = [&grid](const int x, const int y, const bool isDynamic) {
+        grid.At(x, y) = snaps::Block {
+            .WorldPosition = {static_cast<float>(x * snaps::BLOCK_SIZE), static_cast<float>(y * snaps::BLOCK_SIZE)},
+            .IsDynamic = isDynamic
+        };
+    };
+    for (int x = 0; x < grid.Width(); x++) {
+        put(x, 0, false);
+        put(x, grid.Height() - 1, false);
+    }
+    for (int y = 0; y < grid.Height(); y++) {
+        put(0, y, false);
+        put(grid.Width() - 1, y, false);
+    }
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (int y = 1; y < grid.Height() - 1; y++) {
+        for (int x = 1; x < grid.Width() - 1; x++) {
+            if (percent(random) < 30) put(x, y, true);
+        }
+    }
+}
+
+double MeasureMillisecondsPerStep(const int width, const int height, const int steps, const bool parallel, const int threadCount) {
+    snaps::Grid grid(width, height);
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().ParallelStep = parallel;
+    engine.GetConfig().ThreadCount = threadCount;
+    FillWorld(grid);
+
+    engine.Step(DELTA_TIME); // Warm up, starts the worker threads.
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) {
+        engine.Step(DELTA_TIME);
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / steps;
+}
+}
+
+int main(const int argc, char** argv) {
+    const int width = argc > 1 ? std::atoi(argv[1]) : 1024;
+    const int height = argc > 2 ? std::atoi(argv[2]) : 1024;
+    const int steps = argc > 3 ? std::atoi(argv[3]) : 100;
+    const int maxThreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+
+    std::printf("Grid %dx%d, %d steps, %d hardware threads\n\n", width, height, steps, maxThreads);
+    std::printf("%-10s %8s %10s %8s\n", "mode", "threads", "ms/step", "speedup");
+
+    const double serial = MeasureMillisecondsPerStep(width, height, steps, false, 1);
+    std::printf("%-10s %8d %10.3f %8.2f\n", "serial", 1, serial, 1.0);
+
+    for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        const double parallel = MeasureMillisecondsPerStep(width, height, steps, true, threadCount);
+        std::printf("%-10s %8d %10.3f %8.2f\n", "parallel", threadCount, parallel, serial / parallel);
+    }
+    return 0;
+}
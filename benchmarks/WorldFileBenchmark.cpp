@@ -0,0 +1,88 @@
+// Compares the cold start of a world built block by block with one loaded from a world file.
+// Usage: WorldFileBenchmark [size] [path]
+// The file is read back right after saving, so it's likely in the page cache. Drop the cache
+// between saving and loading (e.g. `echo 3 > /proc/sys/vm/drop_caches`) to include the disk.
+#include "snaps/Grid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include "snaps/WorldFile.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Walls around the world, a floor of terrain every 32 rows and randomly scattered sand.
+void FillWorld(snaps::Grid& grid) {
+    const auto put = [&grid](const int x, const int y, const bool isDynamic) {
+        grid.At(x, y) = snaps::Block {
+            .WorldPosition = {static_cast<float>(x * snaps::BLOCK_SIZE), static_cast<float>(y * snaps::BLOCK_SIZE)},
+            .IsDynamic = isDynamic
+        };
+    };
+    for (int x = 0; x < grid.Width(); x++) {
+        for (int y = 0; y < grid.Height(); y += 32) {
+            put(x, y, false);
+        }
+        put(x, grid.Height() - 1, false);
+    }
+    for (int y = 0; y < grid.Height(); y++) {
+        put(0, y, false);
+        put(grid.Width() - 1, y, false);
+    }
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (int y = 1; y < grid.Height() - 1; y++) {
+        for (int x = 1; x < grid.Width() - 1; x++) {
+            if (not grid.IsOccupied(x, y) and percent(random) < 30) put(x, y, true);
+        }
+    }
+}
+}
+
+int main(const int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    const std::filesystem::path path = argc > 2 ? argv[2] : std::filesystem::temp_directory_path() / "WorldFileBenchmark.world";
+
+    auto start = Clock::now();
+    snaps::Grid built(size, size);
+    FillWorld(built);
+    const double buildTime = MillisecondsSince(start);
+
+    start = Clock::now();
+    if (not snaps::WorldFile::Save(built, path)) {
+        std::printf("Can't write %s\n", path.string().c_str());
+        return 1;
+    }
+    const double saveTime = MillisecondsSince(start);
+
+    start = Clock::now();
+    std::optional<snaps::Grid> loaded = snaps::WorldFile::Load(path);
+    const double loadTime = MillisecondsSince(start);
+    if (not loaded) {
+        std::printf("Can't read %s\n", path.string().c_str());
+        return 1;
+    }
+
+    start = Clock::now();
+    snaps::SnapsEngine(*loaded).Step(DELTA_TIME);
+    const double firstStepTime = MillisecondsSince(start);
+
+    std::printf("%dx%d world, %zu blocks, %.1f MB file\n\n", size, size, loaded->BlockCount(),
+                static_cast<double>(std::filesystem::file_size(path)) / (1 << 20));
+    std::printf("%-24s %10.1f ms\n", "build with At()", buildTime);
+    std::printf("%-24s %10.1f ms\n", "save", saveTime);
+    std::printf("%-24s %10.1f ms\n", "load (cold start)", loadTime);
+    std::printf("%-24s %10.1f ms\n", "first step after load", firstStepTime);
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "Material.hpp"
 #include <raylib.h>
 #include <raymath.h>
 #include <iostream>
@@ -7,16 +8,18 @@ namespace snaps {
 
 constexpr int BLOCK_SIZE = 16;
 
+// Longest distance a block travels in a single step, in cells. Faster blocks are slowed down to this
+// speed, so their velocity always matches how far they move. A block that reaches further than the
+// next cell is swept through every cell on its way, so it stops at the first occupied one.
+constexpr int MAX_CELLS_PER_STEP = 16;
+
 struct Block {
     Vector2 WorldPosition = {0, 0};
     Vector2 Velocity = {0, 0};
-    Color FillColor = PINK;
+    MaterialId Material = MaterialTable::DEFAULT; // Mass, friction, color etc. See Grid::Materials()
     bool IsDynamic = false;
 
-    float InvMass = 0.5f;
     Vector2 ForceAccum = {0, 0};
-    float Friction = 1.0f;
-    float GravityScale = 1.0f;
 
     // ----- Read only -----
 
@@ -25,22 +28,96 @@ struct Block {
 
     // Set during a physics step. All bodies that have moved need collision resolution.
     bool NeedsCollisionResolution = false;
+
+    // Set when the block has been resting for a while. Sleeping blocks are not simulated until a cell
+    // next to them changes or the block is accessed through Grid::At (e.g. to apply an impulse).
+    bool IsSleeping = false;
+};
+
+/**
+ * Mutable view of a block stored inside a Grid. Every member refers to a separate storage array,
+ * so reading or writing a field touches only the memory of that field.
+ * The view follows the block when it moves to another cell and is invalidated when the block is removed.
+ */
+struct BlockRef {
+    Vector2& WorldPosition;
+    Vector2& Velocity;
+    MaterialId& Material;
+    bool& IsDynamic;
+
+    Vector2& ForceAccum;
+
+    Vector2& Acceleration;
+    bool& NeedsCollisionResolution;
+    bool& IsSleeping;
+
+    // Materials of the grid that holds the block.
+    const MaterialTable& Materials;
+
+    BlockRef(Vector2& worldPosition, Vector2& velocity, MaterialId& material, bool& isDynamic, Vector2& forceAccum,
+             Vector2& acceleration, bool& needsCollisionResolution, bool& isSleeping, const MaterialTable& materials)
+        : WorldPosition(worldPosition), Velocity(velocity), Material(material), IsDynamic(isDynamic),
+          ForceAccum(forceAccum), Acceleration(acceleration), NeedsCollisionResolution(needsCollisionResolution),
+          IsSleeping(isSleeping), Materials(materials) {}
+
+    // Copies refer to the same block, the assignment below is the one that copies values.
+    BlockRef(const BlockRef&) = default;
+
+    const snaps::Material& GetMaterial() const { return Materials[Material]; }
+
+    // Assignment copies the values, just like assigning to a `Block&` would.
+    BlockRef& operator=(const BlockRef& other) {
+        return *this = static_cast<Block>(other);
+    }
+
+    BlockRef& operator=(const Block& block) {
+        WorldPosition = block.WorldPosition;
+        Velocity = block.Velocity;
+        Material = block.Material;
+        IsDynamic = block.IsDynamic;
+        ForceAccum = block.ForceAccum;
+        Acceleration = block.Acceleration;
+        NeedsCollisionResolution = block.NeedsCollisionResolution;
+        IsSleeping = block.IsSleeping;
+        return *this;
+    }
+
+    operator Block() const {
+        return Block {
+            .WorldPosition = WorldPosition,
+            .Velocity = Velocity,
+            .Material = Material,
+            .IsDynamic = IsDynamic,
+            .ForceAccum = ForceAccum,
+            .Acceleration = Acceleration,
+            .NeedsCollisionResolution = NeedsCollisionResolution,
+            .IsSleeping = IsSleeping
+        };
+    }
 };
 
 /**
  * Adds force to be applied for the next simulation step. If you want to achieve constant force
- * you must call this function on every physics update
+ * you must call this function on every physics update. Sleeping blocks are woken up when they
+ * are accessed through Grid::At.
  */
 inline void AddForce(Block& block, const Vector2 force) {
     block.ForceAccum += force;
 }
+inline void AddForce(BlockRef block, const Vector2 force) {
+    block.ForceAccum += force;
+}
 
 /**
  * Applies an impulse force to the block, changing its velocity immediately.
  * The impulse is scaled by the block's mass so that heavier blocks need stronger impulse to move.
+ * A Block that is not in a grid yet needs its material to be passed explicitly.
  */
-inline void ApplyImpulse(Block& block, const Vector2 impulse) {
-    block.Velocity += impulse * block.InvMass;
+inline void ApplyImpulse(Block& block, const Vector2 impulse, const Material& material) {
+    block.Velocity += impulse * material.InvMass;
+}
+inline void ApplyImpulse(BlockRef block, const Vector2 impulse) {
+    block.Velocity += impulse * block.GetMaterial().InvMass;
 }
 
-}
\ No newline at end of file
+}
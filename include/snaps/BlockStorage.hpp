@@ -0,0 +1,170 @@
+#pragma once
+#include "Block.hpp"
+#include "Fixed.hpp"
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace snaps {
+
+struct BlockFlags {
+    bool IsDynamic = false;
+    bool NeedsCollisionResolution = false;
+    bool IsSleeping = false;
+};
+
+/**
+ * Stable identity of a block. It stays the same when the block moves between cells and becomes
+ * invalid when the block is removed. A slot of a removed block is reused by a new one with a higher
+ * generation, so an old id never refers to a new block. See Grid::GetBlockId() and Grid::Find().
+ */
+struct BlockId {
+    std::uint32_t Slot = UINT32_MAX;
+    std::uint32_t Generation = 0;
+
+    bool operator==(const BlockId&) const = default;
+};
+
+/**
+ * Pool of blocks stored as structure of arrays. Each field of a Block lives in its own dense array,
+ * so loops that need only a few fields (e.g. velocity and position) don't stream the rest.
+ * Blocks are addressed by 32-bit slots. Grid cells hold slots, so moving a block between cells
+ * doesn't touch its data. Slots of removed blocks are kept on a free list and reused.
+ * The arrays grow with the number of blocks, moving a block between cells never grows them.
+ */
+class BlockStorage {
+public:
+    // Value of Cell for a free slot.
+    static constexpr std::size_t NO_CELL = SIZE_MAX;
+
+    // Number of allocated slots, including the free ones.
+    std::size_t Size() const { return Flags.size(); }
+    std::size_t Count() const { return Size() - m_FreeSlots.size(); }
+
+    // Returns a slot for a new block placed in `cell`. Fields of the block are not initialized.
+    std::uint32_t Allocate(const std::size_t cell) {
+        std::uint32_t slot;
+        if (m_FreeSlots.empty()) {
+            slot = static_cast<std::uint32_t>(Size());
+            ForEachArray([](auto& array) { array.emplace_back(); });
+        } else {
+            slot = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        }
+        Cell[slot] = cell;
+        return slot;
+    }
+
+    // Releases the slot. Ids of the block that occupied it become invalid.
+    void Free(const std::uint32_t slot) {
+        assert(slot < Size() and Cell[slot] != NO_CELL);
+        Generation[slot]++;
+        Cell[slot] = NO_CELL;
+        m_FreeSlots.push_back(slot);
+    }
+
+    BlockId GetId(const std::uint32_t slot) const {
+        assert(slot < Size());
+        return {slot, Generation[slot]};
+    }
+
+    bool IsAlive(const BlockId id) const {
+        return id.Slot < Size() and Generation[id.Slot] == id.Generation and Cell[id.Slot] != NO_CELL;
+    }
+
+    void Set(const std::uint32_t slot, const Block& block) {
+        Ref(slot) = block;
+        FixedPosition[slot] = FixedVector2(block.WorldPosition);
+        FixedVelocity[slot] = FixedVector2(block.Velocity);
+    }
+
+    Block Get(const std::uint32_t slot) const {
+        assert(slot < Size());
+        return Block {
+            .WorldPosition = WorldPosition[slot],
+            .Velocity = Velocity[slot],
+            .Material = Material[slot],
+            .IsDynamic = Flags[slot].IsDynamic,
+            .ForceAccum = ForceAccum[slot],
+            .Acceleration = Acceleration[slot],
+            .NeedsCollisionResolution = Flags[slot].NeedsCollisionResolution,
+            .IsSleeping = Flags[slot].IsSleeping
+        };
+    }
+
+    // Fixed-point position and velocity of the block, see FixedPosition.
+    FixedVector2 FixedPositionOf(const std::uint32_t slot) const { return Synced(FixedPosition[slot], WorldPosition[slot]); }
+    FixedVector2 FixedVelocityOf(const std::uint32_t slot) const { return Synced(FixedVelocity[slot], Velocity[slot]); }
+
+    // Takes floats changed from outside into the fixed-point state of the block.
+    void UpdateFixedState(const std::uint32_t slot) {
+        FixedPosition[slot] = FixedPositionOf(slot);
+        FixedVelocity[slot] = FixedVelocityOf(slot);
+    }
+
+    // Rounds the fixed-point state of the block to its floats.
+    void UpdateFloats(const std::uint32_t slot) {
+        WorldPosition[slot] = FixedPosition[slot].ToVector2();
+        Velocity[slot] = FixedVelocity[slot].ToVector2();
+    }
+
+    BlockRef Ref(const std::uint32_t slot) {
+        assert(slot < Size());
+        return BlockRef {
+            WorldPosition[slot], Velocity[slot], Material[slot], Flags[slot].IsDynamic, ForceAccum[slot],
+            Acceleration[slot], Flags[slot].NeedsCollisionResolution, Flags[slot].IsSleeping, Materials
+        };
+    }
+
+    std::vector<Vector2> WorldPosition;
+    std::vector<Vector2> Velocity;
+    std::vector<MaterialId> Material;
+    std::vector<BlockFlags> Flags;
+    std::vector<Vector2> ForceAccum;
+    std::vector<Vector2> Acceleration;
+
+    // Properties of blocks are looked up by their Material.
+    MaterialTable Materials;
+
+    // Engine bookkeeping, not a part of Block. Number of consecutive steps the block has been resting.
+    std::vector<std::uint16_t> RestSteps;
+
+    // Engine bookkeeping, not a part of Block. Position at the beginning of the last step the block was
+    // simulated in. Renderers interpolate between it and WorldPosition, see SnapsEngine::Advance().
+    std::vector<Vector2> PreviousPosition;
+
+    // Engine bookkeeping, not a part of Block. Position and velocity simulated by Config::FixedPoint.
+    // WorldPosition and Velocity hold them rounded to floats. A block whose float doesn't match the
+    // rounded value has been changed from outside, the engine takes the float then, see UpdateFixedState().
+    std::vector<FixedVector2> FixedPosition;
+    std::vector<FixedVector2> FixedVelocity;
+
+    // Pool bookkeeping. Index of the grid cell that holds the block, NO_CELL for a free slot.
+    // Indices of a SparseGrid don't fit 32 bits, see SparseGrid::GetIndex().
+    std::vector<std::size_t> Cell;
+    // Pool bookkeeping. Incremented every time the slot is freed, see BlockId.
+    std::vector<std::uint32_t> Generation;
+
+private:
+    friend class GridSnapshot;
+    friend class WorldFile;
+
+    static FixedVector2 Synced(const FixedVector2 value, const Vector2 rounded) {
+        const Vector2 expected = value.ToVector2();
+        return expected.x == rounded.x and expected.y == rounded.y ? value : FixedVector2(rounded);
+    }
+
+    template <typename Function>
+    void ForEachArray(Function&& function) {
+        function(WorldPosition); function(Velocity); function(Material); function(Flags);
+        function(ForceAccum); function(Acceleration); function(RestSteps); function(PreviousPosition);
+        function(FixedPosition); function(FixedVelocity); function(Cell); function(Generation);
+    }
+
+    std::vector<std::uint32_t> m_FreeSlots;
+};
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "SparseGrid.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * Keeps only the chunks near areas of interest (e.g. players) resident in a SparseGrid. The other
+ * chunks are saved to a directory, one file per chunk, and loaded back when an area gets close again.
+ * Memory stays bounded by the chunks the areas cover, no matter how big the world is.
+ *
+ * Files are read and written on a background thread. Chunks are copied from and to the grid only in
+ * Update() and Flush(), on the calling thread, so call them between steps, never during one.
+ * Blocks stop at the border of resident chunks until the chunk behind it is loaded,
+ * see SparseGrid::EnableResidency().
+ * Material ids are stored as they are, so the grid must have the same materials when chunks come back.
+ *
+ * An unloaded chunk is kept in memory until its file is written. A failed write (e.g. a full disk) is
+ * retried by every Update() and the chunk is loaded from memory when an area gets close again.
+ * Files are checked before their blocks are put into the grid. A file that can't be read or is corrupt
+ * is left alone and its chunk stays out of bounds. Update() and Flush() report both.
+ */
+class ChunkStreamer {
+public:
+    // Square of chunks around the chunk of cell (X, Y), Radius chunks to each side.
+    struct Area {
+        int X;
+        int Y;
+        int Radius;
+    };
+
+    // Enables residency of the grid. Chunks the grid already has stay resident until the first Update().
+    ChunkStreamer(SparseGrid& grid, std::filesystem::path directory);
+    // Finishes pending writes. Resident chunks are not saved, see SaveResident(). Chunks whose writes
+    // have failed are lost, see UnsavedChunkCount().
+    ~ChunkStreamer();
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    /**
+     * Unloads resident chunks outside of all areas and requests loading of the missing chunks inside them.
+     * Chunks loaded since the last call are put into the grid. Loading takes a few frames, until then
+     * the requested chunks are out of bounds of the grid.
+     * Returns false if a chunk couldn't be written, read or was corrupt since the last Update() or Flush().
+     */
+    bool Update(std::span<const Area> areas);
+
+    // Waits until all requested chunks are read and written, and puts the loaded ones into the grid.
+    // Returns false like Update() does.
+    bool Flush();
+
+    // Queues writes of all resident chunks without unloading them, e.g. before quitting.
+    void SaveResident();
+
+    std::size_t ResidentChunkCount() const { return m_Resident.size(); }
+    // Unloaded chunks kept in memory, because their files are not written yet or their writes have failed.
+    std::size_t UnsavedChunkCount() const { return m_Unsaved.size(); }
+
+private:
+    using Bytes = std::shared_ptr<const std::vector<std::byte>>;
+
+    struct Job {
+        int ChunkX;
+        int ChunkY;
+        bool IsWrite;
+        Bytes Data; // Empty data of a write removes the file. Read data is empty if there's no file.
+        std::uint64_t Write = 0; // Number of the write, see Unsaved
+        bool Succeeded = true; // Set by the I/O thread
+    };
+
+    // Unloaded chunk until its file is written.
+    struct Unsaved {
+        Bytes Data;
+        std::uint64_t Write; // Number of the last write of the chunk
+        bool Failed = false;
+    };
+
+    static std::uint64_t KeyOf(int chunkX, int chunkY);
+
+    void IoLoop();
+    void Enqueue(Job job);
+    void QueueWrite(std::uint64_t key, Unsaved& unsaved);
+    void FinishJobs();
+    void Install(int chunkX, int chunkY, std::span<const std::byte> data);
+    std::vector<std::byte> SaveChunk(int chunkX, int chunkY) const;
+    void LoadChunk(int chunkX, int chunkY, std::span<const std::byte> data);
+    std::filesystem::path PathOf(int chunkX, int chunkY) const;
+
+    SparseGrid& m_Grid;
+    const std::filesystem::path m_Directory;
+
+    std::unordered_set<std::uint64_t> m_Wanted; // Chunks covered by the areas of the last Update()
+    std::unordered_set<std::uint64_t> m_Resident;
+    std::unordered_set<std::uint64_t> m_Loading; // Chunks with a read in flight
+    std::unordered_map<std::uint64_t, Unsaved> m_Unsaved;
+    std::unordered_set<std::uint64_t> m_Rejected; // Chunks with unreadable or corrupt files, never requested again
+    std::uint64_t m_WriteCount = 0;
+    bool m_HasFailed = false; // Since the last Update() or Flush()
+
+    // Shared with the I/O thread. Jobs are done in order, so a read always sees the writes queued before it.
+    std::mutex m_Mutex;
+    std::condition_variable m_JobQueued;
+    std::condition_variable m_JobDone;
+    std::deque<Job> m_Jobs;
+    std::vector<Job> m_Finished;
+    bool m_IsBusy = false;
+    bool m_Stopping = false;
+    std::thread m_IoThread;
+};
+
+}
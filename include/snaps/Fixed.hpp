@@ -0,0 +1,107 @@
+#pragma once
+#include <raylib.h>
+#include <cassert>
+#include <compare>
+#include <cstdint>
+#include <limits>
+
+
+namespace snaps {
+
+/**
+ * Signed fixed-point number, a 64-bit integer with 16 fractional bits. Used by Config::FixedPoint.
+ * Every operation is integer arithmetic, so results are the same on every platform and compiler,
+ * and the precision is 1/65536 of a pixel everywhere in the world. Products and quotients are
+ * rounded down. Products must stay below 2^31 in magnitude.
+ */
+class Fixed {
+public:
+    static constexpr int FRACTION_BITS = 16;
+    static constexpr std::int64_t ONE = std::int64_t{1} << FRACTION_BITS;
+
+    constexpr Fixed() = default;
+    constexpr explicit Fixed(const int value) : m_Raw(std::int64_t{value} << FRACTION_BITS) {}
+    // Rounds to the nearest representable value, halves away from zero. Scaling a float by a power of two
+    // and adding a half are exact in double, so the truncation is the only rounding.
+    constexpr explicit Fixed(const float value) : m_Raw(RoundToRaw(static_cast<double>(value) * ONE)) {}
+
+    static constexpr Fixed FromRaw(const std::int64_t raw) {
+        Fixed value;
+        value.m_Raw = raw;
+        return value;
+    }
+    static constexpr Fixed Max() { return FromRaw(std::numeric_limits<std::int64_t>::max()); }
+
+    constexpr std::int64_t Raw() const { return m_Raw; }
+    float ToFloat() const { return static_cast<float>(m_Raw) / ONE; }
+
+    // Largest integer not greater than the value, also for negative values.
+    constexpr std::int64_t Floor() const { return m_Raw >> FRACTION_BITS; }
+
+    constexpr auto operator<=>(const Fixed&) const = default;
+
+    constexpr Fixed operator-() const { return FromRaw(-m_Raw); }
+    constexpr Fixed operator+(const Fixed other) const { return FromRaw(m_Raw + other.m_Raw); }
+    constexpr Fixed operator-(const Fixed other) const { return FromRaw(m_Raw - other.m_Raw); }
+    constexpr Fixed operator*(const Fixed other) const { return FromRaw(m_Raw * other.m_Raw >> FRACTION_BITS); }
+    constexpr Fixed operator/(const Fixed other) const {
+        assert(other.m_Raw != 0);
+        return FromRaw(FloorDivide(m_Raw << FRACTION_BITS, other.m_Raw));
+    }
+    constexpr Fixed operator*(const int factor) const { return FromRaw(m_Raw * factor); }
+    constexpr Fixed operator/(const int divisor) const {
+        assert(divisor != 0);
+        return FromRaw(FloorDivide(m_Raw, divisor));
+    }
+
+    constexpr Fixed& operator+=(const Fixed other) { return *this = *this + other; }
+    constexpr Fixed& operator-=(const Fixed other) { return *this = *this - other; }
+
+    friend constexpr Fixed Abs(const Fixed value) { return value.m_Raw < 0 ? -value : value; }
+
+    // Square root rounded down, computed digit by digit. The value must not be negative.
+    friend constexpr Fixed Sqrt(const Fixed value) {
+        assert(value.m_Raw >= 0);
+        std::uint64_t remainder = static_cast<std::uint64_t>(value.m_Raw) << FRACTION_BITS;
+        std::uint64_t root = 0;
+        std::uint64_t bit = std::uint64_t{1} << 62;
+        while (bit > remainder) bit >>= 2;
+        for (; bit != 0; bit >>= 2) {
+            if (remainder >= root + bit) {
+                remainder -= root + bit;
+                root = (root >> 1) + bit;
+            } else {
+                root >>= 1;
+            }
+        }
+        return FromRaw(static_cast<std::int64_t>(root));
+    }
+
+private:
+    static constexpr std::int64_t RoundToRaw(const double value) {
+        return static_cast<std::int64_t>(value < 0.0 ? value - 0.5 : value + 0.5);
+    }
+
+    // Integer division truncates towards zero, this rounds down like the rest of the operations.
+    static constexpr std::int64_t FloorDivide(const std::int64_t dividend, const std::int64_t divisor) {
+        const std::int64_t quotient = dividend / divisor;
+        return quotient * divisor != dividend and (dividend < 0) != (divisor < 0) ? quotient - 1 : quotient;
+    }
+
+    std::int64_t m_Raw = 0;
+};
+
+struct FixedVector2 {
+    Fixed x;
+    Fixed y;
+
+    constexpr FixedVector2() = default;
+    constexpr FixedVector2(const Fixed x, const Fixed y) : x(x), y(y) {}
+    explicit FixedVector2(const Vector2 vector) : x(vector.x), y(vector.y) {}
+
+    Vector2 ToVector2() const { return {x.ToFloat(), y.ToFloat()}; }
+
+    constexpr bool operator==(const FixedVector2&) const = default;
+};
+
+}
@@ -2,15 +2,119 @@
 #include <cassert>
 
 #include "Block.hpp"
+#include "BlockStorage.hpp"
+#include "GridCell.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
 #include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 
 namespace snaps {
+
+/**
+ * Order in which cells are stored, see Grid::GetIndex().
+ * RowMajor stores cells row by row, so vertical neighbours are a whole row apart.
+ * Tiled stores chunks one after another, each chunk as 8x8 tiles of 8x8 cells. Tiles and cells inside
+ * them are stored row by row, so vertical neighbours are usually 8 cells apart and a tile fills one
+ * word of the occupancy bits. Morton is like Tiled, but tiles of a chunk are stored in Z-order.
+ * In tiled layouts all cells of a chunk are next to each other. The engine sweeps rows, which
+ * keeps neighbouring rows in cache anyway, so RowMajor is the fastest for it. See GridLayoutBenchmark.
+ */
+enum class GridLayout {
+    RowMajor,
+    Tiled,
+    Morton
+};
+
+/**
+ * Bits of Grid::GetNeighbours(). A neighbour bit is set when the cell is occupied or outside of the grid,
+ * so a single test tells whether a block can move there. STATIC_BELOW is set when the cell below holds
+ * terrain, which never moves and is always at the position of its cell.
+ */
+struct Neighbours {
+    static constexpr std::uint16_t LEFT = 1 << 0;
+    static constexpr std::uint16_t RIGHT = 1 << 1;
+    static constexpr std::uint16_t UP = 1 << 2;
+    static constexpr std::uint16_t DOWN = 1 << 3;
+    static constexpr std::uint16_t UP_LEFT = 1 << 4;
+    static constexpr std::uint16_t UP_RIGHT = 1 << 5;
+    static constexpr std::uint16_t DOWN_LEFT = 1 << 6;
+    static constexpr std::uint16_t DOWN_RIGHT = 1 << 7;
+    static constexpr std::uint16_t ALL = 0xFF;
+    static constexpr std::uint16_t STATIC_BELOW = 1 << 8;
+
+    // Bit of the neighbour at offset (dx, dy), both in [-1, 1].
+    static constexpr std::uint16_t Of(const int dx, const int dy) {
+        constexpr std::uint16_t bits[3][3] = {{UP_LEFT, UP, UP_RIGHT}, {LEFT, 0, RIGHT}, {DOWN_LEFT, DOWN, DOWN_RIGHT}};
+        return bits[dy + 1][dx + 1];
+    }
+};
+
 class Grid {
 public:
-    Grid(const int width, const int height) : m_Width(width), m_Height(height), m_Blocks(width * height, std::nullopt)
+    // The grid is split into square chunks of this size. Each chunk tracks the area that needs simulation.
+    static constexpr int CHUNK_SIZE = 64;
+    // Size of the tiles in the tiled layouts. A tile has 64 cells, as many as a word of bits.
+    static constexpr int TILE_SIZE = 8;
+    // Chunks can be solved by several threads at once, see Config::ParallelStep.
+    static constexpr bool SUPPORTS_PARALLEL_STEP = true;
+
+    // Inclusive cell bounds of the area of a single chunk that needs simulation.
+    struct DirtyRect {
+        int MinX = INT_MAX;
+        int MinY = INT_MAX;
+        int MaxX = INT_MIN;
+        int MaxY = INT_MIN;
+
+        bool IsEmpty() const { return MinX > MaxX; }
+    };
+
+    // Optional-like view of a single cell, see GridCell.
+    using Cell = GridCell<Grid>;
+
+    /**
+     * Position of a cell together with its index. Stepping to a neighbour within the same tile
+     * only adds a constant to the index, the index is computed again only when crossing a tile border.
+     * Bounds are not checked, test the position with InBounds() first.
+     */
+    class Cursor {
+    public:
+        Cursor(const Grid& grid, const int x, const int y) : X(x), Y(y), Index(grid.GetIndex(x, y)), m_Grid(&grid) {}
+
+        Cursor Left() const { return X % TILE_SIZE != 0 ? Cursor(*m_Grid, X - 1, Y, Index - 1) : Cursor(*m_Grid, X - 1, Y); }
+        Cursor Right() const { return (X + 1) % TILE_SIZE != 0 ? Cursor(*m_Grid, X + 1, Y, Index + 1) : Cursor(*m_Grid, X + 1, Y); }
+        Cursor Up() const { return Y % TILE_SIZE != 0 ? Cursor(*m_Grid, X, Y - 1, Index - m_Grid->m_RowStride) : Cursor(*m_Grid, X, Y - 1); }
+        Cursor Down() const { return (Y + 1) % TILE_SIZE != 0 ? Cursor(*m_Grid, X, Y + 1, Index + m_Grid->m_RowStride) : Cursor(*m_Grid, X, Y + 1); }
+
+        int X;
+        int Y;
+        std::size_t Index;
+
+    private:
+        Cursor(const Grid& grid, const int x, const int y, const std::size_t index) : X(x), Y(y), Index(index), m_Grid(&grid) {}
+
+        const Grid* m_Grid;
+    };
+
+    Grid(const int width, const int height, const GridLayout layout = GridLayout::RowMajor)
+        : m_Width(width), m_Height(height), m_Layout(layout),
+          m_ChunksX((width + CHUNK_SIZE - 1) / CHUNK_SIZE), m_ChunksY((height + CHUNK_SIZE - 1) / CHUNK_SIZE),
+          m_RowStride(layout == GridLayout::RowMajor ? width : TILE_SIZE),
+          m_Slots(CellsFor(width, height, layout)), m_TerrainMaterials(m_Slots.size()),
+          m_OccupiedBits(WordsFor(m_Slots.size()), 0), m_DynamicBits(WordsFor(m_Slots.size()), 0),
+          m_ActiveBits(WordsFor(m_Slots.size()), 0), m_TerrainBits(WordsFor(m_Slots.size()), 0),
+          m_Neighbours(m_Slots.size(), 0), m_ColumnBits(static_cast<std::size_t>(width) * WordsFor(height), 0),
+          m_DirtyRects(m_ChunksX * m_ChunksY), m_DirtyChunks(m_ChunksX * m_ChunksY),
+          m_ChangedChunks(m_ChunksX * m_ChunksY, 0), m_ChunkVersions(m_ChunksX * m_ChunksY, 0)
     {
+        ComputeNeighbours(0, 0, width - 1, height - 1);
     }
 
     bool InBounds(const int x, const int y) const {
@@ -18,41 +122,664 @@ public:
     }
 
     void Remove(const int x, const int y) {
-        At(x, y) = std::nullopt;
+        assert(InBounds(x, y));
+        Remove(GetIndex(x, y));
+    }
+    void Remove(const std::size_t index) {
+        assert(index < Size());
+        if (IsOccupied(index) and not IsTerrain(index)) m_Blocks.Free(m_Slots[index]);
+        MarkChanged(index);
+        ClearBit(m_OccupiedBits, index);
+        ClearBit(m_DynamicBits, index);
+        ClearBit(m_ActiveBits, index);
+        ClearBit(m_TerrainBits, index);
+        UpdateNeighbours(index);
+    }
+
+    /**
+     * Places a new block in the cell. A block that was there before is removed, so its id becomes invalid.
+     * Static blocks are stored as terrain, see IsTerrain().
+     */
+    void Set(const std::size_t index, const Block& block) {
+        assert(index < Size());
+        if (IsOccupied(index) and not IsTerrain(index)) m_Blocks.Free(m_Slots[index]);
+        MarkChanged(index);
+        SetBit(m_OccupiedBits, index);
+        ClearBit(m_ActiveBits, index);
+        if (block.IsDynamic) {
+            Store(index, block);
+            m_Blocks.Flags[m_Slots[index]].IsSleeping = true; // Until woken up below
+            SetBit(m_DynamicBits, index);
+            ClearBit(m_TerrainBits, index);
+        } else {
+            m_TerrainMaterials[index] = block.Material;
+            SetBit(m_TerrainBits, index);
+            ClearBit(m_DynamicBits, index);
+        }
+        Wake(index);
+        UpdateNeighbours(index);
+    }
+
+    // Moves a block to an empty cell. Only the slot of the block is moved, the source cell becomes empty.
+    // Other threads may read the slot of the cell as a neighbour, see LoadVelocity(), hence the atomic store.
+    void Move(const std::size_t from, const std::size_t to) {
+        assert(IsOccupied(from) and not IsTerrain(from) and not IsOccupied(to));
+        std::atomic_ref(m_Slots[to]).store(m_Slots[from], std::memory_order_relaxed);
+        m_Blocks.Cell[m_Slots[to]] = to;
+        MarkChanged(from);
+        MarkChanged(to);
+        SetBit(m_OccupiedBits, to);
+        if (IsDynamic(from)) SetBit(m_DynamicBits, to);
+        if (IsActive(from)) {
+            SetBit(m_ActiveBits, to);
+            MarkDirty(to);
+        }
+        ClearBit(m_OccupiedBits, from);
+        ClearBit(m_DynamicBits, from);
+        ClearBit(m_ActiveBits, from);
+        MoveNeighbours(from, to);
+    }
+
+    void Clear() {
+        for (std::size_t i = FindNextOccupied(0, Size()); i < Size(); i = FindNextOccupied(i + 1, Size())) {
+            if (not IsTerrain(i)) m_Blocks.Free(m_Slots[i]);
+        }
+        std::ranges::fill(m_OccupiedBits, 0);
+        std::ranges::fill(m_DynamicBits, 0);
+        std::ranges::fill(m_ActiveBits, 0);
+        std::ranges::fill(m_TerrainBits, 0);
+        ComputeNeighbours(0, 0, m_Width - 1, m_Height - 1);
+        std::ranges::fill(m_DirtyRects, DirtyRect{});
+        m_DirtyChunkCount = 0;
+        std::ranges::fill(m_ChangedChunks, CHANGED);
+    }
+
+    // ----- Static terrain -----
+
+    /**
+     * Static blocks don't use their velocity, forces or identity, so they are stored as terrain: a bit and
+     * a material per cell, without a slot in Blocks(). Terrain is always at the position of its cell.
+     * Reading neighbours through GetWorldPosition(), GetVelocity() and GetMaterial() works for terrain and
+     * regular blocks alike, without unpacking anything.
+     */
+    bool IsTerrain(const std::size_t index) const {
+        assert(index < Size());
+        return TestBit(m_TerrainBits, index);
+    }
+
+    /**
+     * Moves terrain of the cell to Blocks() as a regular static block, so that it can be accessed through
+     * a BlockRef. The block stays there until a static block is assigned to the cell again.
+     */
+    void Unpack(const std::size_t index) {
+        assert(IsTerrain(index));
+        Store(index, *std::as_const(*this).At(index));
+        ClearBit(m_TerrainBits, index);
+        MarkChanged(index);
+        UpdateNeighbours(index, false);
+    }
+
+    Vector2 GetWorldPosition(const int x, const int y) const {
+        assert(IsOccupied(x, y));
+        return GetWorldPosition(GetIndex(x, y));
+    }
+    Vector2 GetWorldPosition(const std::size_t index) const {
+        assert(IsOccupied(index));
+        if (IsTerrain(index)) {
+            const auto [x, y] = GetXY(index);
+            return {static_cast<float>(x * BLOCK_SIZE), static_cast<float>(y * BLOCK_SIZE)};
+        }
+        return m_Blocks.WorldPosition[m_Slots[index]];
+    }
+
+    /**
+     * Like GetWorldPosition() and GetVelocity(), but safe while other threads move blocks and store their
+     * motion, see Config::ConcurrentClaiming. The block may be moving, so the values may be a bit stale.
+     */
+    Vector2 LoadWorldPosition(const std::size_t index) const {
+        if (IsTerrain(index)) return GetWorldPosition(index);
+        return LoadVector(m_Blocks.WorldPosition[LoadSlot(index)]);
+    }
+    Vector2 LoadVelocity(const std::size_t index) const {
+        if (IsTerrain(index)) return Vector2{0, 0};
+        return LoadVector(m_Blocks.Velocity[LoadSlot(index)]);
+    }
+
+    Vector2 GetVelocity(const int x, const int y) const {
+        assert(IsOccupied(x, y));
+        return GetVelocity(GetIndex(x, y));
+    }
+    Vector2 GetVelocity(const std::size_t index) const {
+        assert(IsOccupied(index));
+        return IsTerrain(index) ? Vector2{0, 0} : m_Blocks.Velocity[m_Slots[index]];
+    }
+
+    const Material& GetMaterial(const int x, const int y) const {
+        assert(IsOccupied(x, y));
+        return GetMaterial(GetIndex(x, y));
+    }
+    const Material& GetMaterial(const std::size_t index) const {
+        assert(IsOccupied(index));
+        return Materials()[IsTerrain(index) ? m_TerrainMaterials[index] : m_Blocks.Material[m_Slots[index]]];
+    }
+
+    // ----- Active set -----
+
+    /**
+     * Active blocks are the dynamic blocks that need simulation, all other dynamic blocks are sleeping.
+     * A block wakes up when it is placed, accessed with At() or when any cell in its 8-neighbourhood
+     * changes. The engine puts blocks that have been resting for a while to sleep.
+     * Waking a block marks its surroundings dirty, so the engine will visit it in the next step.
+     */
+    bool IsActive(const std::size_t index) const {
+        assert(index < Size());
+        return TestBit(m_ActiveBits, index);
+    }
+
+    void Wake(const std::size_t index) {
+        assert(index < Size());
+        if (not IsDynamic(index)) {
+            // Unpacked static blocks can be changed through the cell as well
+            if (IsOccupied(index) and not IsTerrain(index)) MarkChanged(index);
+            return;
+        }
+        MarkChanged(index);
+        const std::uint32_t slot = LoadSlot(index);
+        std::atomic_ref(m_Blocks.RestSteps[slot]).store(0, std::memory_order_relaxed);
+        // The flag decides rather than the active bit, which a block leaving the cell on another thread can
+        // clear in the meantime. Blocks that move are never asleep, and only one caller wakes a sleeping one.
+        std::atomic_ref isSleeping(m_Blocks.Flags[slot].IsSleeping);
+        if (not isSleeping.load(std::memory_order_relaxed) or not isSleeping.exchange(false, std::memory_order_relaxed)) return;
+        SetBit(m_ActiveBits, index);
+        MarkDirty(index);
+    }
+
+    void Sleep(const std::size_t index) {
+        assert(index < Size());
+        m_Blocks.Flags[m_Slots[index]].IsSleeping = true;
+        ClearBit(m_ActiveBits, index);
+        MarkChanged(index);
+    }
+
+    // Returns the index of the first active block in range [from, to) or `to` if there is none.
+    std::size_t FindNextActive(const std::size_t from, const std::size_t to) const {
+        return FindNextBit(m_ActiveBits, from, to);
+    }
+
+    // Returns x of the first active block in row `y` in range [x, endX) or `endX` if there is none.
+    int FindNextActiveInRow(const int x, const int y, const int endX) const {
+        return FindNextBitInRow(m_ActiveBits, x, y, endX);
+    }
+
+    // Raw active bits, bit `i % 64` of word `i / 64` is set for an active cell `i`. Meant for vectorized loops.
+    std::span<const std::uint64_t> ActiveBits() const { return m_ActiveBits; }
+
+    // ----- Dirty rectangles -----
+
+    /**
+     * Extends dirty rectangles of the chunks so that they cover the cell and its 8-neighbourhood.
+     * A block that moves to the next cell stays inside the area marked for it, even if it crosses a chunk
+     * border. A block that moves further is marked again in its new cell by Move().
+     * Chunks updated in parallel can mark the same neighbouring chunk, hence the atomic updates.
+     */
+    void MarkDirty(const std::size_t index) {
+        assert(index < Size());
+        const auto [x, y] = GetXY(index);
+        MarkDirty(x, y);
+    }
+    void MarkDirty(const int x, const int y) {
+        assert(InBounds(x, y));
+        const int minX = std::max(x - 1, 0);
+        const int minY = std::max(y - 1, 0);
+        const int maxX = std::min(x + 1, m_Width - 1);
+        const int maxY = std::min(y + 1, m_Height - 1);
+        for (int chunkY = minY / CHUNK_SIZE; chunkY <= maxY / CHUNK_SIZE; chunkY++) {
+            for (int chunkX = minX / CHUNK_SIZE; chunkX <= maxX / CHUNK_SIZE; chunkX++) {
+                const std::size_t chunk = chunkY * m_ChunksX + chunkX;
+                DirtyRect& rect = m_DirtyRects[chunk];
+                // Only one caller sees the rectangle empty, that one lists the chunk.
+                if (AtomicMin(rect.MinX, std::max(minX, chunkX * CHUNK_SIZE)) == DirtyRect{}.MinX) {
+                    const std::size_t slot = std::atomic_ref(m_DirtyChunkCount).fetch_add(1, std::memory_order_relaxed);
+                    m_DirtyChunks[slot] = chunk;
+                }
+                AtomicMin(rect.MinY, std::max(minY, chunkY * CHUNK_SIZE));
+                AtomicMax(rect.MaxX, std::min(maxX, chunkX * CHUNK_SIZE + CHUNK_SIZE - 1));
+                AtomicMax(rect.MaxY, std::min(maxY, chunkY * CHUNK_SIZE + CHUNK_SIZE - 1));
+            }
+        }
+    }
+
+    /**
+     * Moves the dirty rectangles collected so far to `rects` and starts collecting anew.
+     * Rectangles are ordered by chunk, top to bottom and left to right, and never overlap.
+     * The engine changes blocks only inside of the taken rectangles, so their chunks count as changed.
+     */
+    void TakeDirtyRects(std::vector<DirtyRect>& rects) {
+        rects.clear();
+        const auto dirtyChunks = std::span(m_DirtyChunks).first(m_DirtyChunkCount);
+        std::ranges::sort(dirtyChunks);
+        for (const std::size_t chunk : dirtyChunks) {
+            rects.push_back(m_DirtyRects[chunk]);
+            m_DirtyRects[chunk] = {};
+            m_ChangedChunks[chunk] = CHANGED;
+        }
+        m_DirtyChunkCount = 0;
+    }
+
+    bool HasDirtyRects() const { return m_DirtyChunkCount != 0; }
+
+    const DirtyRect& GetDirtyRect(const int chunkX, const int chunkY) const {
+        assert(chunkX >= 0 and chunkY >= 0 and chunkX < m_ChunksX and chunkY < m_ChunksY);
+        return m_DirtyRects[chunkY * m_ChunksX + chunkX];
+    }
+
+    bool IsOccupied(const int x, const int y) const {
+        assert(InBounds(x, y));
+        return IsOccupied(GetIndex(x, y));
+    }
+    bool IsOccupied(const std::size_t index) const {
+        assert(index < Size());
+        return TestBit(m_OccupiedBits, index);
     }
 
-    std::optional<Block>& At(const int x, const int y) {
+    /**
+     * Dynamic bits are updated when a block is placed, moved or removed. If you flip `IsDynamic`
+     * through a BlockRef, assign the block to its cell again so that the engine notices the change.
+     */
+    bool IsDynamic(const std::size_t index) const {
+        assert(index < Size());
+        return TestBit(m_DynamicBits, index);
+    }
+
+    /**
+     * Occupancy of the 8-neighbourhood of the cell, see Neighbours. Kept up to date by Set(), Move() and
+     * Remove(), so the engine tests its surroundings with one load instead of a lookup and bounds check
+     * per neighbour.
+     */
+    std::uint16_t GetNeighbours(const std::size_t index) const {
+        assert(index < Size());
+        return std::atomic_ref(const_cast<std::uint16_t&>(m_Neighbours[index])).load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the first row in range (y, maxY] where the cell of column `x` is occupied or out of the grid,
+     * or `maxY + 1` if there is none. The occupancy is also kept column by column, so a falling block finds
+     * the surface it lands on a whole word (64 cells) at a time.
+     */
+    int FindSurfaceBelow(const int x, const int y, const int maxY) const {
+        assert(InBounds(x, y) and maxY > y);
+        const std::size_t column = ColumnBitOf(x, 0);
+        const std::size_t end = ColumnBitOf(x, std::min(maxY + 1, m_Height));
+        return static_cast<int>(FindNextBit(m_ColumnBits, ColumnBitOf(x, y + 1), end) - column);
+    }
+
+    // Returns the index of the first occupied cell in range [from, to) or `to` if there is none.
+    std::size_t FindNextOccupied(const std::size_t from, const std::size_t to) const {
+        return FindNextBit(m_OccupiedBits, from, to);
+    }
+
+    // Returns the index of the first cell with a dynamic block in range [from, to) or `to` if there is none.
+    std::size_t FindNextDynamic(const std::size_t from, const std::size_t to) const {
+        return FindNextBit(m_DynamicBits, from, to);
+    }
+
+    Cell At(const int x, const int y) {
+        assert(InBounds(x, y));
+        return {*this, GetIndex(x, y)};
+    }
+    // Like At() but doesn't wake the block up. Meant for reading neighbours during simulation.
+    Cell Peek(const int x, const int y) {
         assert(InBounds(x, y));
-        return m_Blocks[GetIndex(x, y)];
+        return {*this, GetIndex(x, y), false};
+    }
+    Cell Peek(const std::size_t index) {
+        assert(index < Size());
+        return {*this, index, false};
     }
-    const std::optional<Block>& At(const int x, const int y) const {
+    std::optional<Block> At(const int x, const int y) const {
         assert(InBounds(x, y));
-        return m_Blocks[GetIndex(x, y)];
+        return At(GetIndex(x, y));
+    }
+    Cell At(const std::size_t index) {
+        assert(index < Size());
+        return {*this, index};
+    }
+    std::optional<Block> At(const std::size_t index) const {
+        assert(index < Size());
+        if (not IsOccupied(index)) return std::nullopt;
+        if (IsTerrain(index)) {
+            return Block { .WorldPosition = GetWorldPosition(index), .Material = m_TerrainMaterials[index] };
+        }
+        return m_Blocks.Get(m_Slots[index]);
+    }
+
+    // Direct access to an occupied cell, bypassing the optional-like view. Doesn't wake the block up
+    // and doesn't unpack terrain. The pool of blocks grows with the number of blocks, so a BlockRef
+    // becomes invalid when a block is placed or terrain is unpacked and the pool grows.
+    BlockRef Ref(const int x, const int y) {
+        assert(IsOccupied(x, y));
+        return Ref(GetIndex(x, y));
     }
-    std::optional<Block>& At(const std::size_t index) {
-        assert(index < m_Blocks.size());
-        return m_Blocks[index];
+    BlockRef Ref(const std::size_t index) {
+        assert(IsOccupied(index) and not IsTerrain(index));
+        return m_Blocks.Ref(m_Slots[index]);
     }
-    const std::optional<Block>& At(const std::size_t index) const {
-        assert(index < m_Blocks.size());
-        return m_Blocks[index];
+
+    // Slot of the block in Blocks(). Fields of the block are at this position in the storage arrays.
+    std::uint32_t GetSlot(const std::size_t index) const {
+        assert(IsOccupied(index) and not IsTerrain(index));
+        return m_Slots[index];
+    }
+
+    // ----- Block identity -----
+
+    BlockId GetBlockId(const int x, const int y) const {
+        assert(IsOccupied(x, y));
+        return GetBlockId(GetIndex(x, y));
+    }
+    BlockId GetBlockId(const std::size_t index) const {
+        assert(IsOccupied(index) and not IsTerrain(index));
+        return m_Blocks.GetId(m_Slots[index]);
+    }
+
+    // Returns the index of the cell that holds the block or nullopt if the block has been removed.
+    std::optional<std::size_t> Find(const BlockId id) const {
+        if (not m_Blocks.IsAlive(id)) return std::nullopt;
+        return m_Blocks.Cell[id.Slot];
     }
 
     int Width() const { return m_Width; }
     int Height() const { return m_Height; }
-    std::vector<std::optional<Block>>& Data() { return m_Blocks; }
-    const std::vector<std::optional<Block>>& Data() const { return m_Blocks; }
+    GridLayout Layout() const { return m_Layout; }
+    std::size_t ChunkCount() const { return static_cast<std::size_t>(m_ChunksX) * m_ChunksY; }
+    // Number of cell indices. Tiled layouts round the grid up to whole chunks, cells outside of it stay empty.
+    std::size_t Size() const { return m_Slots.size(); }
+    // Number of blocks in Blocks(). Terrain is not counted.
+    std::size_t BlockCount() const { return m_Blocks.Count(); }
+    BlockStorage& Blocks() { return m_Blocks; }
+    const BlockStorage& Blocks() const { return m_Blocks; }
+    MaterialTable& Materials() { return m_Blocks.Materials; }
+    const MaterialTable& Materials() const { return m_Blocks.Materials; }
 
     std::size_t GetIndex(const int x, const int y) const {
-        return y * m_Width + x;
+        if (m_Layout == GridLayout::RowMajor) return y * m_Width + x;
+        const unsigned cellX = x, cellY = y;
+        const std::size_t chunk = cellY / CHUNK_SIZE * m_ChunksX + cellX / CHUNK_SIZE;
+        const unsigned tileX = cellX / TILE_SIZE % TILES_PER_ROW;
+        const unsigned tileY = cellY / TILE_SIZE % TILES_PER_ROW;
+        const unsigned tile = m_Layout == GridLayout::Morton
+            ? SpreadBits(tileX) | SpreadBits(tileY) << 1
+            : tileY * TILES_PER_ROW + tileX;
+        return chunk * CELLS_PER_CHUNK + tile * CELLS_PER_TILE + cellY % TILE_SIZE * TILE_SIZE + cellX % TILE_SIZE;
     }
     std::pair<int, int> GetXY(const std::size_t index) const {
-        return {index % m_Width, index / m_Width};
+        if (m_Layout == GridLayout::RowMajor) return {index % m_Width, index / m_Width};
+        const std::size_t chunk = index / CELLS_PER_CHUNK;
+        const unsigned tile = index % CELLS_PER_CHUNK / CELLS_PER_TILE;
+        const unsigned cell = index % CELLS_PER_TILE;
+        const unsigned tileX = m_Layout == GridLayout::Morton ? GatherBits(tile) : tile % TILES_PER_ROW;
+        const unsigned tileY = m_Layout == GridLayout::Morton ? GatherBits(tile >> 1) : tile / TILES_PER_ROW;
+        return {
+            static_cast<int>(chunk % m_ChunksX * CHUNK_SIZE + tileX * TILE_SIZE + cell % TILE_SIZE),
+            static_cast<int>(chunk / m_ChunksX * CHUNK_SIZE + tileY * TILE_SIZE + cell / TILE_SIZE)
+        };
+    }
+
+    Cursor GetCursor(const int x, const int y) const {
+        assert(InBounds(x, y));
+        return {*this, x, y};
     }
 
 private:
+    static constexpr int TILES_PER_ROW = CHUNK_SIZE / TILE_SIZE;
+    static constexpr std::size_t CELLS_PER_TILE = TILE_SIZE * TILE_SIZE;
+    static constexpr std::size_t CELLS_PER_CHUNK = CHUNK_SIZE * CHUNK_SIZE;
+    static_assert(CELLS_PER_TILE == 64, "A tile must fill exactly one word of bits");
+
+    static std::size_t CellsFor(const int width, const int height, const GridLayout layout) {
+        if (layout == GridLayout::RowMajor) return static_cast<std::size_t>(width) * height;
+        const std::size_t chunks = static_cast<std::size_t>((width + CHUNK_SIZE - 1) / CHUNK_SIZE) * ((height + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        return chunks * CELLS_PER_CHUNK;
+    }
+
+    // Moves bits 0, 1, 2 to bits 0, 2, 4 and back. Used for the Z-order of tiles.
+    static unsigned SpreadBits(const unsigned value) {
+        return (value & 1) | (value & 2) << 1 | (value & 4) << 2;
+    }
+    static unsigned GatherBits(const unsigned value) {
+        return (value & 1) | (value >> 1 & 2) | (value >> 2 & 4);
+    }
+
+    static std::size_t WordsFor(const std::size_t bits) { return (bits + 63) / 64; }
+
+    // A word of bits can span cells of two chunks updated in parallel, so bits are accessed atomically.
+    // Relaxed loads compile to plain loads, only writes pay for it.
+    static void SetBit(std::vector<std::uint64_t>& bits, const std::size_t index) {
+        std::atomic_ref(bits[index / 64]).fetch_or(std::uint64_t{1} << (index % 64), std::memory_order_relaxed);
+    }
+    static void ClearBit(std::vector<std::uint64_t>& bits, const std::size_t index) {
+        std::atomic_ref(bits[index / 64]).fetch_and(~(std::uint64_t{1} << (index % 64)), std::memory_order_relaxed);
+    }
+    // Writes the bit only if it changes.
+    static void AssignBit(std::vector<std::uint64_t>& bits, const std::size_t index, const bool value) {
+        if (TestBit(bits, index) == value) return;
+        if (value) SetBit(bits, index);
+        else ClearBit(bits, index);
+    }
+    static std::uint64_t LoadWord(const std::vector<std::uint64_t>& bits, const std::size_t wordIndex) {
+        return std::atomic_ref(const_cast<std::uint64_t&>(bits[wordIndex])).load(std::memory_order_relaxed);
+    }
+    static bool TestBit(const std::vector<std::uint64_t>& bits, const std::size_t index) {
+        return (LoadWord(bits, index / 64) >> (index % 64)) & 1;
+    }
+
+    std::uint32_t LoadSlot(const std::size_t index) const {
+        return std::atomic_ref(const_cast<std::uint32_t&>(m_Slots[index])).load(std::memory_order_relaxed);
+    }
+    static Vector2 LoadVector(const Vector2& vector) {
+        return {
+            std::atomic_ref(const_cast<float&>(vector.x)).load(std::memory_order_relaxed),
+            std::atomic_ref(const_cast<float&>(vector.y)).load(std::memory_order_relaxed)
+        };
+    }
+
+    // Both return the previous value.
+    static int AtomicMin(int& target, const int value) {
+        std::atomic_ref ref(target);
+        int current = ref.load(std::memory_order_relaxed);
+        while (value < current and not ref.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+        return current;
+    }
+    static int AtomicMax(int& target, const int value) {
+        std::atomic_ref ref(target);
+        int current = ref.load(std::memory_order_relaxed);
+        while (value > current and not ref.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+        return current;
+    }
+
+    // Puts the block in a new slot of Blocks().
+    void Store(const std::size_t index, const Block& block) {
+        const std::uint32_t slot = m_Blocks.Allocate(index);
+        m_Slots[index] = slot;
+        m_Blocks.Set(slot, block);
+        m_Blocks.RestSteps[slot] = 0;
+        m_Blocks.PreviousPosition[slot] = block.WorldPosition;
+    }
+
+    // Bits of m_ChangedChunks. Chunks changed since their last snapshot are copied by the next one,
+    // see GridSnapshot, and chunks changed since the last state hash are hashed again, see StateHash.
+    static constexpr std::uint8_t CHANGED_SINCE_SNAPSHOT = 1;
+    static constexpr std::uint8_t CHANGED_SINCE_HASH = 2;
+    static constexpr std::uint8_t CHANGED = CHANGED_SINCE_SNAPSHOT | CHANGED_SINCE_HASH;
+
+    // Chunks updated in parallel can change the same neighbouring chunk, hence the atomic store.
+    void MarkChanged(const std::size_t index) {
+        const std::size_t chunk = m_Layout == GridLayout::RowMajor
+            ? index / m_Width / CHUNK_SIZE * m_ChunksX + index % m_Width / CHUNK_SIZE
+            : index / CELLS_PER_CHUNK;
+        std::atomic_ref(m_ChangedChunks[chunk]).store(CHANGED, std::memory_order_relaxed);
+    }
+
+    // Cells of a chunk as up to CHUNK_SIZE runs of consecutive indices, one word of bits at most each.
+    // In RowMajor a run is a row of the chunk, in tiled layouts the chunk is stored in one piece, so runs
+    // are just consecutive words of it. Runs outside of the grid are empty.
+    struct ChunkRun {
+        std::size_t Start;
+        int Length;
+    };
+    ChunkRun GetChunkRun(const std::size_t chunk, const int run) const {
+        if (m_Layout != GridLayout::RowMajor) {
+            return {chunk * CELLS_PER_CHUNK + run * 64, 64};
+        }
+        const int x = static_cast<int>(chunk % m_ChunksX) * CHUNK_SIZE;
+        const int y = static_cast<int>(chunk / m_ChunksX) * CHUNK_SIZE + run;
+        if (y >= m_Height) return {0, 0};
+        return {GetIndex(x, y), std::min(CHUNK_SIZE, m_Width - x)};
+    }
+
+    /**
+     * Tells the 8-neighbourhood whether the cell is occupied and the cell above whether it holds terrain,
+     * see GetNeighbours(), and wakes the neighbours up. Cells of neighbouring chunks updated in parallel
+     * share neighbours, hence the atomic updates. Bits that don't change aren't written.
+     * The column bit of the cell is updated here too, where its coordinates are at hand.
+     */
+    void UpdateNeighbours(const std::size_t index, const bool wake = true) {
+        const auto [x, y] = GetXY(index);
+        const std::uint16_t occupied = IsOccupied(index) ? Neighbours::ALL : 0;
+        AssignBit(m_ColumnBits, ColumnBitOf(x, y), occupied != 0);
+        const std::uint16_t staticBelow = IsTerrain(index) ? Neighbours::STATIC_BELOW : 0;
+        for (int neighbourY = std::max(y - 1, 0); neighbourY <= std::min(y + 1, m_Height - 1); neighbourY++) {
+            for (int neighbourX = std::max(x - 1, 0); neighbourX <= std::min(x + 1, m_Width - 1); neighbourX++) {
+                if (neighbourX == x and neighbourY == y) continue;
+                const std::size_t neighbour = GetIndex(neighbourX, neighbourY);
+                std::uint16_t bits = Neighbours::Of(x - neighbourX, y - neighbourY);
+                std::uint16_t value = occupied & bits;
+                if (neighbourX == x and neighbourY == y - 1) {
+                    bits |= Neighbours::STATIC_BELOW;
+                    value |= staticBelow;
+                }
+                std::atomic_ref mask(m_Neighbours[neighbour]);
+                if ((mask.load(std::memory_order_relaxed) & bits) != value) {
+                    if (value != 0) mask.fetch_or(value, std::memory_order_relaxed);
+                    if (value != bits) mask.fetch_and(static_cast<std::uint16_t>(~bits | value), std::memory_order_relaxed);
+                }
+                if (wake) Wake(neighbour);
+            }
+        }
+    }
+
+    /**
+     * UpdateNeighbours() of both cells of Move(). The bits of the cells are known to flip, so each cell around
+     * them takes a single update, also the ones next to both. Blocks move to the next cell almost always.
+     */
+    void MoveNeighbours(const std::size_t from, const std::size_t to) {
+        const auto [fromX, fromY] = GetXY(from);
+        const auto [toX, toY] = GetXY(to);
+        if (std::abs(toX - fromX) > 1 or std::abs(toY - fromY) > 1) {
+            UpdateNeighbours(from);
+            UpdateNeighbours(to);
+            return;
+        }
+        ClearBit(m_ColumnBits, ColumnBitOf(fromX, fromY));
+        SetBit(m_ColumnBits, ColumnBitOf(toX, toY));
+        const auto bitOf = [](const int cellX, const int cellY, const int x, const int y) {
+            return std::abs(cellX - x) <= 1 and std::abs(cellY - y) <= 1 ? Neighbours::Of(cellX - x, cellY - y) : 0;
+        };
+        for (int y = std::max(std::min(fromY, toY) - 1, 0); y <= std::min(std::max(fromY, toY) + 1, m_Height - 1); y++) {
+            for (int x = std::max(std::min(fromX, toX) - 1, 0); x <= std::min(std::max(fromX, toX) + 1, m_Width - 1); x++) {
+                const std::uint16_t bits = bitOf(fromX, fromY, x, y) | bitOf(toX, toY, x, y);
+                if (bits == 0) continue;
+                const std::size_t neighbour = GetIndex(x, y);
+                std::atomic_ref(m_Neighbours[neighbour]).fetch_xor(bits, std::memory_order_relaxed);
+                Wake(neighbour);
+            }
+        }
+    }
+
+    // Computes masks and column bits of the cells in the rectangle from scratch. Used where the occupancy
+    // bits are written directly, see GridSnapshot and WorldFile.
+    void ComputeNeighbours(const int minX, const int minY, const int maxX, const int maxY) {
+        for (int y = std::max(minY, 0); y <= std::min(maxY, m_Height - 1); y++) {
+            for (int x = std::max(minX, 0); x <= std::min(maxX, m_Width - 1); x++) {
+                std::uint16_t mask = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        if (not InBounds(x + dx, y + dy) or IsOccupied(x + dx, y + dy)) mask |= Neighbours::Of(dx, dy);
+                    }
+                }
+                if (InBounds(x, y + 1) and IsTerrain(GetIndex(x, y + 1))) mask |= Neighbours::STATIC_BELOW;
+                m_Neighbours[GetIndex(x, y)] = mask;
+                AssignBit(m_ColumnBits, ColumnBitOf(x, y), IsOccupied(x, y));
+            }
+        }
+    }
+    // Chunks are restored by GridSnapshot one by one, each together with the cells bordering it.
+    void ComputeNeighbours(const std::size_t chunk) {
+        const int x = static_cast<int>(chunk % m_ChunksX) * CHUNK_SIZE;
+        const int y = static_cast<int>(chunk / m_ChunksX) * CHUNK_SIZE;
+        ComputeNeighbours(x - 1, y - 1, x + CHUNK_SIZE, y + CHUNK_SIZE);
+    }
+
+    // Columns start at a word of bits each.
+    std::size_t ColumnBitOf(const int x, const int y) const {
+        return static_cast<std::size_t>(x) * WordsFor(m_Height) * 64 + y;
+    }
+
+    // In tiled layouts a row of a tile is one byte of the tile's word, so a row is scanned a tile at a time.
+    int FindNextBitInRow(const std::vector<std::uint64_t>& bits, int x, const int y, const int endX) const {
+        assert(x >= 0 and endX <= m_Width and y >= 0 and y < m_Height);
+        if (m_Layout == GridLayout::RowMajor) {
+            const std::size_t rowStart = GetIndex(0, y);
+            return static_cast<int>(FindNextBit(bits, rowStart + x, rowStart + endX) - rowStart);
+        }
+        while (x < endX) {
+            const std::size_t index = GetIndex(x, y);
+            const unsigned tileRow = LoadWord(bits, index / 64) >> (y % TILE_SIZE * TILE_SIZE) & 0xFF;
+            const unsigned remaining = tileRow >> (x % TILE_SIZE);
+            if (remaining != 0) {
+                return std::min(x + std::countr_zero(remaining), endX);
+            }
+            x = (x / TILE_SIZE + 1) * TILE_SIZE;
+        }
+        return endX;
+    }
+
+    // Skips empty cells a whole word (64 cells) at a time.
+    static std::size_t FindNextBit(const std::vector<std::uint64_t>& bits, std::size_t from, const std::size_t to) {
+        while (from < to) {
+            const std::size_t wordIndex = from / 64;
+            const std::uint64_t word = LoadWord(bits, wordIndex) & (~std::uint64_t{0} << (from % 64));
+            if (word != 0) {
+                return std::min(wordIndex * 64 + std::countr_zero(word), to);
+            }
+            from = (wordIndex + 1) * 64;
+        }
+        return to;
+    }
+
+    friend class GridSnapshot;
+    friend class StateHash;
+    friend class WorldFile;
+
     const int m_Width;
     const int m_Height;
-    std::vector<std::optional<Block>> m_Blocks;
+    const GridLayout m_Layout;
+    const int m_ChunksX;
+    const int m_ChunksY;
+    const std::size_t m_RowStride; // Index distance to the cell below, within a tile in tiled layouts
+    BlockStorage m_Blocks;
+    std::vector<std::uint32_t> m_Slots; // Slot of the block in each cell, valid only for occupied cells without terrain
+    std::vector<MaterialId> m_TerrainMaterials; // Material of each cell, valid only for terrain
+    std::vector<std::uint64_t> m_OccupiedBits;
+    std::vector<std::uint64_t> m_DynamicBits;
+    std::vector<std::uint64_t> m_ActiveBits;
+    std::vector<std::uint64_t> m_TerrainBits;
+    std::vector<std::uint16_t> m_Neighbours; // Mask of each cell, see GetNeighbours()
+    std::vector<std::uint64_t> m_ColumnBits; // Occupied bits column by column, see FindSurfaceBelow()
+    std::vector<DirtyRect> m_DirtyRects; // One per chunk
+    std::vector<std::size_t> m_DirtyChunks; // Chunks with non-empty dirty rectangle, first m_DirtyChunkCount are valid
+    std::size_t m_DirtyChunkCount = 0;
+    std::vector<std::uint8_t> m_ChangedChunks; // One per chunk, see CHANGED
+    std::vector<std::uint64_t> m_ChunkVersions; // Version of each chunk as of its last snapshot, see GridSnapshot
 };
 }
@@ -0,0 +1,74 @@
+#pragma once
+#include "Block.hpp"
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+
+namespace snaps {
+
+/**
+ * Optional-like view of a single cell. It mimics `std::optional<Block>&` so that cells can be
+ * tested, dereferenced, assigned and reset the same way as before blocks were split into arrays.
+ * Accessing the block through a cell obtained from At() wakes it up, because the caller may
+ * change its velocity or add forces to it. Terrain accessed this way is unpacked, see Grid::Unpack().
+ * Shared by Grid and SparseGrid, see Grid::Cell and SparseGrid::Cell.
+ */
+template <typename GridType>
+class GridCell {
+public:
+    GridCell(GridType& grid, const std::size_t index, const bool wakeOnAccess = true)
+        : m_Grid(&grid), m_Index(index), m_WakeOnAccess(wakeOnAccess) {}
+    GridCell(const GridCell&) = default;
+
+    bool has_value() const { return m_Grid->IsOccupied(m_Index); }
+    explicit operator bool() const { return has_value(); }
+
+    BlockRef operator*() const {
+        assert(has_value());
+        if (m_Grid->IsTerrain(m_Index)) m_Grid->Unpack(m_Index);
+        if (m_WakeOnAccess) m_Grid->Wake(m_Index);
+        return m_Grid->Ref(m_Index);
+    }
+    BlockRef value() const {
+        if (not has_value()) throw std::bad_optional_access();
+        return **this;
+    }
+
+    struct Arrow {
+        BlockRef Ref;
+        BlockRef* operator->() { return &Ref; }
+    };
+    Arrow operator->() const { return {**this}; }
+
+    GridCell& operator=(const Block& block) {
+        m_Grid->Set(m_Index, block);
+        return *this;
+    }
+    GridCell& operator=(std::nullopt_t) {
+        reset();
+        return *this;
+    }
+    GridCell& operator=(const std::optional<Block>& block) {
+        if (block.has_value()) m_Grid->Set(m_Index, *block);
+        else reset();
+        return *this;
+    }
+    GridCell& operator=(const GridCell& other) {
+        return *this = static_cast<std::optional<Block>>(other);
+    }
+
+    void reset() { m_Grid->Remove(m_Index); }
+
+    operator std::optional<Block>() const {
+        return std::as_const(*m_Grid).At(m_Index);
+    }
+
+private:
+    GridType* m_Grid;
+    std::size_t m_Index;
+    bool m_WakeOnAccess;
+};
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "Grid.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * Copy of the whole state of a Grid, for rollback. Every chunk of the grid has a version that changes
+ * when the chunk does, and the snapshot remembers the version of each chunk it holds. Saving and
+ * restoring copy only the chunks whose versions differ, so a snapshot that is saved again every few
+ * frames, e.g. in a ring, costs as much as the activity in between rather than the size of the grid.
+ *
+ * Changes are tracked by the grid methods and by the engine. Writes through Grid::Ref() or
+ * Grid::Blocks() outside of a step are not noticed, assign the block to its cell instead.
+ */
+class GridSnapshot {
+public:
+    // Copies the state of the grid. The first save copies all chunks, the next ones only the changed ones.
+    void Save(Grid& grid);
+
+    // Returns the grid to the saved state. The grid must have the size and layout of the saved one.
+    void Restore(Grid& grid) const;
+
+    bool IsEmpty() const { return m_Chunks.empty(); }
+
+    // Number of chunks copied by the last Save() or Restore().
+    std::size_t CopiedChunkCount() const { return m_CopiedChunkCount; }
+
+private:
+    // Fields of a block in the pool, see BlockStorage. The cell of the block is the one it is stored for.
+    struct StoredBlock {
+        std::uint32_t Slot;
+        std::uint32_t Generation;
+        Vector2 WorldPosition;
+        Vector2 Velocity;
+        Vector2 ForceAccum;
+        Vector2 Acceleration;
+        Vector2 PreviousPosition;
+        FixedVector2 FixedPosition;
+        FixedVector2 FixedVelocity;
+        MaterialId Material;
+        BlockFlags Flags;
+        std::uint16_t RestSteps;
+    };
+
+    // A chunk is stored as its runs of cells, see Grid::GetChunkRun(), one word of bits per run.
+    // Terrain materials and blocks follow the order of the occupied cells.
+    struct StoredChunk {
+        static constexpr std::uint64_t NO_VERSION = UINT64_MAX;
+
+        std::uint64_t Version = NO_VERSION;
+        std::array<std::uint64_t, Grid::CHUNK_SIZE> OccupiedBits;
+        std::array<std::uint64_t, Grid::CHUNK_SIZE> DynamicBits;
+        std::array<std::uint64_t, Grid::CHUNK_SIZE> ActiveBits;
+        std::array<std::uint64_t, Grid::CHUNK_SIZE> TerrainBits;
+        std::vector<MaterialId> TerrainMaterials;
+        std::vector<StoredBlock> Blocks;
+    };
+
+    void SaveChunk(const Grid& grid, std::size_t chunk);
+    void RestoreChunk(Grid& grid, std::size_t chunk) const;
+
+    int m_Width = 0;
+    int m_Height = 0;
+    GridLayout m_Layout = GridLayout::RowMajor;
+    std::vector<StoredChunk> m_Chunks;
+    MaterialTable m_Materials;
+    std::size_t m_PoolSize = 0;
+    std::vector<std::uint32_t> m_FreeSlots;
+    std::vector<std::uint32_t> m_FreeGenerations; // Generation of each free slot, in the order of m_FreeSlots
+    std::vector<std::size_t> m_DirtyChunks;
+    std::vector<Grid::DirtyRect> m_DirtyRects; // One per dirty chunk, in the order of m_DirtyChunks
+    mutable std::size_t m_CopiedChunkCount = 0;
+};
+
+}
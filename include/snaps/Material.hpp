@@ -0,0 +1,53 @@
+#pragma once
+#include <raylib.h>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+
+namespace snaps {
+
+using MaterialId = std::uint8_t;
+
+// Properties shared by all blocks made of the same material.
+struct Material {
+    float InvMass = 0.5f;
+    float Friction = 1.0f;
+    float GravityScale = 1.0f;
+    Color FillColor = PINK;
+};
+
+/**
+ * Materials of a grid, addressed by MaterialId. Blocks store only the id and look the properties up
+ * here. The whole table takes a few kilobytes, so it stays in L1 cache during a step.
+ * Material 0 always exists and has default properties. Materials can be changed but not removed.
+ */
+class MaterialTable {
+public:
+    static constexpr std::size_t CAPACITY = 256;
+    static constexpr MaterialId DEFAULT = 0;
+
+    // Returns the id of the added material. Throws std::length_error when the table is full.
+    MaterialId Add(const Material& material) {
+        if (m_Count == CAPACITY) throw std::length_error("MaterialTable is full");
+        m_Materials[m_Count] = material;
+        return static_cast<MaterialId>(m_Count++);
+    }
+
+    const Material& operator[](const MaterialId id) const {
+        assert(id < m_Count);
+        return m_Materials[id];
+    }
+    Material& operator[](const MaterialId id) {
+        assert(id < m_Count);
+        return m_Materials[id];
+    }
+
+    std::size_t Size() const { return m_Count; }
+
+private:
+    std::array<Material, CAPACITY> m_Materials {};
+    std::size_t m_Count = 1;
+};
+
+}
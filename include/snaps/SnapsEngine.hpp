@@ -1,6 +1,14 @@
 #pragma once
 #include "Grid.hpp"
-#include <stack>
+#include "GridSnapshot.hpp"
+#include "SparseGrid.hpp"
+#include "StateHash.hpp"
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <variant>
+#include <vector>
 
 
 namespace snaps {
@@ -15,26 +23,140 @@ struct Config {
     // When external forces are about to stop the block unaligned, then a smooth snapping
     // mechanism is triggered moving the block towards alignment using this velocity.
     float SmoothSnappingMinVelocity = 10.0f;
+
+    // Number of consecutive steps a dynamic block must be resting before it falls asleep and is no
+    // longer simulated. Zero or less disables sleeping.
+    int SleepAfterSteps = 10;
+
+    // A block is resting when it is aligned to its tile and both components of its velocity are below
+    // this threshold.
+    float SleepVelocityThreshold = 0.01f;
+
+    // Resting block must also have horizontal acceleration below this threshold. Vertical acceleration is
+    // not considered, because gravity is balanced by whatever the block rests on.
+    float SleepAccelerationThreshold = 0.01f;
+
+    // Resolves collisions chunk by chunk in four checkerboard phases, so that chunks updated at the same
+    // time never claim the same cell. Chunks of a phase are spread over worker threads. The order in which
+    // blocks are resolved differs from the serial step, but the result doesn't depend on the thread count.
+    // Ignored by SparseSnapsEngine, see SparseGrid::SUPPORTS_PARALLEL_STEP.
+    bool ParallelStep = false;
+
+    // Resolves collisions in the order of the parallel step even when ParallelStep is off, so the result is
+    // bit-exact no matter whether the step runs in parallel and on how many threads. The library is built
+    // without contracted FMA and fast-math, so results match across runs and IEEE 754 compilers too.
+    // Meant for lockstep multiplayer and replays, see SnapsEngine::GetStateHash().
+    bool Deterministic = false;
+
+    // Simulates positions and velocities as fixed-point numbers, see Fixed, instead of floats. Every
+    // operation is integer arithmetic, so the result is the same on every platform no matter how the
+    // library is built, and blocks far from the origin move as precisely as the ones near it. Block
+    // fields keep the values rounded to floats. Combine it with Deterministic for results that don't
+    // depend on ParallelStep either.
+    bool FixedPoint = false;
+
+    // Resolves collisions in two phases instead of the bottom-up sweep, in rounds of one cell. First every
+    // block that moves records the cell it enters next. Then blocks entering the same cell are settled by a
+    // fixed priority, and a block following another one into its cell moves only if that one moves away.
+    // Both phases see the grid as it was at the beginning of the round, so the result doesn't depend on the
+    // order in which blocks are visited, and with ParallelStep they run over all blocks on worker threads.
+    bool TwoPhaseResolution = false;
+
+    // With ParallelStep, solves all dirty chunks at the same time instead of in four phases. A worker enters
+    // a cell only after claiming it with a compare-and-swap, and only resolves blocks in cells it has claimed,
+    // so blocks near chunk borders go to whichever worker gets there first. A block whose next cell has been
+    // claimed by another worker stops in front of it. The result depends on timing, so it's ignored with
+    // Deterministic and FixedPoint.
+    bool ConcurrentClaiming = false;
+
+    // Number of threads used by the parallel step, including the calling one. Zero uses all hardware threads.
+    // With ConcurrentClaiming at most 256 threads are used, see CellClaims::MAX_WORKERS.
+    int ThreadCount = 0;
+
+    // Duration of a single step run by SnapsEngine::Advance().
+    float FixedTimeStep = 1.0f / 60.0f;
+
+    // Maximum number of steps run by a single call to SnapsEngine::Advance(). When the simulation falls
+    // further behind, the remaining time is dropped, so that a slow frame doesn't make the next ones slower.
+    int MaxSubsteps = 8;
+
+    // Number of snapshots kept by SnapsEngine::SaveSnapshot(). Changing it drops the kept snapshots.
+    int SnapshotCount = 8;
 };
 
-class SnapsEngine {
+class WorkerPool;
+class CellClaims;
+
+/**
+ * Simulates blocks of a grid. GridType is either Grid or SparseGrid, the engine only uses what both
+ * of them provide. See SnapsEngine and SparseSnapsEngine.
+ */
+template <typename GridType>
+class BasicSnapsEngine {
 public:
-    explicit SnapsEngine(Grid& grid);
+    explicit BasicSnapsEngine(GridType& grid);
+    ~BasicSnapsEngine();
 
     void Step(float deltaTime);
 
+    struct StepResult {
+        int Steps = 0; // Number of steps that were run
+        bool IsAtRest = false; // True if no block needs simulation anymore
+    };
+
+    /**
+     * Runs a number of steps in a row, for fast-forwarding without rendering. Setup is done once
+     * for all steps and debug messages are not printed. The result is the same as of calling Step().
+     */
+    StepResult StepN(int steps, float deltaTime);
+
+    // Like StepN() but stops early when all blocks fall asleep. Never stops early if sleeping is disabled.
+    StepResult StepUntilSettled(int maxSteps, float deltaTime);
+
+    // True if all blocks are sleeping, so the next step would do nothing.
+    bool IsAtRest() const;
+
+    /**
+     * Advances the simulation by real elapsed time in steps of Config::FixedTimeStep. Time that doesn't
+     * fill a whole step is carried over to the next call. Returns the number of steps run.
+     */
+    int Advance(float realDeltaTime);
+
+    /**
+     * Fraction of a step carried over by Advance(), in range [0, 1). Draw blocks at
+     * `Lerp(PreviousPosition, WorldPosition, alpha)` to render between two steps.
+     */
+    float GetInterpolationAlpha() const;
+
+    /**
+     * Saves the state of the grid and the engine, configuration included, as the snapshot of `frame`,
+     * for rollback. Snapshots are kept in a ring of Config::SnapshotCount, a snapshot replaces the one
+     * taken that many frames earlier. Only chunks that changed since the replaced snapshot are copied,
+     * see GridSnapshot. Call it between steps. Only available for Grid.
+     */
+    void SaveSnapshot(std::uint64_t frame) requires std::same_as<GridType, Grid>;
+
+    /**
+     * Returns the grid and the engine to the snapshot of `frame`. Returns false if there is no snapshot
+     * of the frame anymore. Snapshots of later frames are dropped, they belong to the discarded future.
+     */
+    bool RestoreSnapshot(std::uint64_t frame) requires std::same_as<GridType, Grid>;
+
+    // Hash of the state of the grid, see StateHash. Only the chunks changed since the last call are hashed.
+    std::uint64_t GetStateHash() requires std::same_as<GridType, Grid>;
+
     Config& GetConfig() { return m_Config; }
 
 private:
+    using DirtyRect = typename GridType::DirtyRect;
     enum class CollisionPass { First, Secondary, Third };
+    bool IsParallel() const { return GridType::SUPPORTS_PARALLEL_STEP and m_Config.ParallelStep; }
+    bool IsClaimingCells() const { return IsParallel() and m_Config.ConcurrentClaiming and not m_Config.Deterministic and not m_Config.FixedPoint; }
+    StepResult RunSteps(int maxSteps, float deltaTime, bool stopAtRest);
+    void PrepareSteps(float deltaTime);
+    void ReserveScratchBuffers();
     void SimulatePhysics();
-    void SimulateMovement(int x, int y, Block& block);
-    void Integrate(Block&);
-    void SolveGridPhysics(int gridX, int gridY, CollisionPass);
-    void SolveGridPhysics(int gridX, int gridY, Block& block, CollisionPass);
-    void SecondPassGridPhysicsHorizontal();
-    void ThirdPassGridPhysicsVertical();
-
+    void LogEvent(const char* message) const;
     struct MovementResolution {
         MovementResolution(const int x, const int y, const CollisionPass pass) : X(x), Y(y), Pass(pass) {}
         int X;
@@ -43,32 +165,138 @@ private:
         bool Resolved = false;
     };
 
-    void SolveMovementHorizontal(Block&, MovementResolution&);
-    void SolveMovementRight(Block&, MovementResolution&);
-    void SolveMovementLeft(Block&, MovementResolution&);
+    struct CollisionPassCandidate {
+        int x;
+        int y;
+    };
+    // Blocks whose resolution is postponed, used as stacks. Each worker thread has its own.
+    // Vectors are reserved for the worst case, see ReserveScratchBuffers(), so a step doesn't allocate.
+    struct CollisionPassCandidates {
+        std::vector<CollisionPassCandidate> SecondPass;
+        std::vector<CollisionPassCandidate> ThirdPass;
+        int Worker = 0; // Index of the worker thread that owns the stacks, see ClaimCell()
+    };
+
+    struct RowSegment;
+    void CollectDirtySegments();
+    void ApplyForcesAndIntegrate();
+    void ApplyForcesAndIntegrateInParallel();
+    void ApplyForcesAndIntegrate(const RowSegment&, std::vector<std::uint32_t>& slots);
+    void ApplyForcesAndIntegrateFixed(const RowSegment&);
+    void UpdateFixedMaterials();
+    void SolveDirtySegments();
+    void SolveDirtyChunksInPhases();
+    void SolveDirtyChunk(const DirtyRect&, CollisionPassCandidates&);
+    void SolveDirtyChunksConcurrently();
+    bool ClaimCell(std::size_t index, const CollisionPassCandidates&);
+    MovementResolution SolveGridPhysics(int gridX, int gridY, CollisionPass, CollisionPassCandidates&);
+    void SecondPassGridPhysicsHorizontal(CollisionPassCandidates&);
+    void ThirdPassGridPhysicsVertical(CollisionPassCandidates&);
+    void UpdateActiveBlocks();
 
-    void SolveMovementVertical(Block&, MovementResolution&);
-    void SolveMovementUp(Block&, MovementResolution&);
-    void SolveMovementDown(Block&, MovementResolution&);
+    // Physics below is written once for both modes. Body is BlockRef, or FixedBlockRef with Config::FixedPoint.
+    struct FixedBlockRef;
+    FixedBlockRef FixedRef(std::size_t index);
+    template <typename Vector> Vector GetWorldPosition(std::size_t index) const;
+    template <typename Vector> Vector GetVelocity(std::size_t index) const;
 
-    void ApplyGravity(Block& block);
-    void ApplyFriction(int x, int y, Block& block);
-    void ApplyFrictionBetween(Block& block, const Block& surface);
-    void ApplyDrag(Block& block);
-    void DiscardResistanceForcesIfNecessary(int x, int y, Block& block);
+    template <typename Body> MovementResolution SolveGridPhysics(int gridX, int gridY, Body& block, CollisionPass, CollisionPassCandidates&);
+    template <typename Body> void SweepMovement(Body&, MovementResolution&, CollisionPassCandidates&);
+    template <typename Body> void FallStraight(Body&, MovementResolution&, int cells);
 
-    bool AreTouching(const Block&, const Block&) const;
+    template <typename Body> void SolveMovementHorizontal(Body&, MovementResolution&, CollisionPassCandidates&);
+    template <typename Body> void SolveMovementRight(Body&, MovementResolution&, CollisionPassCandidates&);
+    template <typename Body> void SolveMovementLeft(Body&, MovementResolution&, CollisionPassCandidates&);
 
-    Grid& m_Grid;
+    template <typename Body> void SolveMovementVertical(Body&, MovementResolution&, CollisionPassCandidates&);
+    template <typename Body> void SolveMovementUp(Body&, MovementResolution&, CollisionPassCandidates&);
+    template <typename Body> void SolveMovementDown(Body&, MovementResolution&, CollisionPassCandidates&);
 
-    struct CollisionPassCandidate {
-        int x;
-        int y;
+    template <typename Body> void ApplyFriction(int x, int y, Body& block);
+    template <typename Body, typename Vector> void ApplyFrictionBetween(Body& block, Vector surfaceVelocity, const Material& surfaceMaterial);
+    template <typename Body> void DiscardResistanceForcesIfNecessary(int x, int y, Body& block);
+
+    template <typename Vector> bool AreTouching(Vector position1, Vector position2) const;
+
+    // Config::TwoPhaseResolution, see ResolveIntents().
+    enum class IntentKind : std::uint8_t {
+        Done, // No cell left to enter in this step
+        Move, // Enters the target cell if it wins it and the cell becomes free
+        Wait, // Tries again in the next round, the block next to the target cell may move away
+        Stop  // Stops along the axis
     };
+    enum class ChainResult : std::uint8_t { Unknown, Moves, Blocked, Moved };
+    struct MoveIntent {
+        IntentKind Kind = IntentKind::Done;
+        bool Horizontal = false;
+        bool Won = false; // No other block entering the target cell has a higher priority
+        ChainResult Result = ChainResult::Unknown;
+        int TargetX = 0;
+        int TargetY = 0;
+        std::uint64_t Priority = 0; // Time since the block reached the target cell, the earliest one wins
+        std::variant<std::monostate, float, Fixed> VelocityY; // Taken over from the block below when Done
+    };
+    void ResolveIntents();
+    template <typename Body> void RunIntentRounds();
+    template <typename Body> Body RefOf(std::size_t index);
+    template <typename Body> MoveIntent DecideIntent(const Body&, int x, int y) const;
+    bool IsMover(std::size_t index) const;
+    bool WinsArbitration(std::uint32_t slot) const;
+    void ResolveChain(std::uint32_t slot, std::vector<std::uint32_t>& chain);
+    template <typename Body> void CommitIntents();
+    int CommitChain(std::uint32_t slot);
+    template <typename Function> void ForEachMover(const Function&);
+
+    GridType& m_Grid;
 
     Config m_Config;
     float m_DeltaTime = 0.0f;
-    std::stack<CollisionPassCandidate> m_SecondPassCandidates;
-    std::stack<CollisionPassCandidate> m_ThirdPassCandidates;
+    float m_TimeAccumulator = 0.0f;
+    bool m_LogEvents = true;
+    std::vector<CollisionPassCandidates> m_Candidates; // One per worker thread
+    std::vector<std::vector<std::uint32_t>> m_SegmentSlots; // Slots of active blocks in a row segment, one per worker thread
+    std::vector<std::vector<std::uint32_t>> m_Chains; // Slots of a chain of moving blocks, one per worker thread
+    std::vector<std::uint32_t> m_Movers; // Slots of blocks with cells left to enter, see ResolveIntents()
+    std::vector<MoveIntent> m_Intents; // Indexed by slot
+    std::unique_ptr<WorkerPool> m_WorkerPool;
+    std::unique_ptr<CellClaims> m_CellClaims; // Config::ConcurrentClaiming
+    bool m_ClaimingCells = false; // Set while SolveDirtyChunksConcurrently() runs
+
+    // Material properties used by Config::FixedPoint, converted at the beginning of every step.
+    struct FixedMaterial {
+        Fixed InvMass;
+        Fixed Mass;
+        Fixed GravityForce;
+    };
+    std::vector<FixedMaterial> m_FixedMaterials; // Indexed by MaterialId
+
+    struct Snapshot {
+        std::optional<std::uint64_t> Frame; // Empty for an unused place in the ring
+        GridSnapshot GridState;
+        Config EngineConfig;
+        float DeltaTime = 0.0f;
+        float TimeAccumulator = 0.0f;
+    };
+    std::vector<Snapshot> m_Snapshots; // Ring indexed by frame
+    StateHash m_StateHash;
+
+    // Row segments [MinX, EndX) of the dirty rectangles visited in the current step. Ordered by row,
+    // from top to bottom, and from left to right within a row.
+    struct RowSegment {
+        int Y;
+        int MinX;
+        int EndX;
+    };
+    std::vector<DirtyRect> m_DirtyRects;
+    std::vector<RowSegment> m_DirtySegments;
+    std::vector<const DirtyRect*> m_PhaseChunks;
+    std::vector<std::size_t> m_ColumnSegments; // Indices of dirty segments, grouped by column of chunks
+    std::vector<std::size_t> m_ColumnStarts; // Start of each group in m_ColumnSegments
 };
+
+using SnapsEngine = BasicSnapsEngine<Grid>;
+using SparseSnapsEngine = BasicSnapsEngine<SparseGrid>;
+
+extern template class BasicSnapsEngine<Grid>;
+extern template class BasicSnapsEngine<SparseGrid>;
 }
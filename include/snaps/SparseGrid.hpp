@@ -0,0 +1,589 @@
+#pragma once
+#include <cassert>
+
+#include "Block.hpp"
+#include "BlockStorage.hpp"
+#include "Grid.hpp"
+#include "GridCell.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * Unbounded grid that allocates only the chunks that hold blocks or need simulation. Coordinates
+ * can be negative. It has the same interface as Grid, so the engine runs on either of them, see
+ * SparseSnapsEngine.
+ * Chunks live in a hash map keyed by chunk coordinates. Lookups go through a small direct-mapped
+ * cache first, which holds every chunk of an 8x8 chunk neighbourhood, so stepping between cells
+ * of nearby chunks doesn't hash anything.
+ * A chunk is freed as soon as it has no blocks and nothing to simulate.
+ * Like in Grid, a BlockRef becomes invalid when a block is placed or terrain is unpacked and the pool grows.
+ * With residency enabled the grid is bounded by the chunks made resident, see EnableResidency().
+ */
+class SparseGrid {
+public:
+    static constexpr int CHUNK_SIZE = Grid::CHUNK_SIZE;
+    // Chunks are allocated and freed during the step, so the engine always steps a sparse grid serially.
+    static constexpr bool SUPPORTS_PARALLEL_STEP = false;
+
+    using DirtyRect = Grid::DirtyRect;
+
+    // Optional-like view of a single cell, see GridCell.
+    using Cell = GridCell<SparseGrid>;
+
+    /**
+     * Position of a cell together with its index. Stepping to a neighbour within the same chunk
+     * only adds a constant to the index, the index is computed again only when crossing a chunk border.
+     */
+    class Cursor {
+    public:
+        Cursor(const int x, const int y) : X(x), Y(y), Index(SparseGrid::GetIndex(x, y)) {}
+
+        Cursor Left() const { return (X & CHUNK_MASK) != 0 ? Cursor(X - 1, Y, Index - 1) : Cursor(X - 1, Y); }
+        Cursor Right() const { return ((X + 1) & CHUNK_MASK) != 0 ? Cursor(X + 1, Y, Index + 1) : Cursor(X + 1, Y); }
+        Cursor Up() const { return (Y & CHUNK_MASK) != 0 ? Cursor(X, Y - 1, Index - CHUNK_SIZE) : Cursor(X, Y - 1); }
+        Cursor Down() const { return ((Y + 1) & CHUNK_MASK) != 0 ? Cursor(X, Y + 1, Index + CHUNK_SIZE) : Cursor(X, Y + 1); }
+
+        int X;
+        int Y;
+        std::size_t Index;
+
+    private:
+        Cursor(const int x, const int y, const std::size_t index) : X(x), Y(y), Index(index) {}
+    };
+
+    SparseGrid() = default;
+    // The lookup cache points into the copied map, so copies start with an empty one.
+    SparseGrid(const SparseGrid& other)
+        : m_Blocks(other.m_Blocks), m_Chunks(other.m_Chunks), m_DirtyChunks(other.m_DirtyChunks),
+          m_ResidencyEnabled(other.m_ResidencyEnabled) {}
+    SparseGrid& operator=(const SparseGrid& other) {
+        m_Blocks = other.m_Blocks;
+        m_Chunks = other.m_Chunks;
+        m_DirtyChunks = other.m_DirtyChunks;
+        m_ChunkCache.fill({});
+        m_ResidencyEnabled = other.m_ResidencyEnabled;
+        return *this;
+    }
+
+    // Every cell exists unless residency is enabled, then only cells of resident chunks do.
+    bool InBounds(const int x, const int y) const {
+        return not m_ResidencyEnabled or FindChunk(KeyOf(GetIndex(x, y))) != nullptr;
+    }
+
+    void Remove(const int x, const int y) {
+        Remove(GetIndex(x, y));
+    }
+    void Remove(const std::size_t index) {
+        Chunk* chunk = FindChunk(KeyOf(index));
+        if (chunk and IsOccupied(index)) {
+            const std::size_t cell = LocalOf(index);
+            if (not TestBit(chunk->TerrainBits, cell)) m_Blocks.Free(chunk->Slots[cell]);
+            ClearBit(chunk->OccupiedBits, cell);
+            ClearBit(chunk->DynamicBits, cell);
+            ClearBit(chunk->ActiveBits, cell);
+            ClearBit(chunk->TerrainBits, cell);
+            chunk->BlockCount--;
+        }
+        WakeNeighbours(index);
+        if (chunk) ReleaseIfEmpty(KeyOf(index), *chunk);
+    }
+
+    /**
+     * Places a new block in the cell. A block that was there before is removed, so its id becomes invalid.
+     * Static blocks are stored as terrain, see IsTerrain().
+     */
+    void Set(const std::size_t index, const Block& block) {
+        assert(not m_ResidencyEnabled or FindChunk(KeyOf(index)));
+        Chunk& chunk = GetOrCreateChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        if (not TestBit(chunk.OccupiedBits, cell)) chunk.BlockCount++;
+        else if (not TestBit(chunk.TerrainBits, cell)) m_Blocks.Free(chunk.Slots[cell]);
+        SetBit(chunk.OccupiedBits, cell);
+        ClearBit(chunk.ActiveBits, cell);
+        if (block.IsDynamic) {
+            Store(chunk, index, block);
+            SetBit(chunk.DynamicBits, cell);
+            ClearBit(chunk.TerrainBits, cell);
+        } else {
+            chunk.TerrainMaterials[cell] = block.Material;
+            SetBit(chunk.TerrainBits, cell);
+            ClearBit(chunk.DynamicBits, cell);
+        }
+        Wake(index);
+        WakeNeighbours(index);
+    }
+
+    // Moves a block to an empty cell. Only the slot of the block is moved, the source cell becomes empty.
+    void Move(const std::size_t from, const std::size_t to) {
+        assert(IsOccupied(from) and not IsTerrain(from) and not IsOccupied(to));
+        assert(not m_ResidencyEnabled or FindChunk(KeyOf(to)));
+        Chunk& target = GetOrCreateChunk(KeyOf(to));
+        Chunk& source = *FindChunk(KeyOf(from));
+        const std::size_t fromCell = LocalOf(from);
+        const std::size_t toCell = LocalOf(to);
+        target.Slots[toCell] = source.Slots[fromCell];
+        m_Blocks.Cell[target.Slots[toCell]] = to;
+        SetBit(target.OccupiedBits, toCell);
+        target.BlockCount++;
+        if (TestBit(source.DynamicBits, fromCell)) SetBit(target.DynamicBits, toCell);
+        if (TestBit(source.ActiveBits, fromCell)) {
+            SetBit(target.ActiveBits, toCell);
+            MarkDirty(to);
+        }
+        ClearBit(source.OccupiedBits, fromCell);
+        ClearBit(source.DynamicBits, fromCell);
+        ClearBit(source.ActiveBits, fromCell);
+        source.BlockCount--;
+        WakeNeighbours(from);
+        WakeNeighbours(to);
+        ReleaseIfEmpty(KeyOf(from), source);
+    }
+
+    void Clear() {
+        for (const auto& [key, chunk] : m_Chunks) {
+            FreeSlots(chunk);
+        }
+        m_Chunks.clear();
+        m_DirtyChunks.clear();
+        m_ChunkCache.fill({});
+    }
+
+    // ----- Residency -----
+
+    /**
+     * Limits the grid to resident chunks, which are kept even when they are empty. Cells of other chunks
+     * are out of bounds, so the engine stops blocks at the border of resident chunks like at the border
+     * of a Grid. Blocks wait there until the chunk next to them is made resident. Chunks that exist when
+     * residency is enabled become resident. See ChunkStreamer.
+     */
+    void EnableResidency() { m_ResidencyEnabled = true; }
+    bool IsResidencyEnabled() const { return m_ResidencyEnabled; }
+
+    bool IsResident(const int chunkX, const int chunkY) const {
+        return FindChunk(KeyOfChunk(chunkX, chunkY)) != nullptr;
+    }
+
+    // Adds an empty chunk and wakes blocks around it, so that the ones waiting at its border move on.
+    void MakeResident(const int chunkX, const int chunkY) {
+        assert(m_ResidencyEnabled and not IsResident(chunkX, chunkY));
+        GetOrCreateChunk(KeyOfChunk(chunkX, chunkY));
+        const int minX = chunkX * CHUNK_SIZE - 1, maxX = chunkX * CHUNK_SIZE + CHUNK_SIZE;
+        const int minY = chunkY * CHUNK_SIZE - 1, maxY = chunkY * CHUNK_SIZE + CHUNK_SIZE;
+        for (int x = minX; x <= maxX; x++) {
+            Wake(GetIndex(x, minY));
+            Wake(GetIndex(x, maxY));
+        }
+        for (int y = minY + 1; y < maxY; y++) {
+            Wake(GetIndex(minX, y));
+            Wake(GetIndex(maxX, y));
+        }
+    }
+
+    // Removes the chunk together with its blocks, without waking anything. Its cells become out of bounds.
+    void Evict(const int chunkX, const int chunkY) {
+        assert(m_ResidencyEnabled and IsResident(chunkX, chunkY));
+        const std::uint64_t key = KeyOfChunk(chunkX, chunkY);
+        const Chunk& chunk = *FindChunk(key);
+        FreeSlots(chunk);
+        if (not chunk.Dirty.IsEmpty()) std::erase(m_DirtyChunks, key);
+        m_Chunks.erase(key);
+        m_ChunkCache[CacheSlotOf(key)] = {key, nullptr};
+    }
+
+    // ----- Static terrain -----
+
+    // Static blocks are stored as terrain, see Grid::IsTerrain().
+    bool IsTerrain(const std::size_t index) const {
+        const Chunk* chunk = FindChunk(KeyOf(index));
+        return chunk and TestBit(chunk->TerrainBits, LocalOf(index));
+    }
+
+    // Moves terrain of the cell to Blocks() as a regular static block, see Grid::Unpack().
+    void Unpack(const std::size_t index) {
+        assert(IsTerrain(index));
+        Chunk& chunk = *FindChunk(KeyOf(index));
+        Store(chunk, index, *std::as_const(*this).At(index));
+        ClearBit(chunk.TerrainBits, LocalOf(index));
+    }
+
+    Vector2 GetWorldPosition(const int x, const int y) const {
+        return GetWorldPosition(GetIndex(x, y));
+    }
+    Vector2 GetWorldPosition(const std::size_t index) const {
+        assert(IsOccupied(index));
+        const Chunk& chunk = *FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        if (TestBit(chunk.TerrainBits, cell)) {
+            const auto [x, y] = GetXY(index);
+            return {static_cast<float>(x * BLOCK_SIZE), static_cast<float>(y * BLOCK_SIZE)};
+        }
+        return m_Blocks.WorldPosition[chunk.Slots[cell]];
+    }
+
+    Vector2 GetVelocity(const int x, const int y) const {
+        return GetVelocity(GetIndex(x, y));
+    }
+    Vector2 GetVelocity(const std::size_t index) const {
+        assert(IsOccupied(index));
+        const Chunk& chunk = *FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        return TestBit(chunk.TerrainBits, cell) ? Vector2{0, 0} : m_Blocks.Velocity[chunk.Slots[cell]];
+    }
+
+    const Material& GetMaterial(const int x, const int y) const {
+        return GetMaterial(GetIndex(x, y));
+    }
+    const Material& GetMaterial(const std::size_t index) const {
+        assert(IsOccupied(index));
+        const Chunk& chunk = *FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        return Materials()[TestBit(chunk.TerrainBits, cell) ? chunk.TerrainMaterials[cell] : m_Blocks.Material[chunk.Slots[cell]]];
+    }
+
+    // ----- Active set -----
+
+    // Active blocks are the dynamic blocks that need simulation, see Grid::IsActive().
+    bool IsActive(const std::size_t index) const {
+        const Chunk* chunk = FindChunk(KeyOf(index));
+        return chunk and TestBit(chunk->ActiveBits, LocalOf(index));
+    }
+
+    void Wake(const std::size_t index) {
+        Chunk* chunk = FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        if (not chunk or not TestBit(chunk->DynamicBits, cell)) return;
+        const std::uint32_t slot = chunk->Slots[cell];
+        m_Blocks.RestSteps[slot] = 0;
+        if (TestBit(chunk->ActiveBits, cell)) return;
+        m_Blocks.Flags[slot].IsSleeping = false;
+        SetBit(chunk->ActiveBits, cell);
+        MarkDirty(index);
+    }
+
+    void Sleep(const std::size_t index) {
+        Chunk& chunk = *FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        m_Blocks.Flags[chunk.Slots[cell]].IsSleeping = true;
+        ClearBit(chunk.ActiveBits, cell);
+    }
+
+    // Returns x of the first active block in row `y` in range [x, endX) or `endX` if there is none.
+    // A row of a chunk is one word of bits, so missing chunks and empty rows are skipped a chunk at a time.
+    int FindNextActiveInRow(int x, const int y, const int endX) const {
+        while (x < endX) {
+            const Chunk* chunk = FindChunk(KeyOf(GetIndex(x, y)));
+            if (chunk) {
+                const std::uint64_t remaining = chunk->ActiveBits[y & CHUNK_MASK] >> (x & CHUNK_MASK);
+                if (remaining != 0) {
+                    return std::min(x + std::countr_zero(remaining), endX);
+                }
+            }
+            x = (x & ~CHUNK_MASK) + CHUNK_SIZE;
+        }
+        return endX;
+    }
+
+    // ----- Dirty rectangles -----
+
+    // Extends dirty rectangles of the chunks so that they cover the cell and its 8-neighbourhood,
+    // see Grid::MarkDirty(). Chunks that don't exist yet are allocated, unless residency is enabled.
+    void MarkDirty(const std::size_t index) {
+        const auto [x, y] = GetXY(index);
+        MarkDirty(x, y);
+    }
+    void MarkDirty(const int x, const int y) {
+        for (int chunkY = ChunkOf(y - 1); chunkY <= ChunkOf(y + 1); chunkY++) {
+            for (int chunkX = ChunkOf(x - 1); chunkX <= ChunkOf(x + 1); chunkX++) {
+                const std::uint64_t key = KeyOfChunk(chunkX, chunkY);
+                if (m_ResidencyEnabled and not FindChunk(key)) continue;
+                DirtyRect& rect = GetOrCreateChunk(key).Dirty;
+                if (rect.IsEmpty()) m_DirtyChunks.push_back(key);
+                rect.MinX = std::min(rect.MinX, std::max(x - 1, chunkX * CHUNK_SIZE));
+                rect.MinY = std::min(rect.MinY, std::max(y - 1, chunkY * CHUNK_SIZE));
+                rect.MaxX = std::max(rect.MaxX, std::min(x + 1, chunkX * CHUNK_SIZE + CHUNK_SIZE - 1));
+                rect.MaxY = std::max(rect.MaxY, std::min(y + 1, chunkY * CHUNK_SIZE + CHUNK_SIZE - 1));
+            }
+        }
+    }
+
+    /**
+     * Moves the dirty rectangles collected so far to `rects` and starts collecting anew.
+     * Rectangles are ordered by chunk, top to bottom and left to right, and never overlap.
+     * Chunks left without blocks are freed.
+     */
+    void TakeDirtyRects(std::vector<DirtyRect>& rects) {
+        rects.clear();
+        // Keys hold the row of the chunk above its column, so they sort top to bottom and left to right.
+        std::ranges::sort(m_DirtyChunks);
+        for (const std::uint64_t key : m_DirtyChunks) {
+            Chunk& chunk = *FindChunk(key);
+            rects.push_back(chunk.Dirty);
+            chunk.Dirty = {};
+            ReleaseIfEmpty(key, chunk);
+        }
+        m_DirtyChunks.clear();
+    }
+
+    bool HasDirtyRects() const { return not m_DirtyChunks.empty(); }
+
+    bool IsOccupied(const int x, const int y) const {
+        return IsOccupied(GetIndex(x, y));
+    }
+    bool IsOccupied(const std::size_t index) const {
+        const Chunk* chunk = FindChunk(KeyOf(index));
+        return chunk and TestBit(chunk->OccupiedBits, LocalOf(index));
+    }
+
+    // Dynamic bits are updated when a block is placed, moved or removed, see Grid::IsDynamic().
+    bool IsDynamic(const std::size_t index) const {
+        const Chunk* chunk = FindChunk(KeyOf(index));
+        return chunk and TestBit(chunk->DynamicBits, LocalOf(index));
+    }
+
+    /**
+     * Occupancy of the 8-neighbourhood of the cell, see Grid::GetNeighbours(). Chunks come and go, so the
+     * masks are computed from the occupancy bits instead of being stored. A row of a chunk is one word,
+     * so inside of a chunk that takes three words.
+     */
+    std::uint16_t GetNeighbours(const std::size_t index) const {
+        const auto [x, y] = GetXY(index);
+        const int cellX = x & CHUNK_MASK;
+        const int cellY = y & CHUNK_MASK;
+        if (cellX == 0 or cellY == 0 or cellX == CHUNK_MASK or cellY == CHUNK_MASK) return GetNeighboursAcrossChunks(x, y);
+        const Chunk* chunk = FindChunk(KeyOf(index));
+        if (not chunk) return m_ResidencyEnabled ? Neighbours::ALL : 0;
+        const auto row = [&](const int rowY) { return chunk->OccupiedBits[rowY] >> (cellX - 1); };
+        const std::uint64_t above = row(cellY - 1), middle = row(cellY), below = row(cellY + 1);
+        std::uint16_t mask = 0;
+        if (above & 1) mask |= Neighbours::UP_LEFT;
+        if (above & 2) mask |= Neighbours::UP;
+        if (above & 4) mask |= Neighbours::UP_RIGHT;
+        if (middle & 1) mask |= Neighbours::LEFT;
+        if (middle & 4) mask |= Neighbours::RIGHT;
+        if (below & 1) mask |= Neighbours::DOWN_LEFT;
+        if (below & 2) mask |= Neighbours::DOWN;
+        if (below & 4) mask |= Neighbours::DOWN_RIGHT;
+        if (chunk->TerrainBits[cellY + 1] >> cellX & 1) mask |= Neighbours::STATIC_BELOW;
+        return mask;
+    }
+
+    // See Grid::FindSurfaceBelow(). There are no column bits, the cells are tested one by one.
+    // Blocks fall MAX_CELLS_PER_STEP cells at most, so the range is short.
+    int FindSurfaceBelow(const int x, const int y, const int maxY) const {
+        for (int surfaceY = y + 1; surfaceY <= maxY; surfaceY++) {
+            if (not InBounds(x, surfaceY) or IsOccupied(x, surfaceY)) return surfaceY;
+        }
+        return maxY + 1;
+    }
+
+    Cell At(const int x, const int y) {
+        return {*this, GetIndex(x, y)};
+    }
+    // Like At() but doesn't wake the block up. Meant for reading neighbours during simulation.
+    Cell Peek(const int x, const int y) {
+        return {*this, GetIndex(x, y), false};
+    }
+    Cell Peek(const std::size_t index) {
+        return {*this, index, false};
+    }
+    std::optional<Block> At(const int x, const int y) const {
+        return At(GetIndex(x, y));
+    }
+    Cell At(const std::size_t index) {
+        return {*this, index};
+    }
+    std::optional<Block> At(const std::size_t index) const {
+        if (not IsOccupied(index)) return std::nullopt;
+        const Chunk& chunk = *FindChunk(KeyOf(index));
+        const std::size_t cell = LocalOf(index);
+        if (TestBit(chunk.TerrainBits, cell)) {
+            return Block { .WorldPosition = GetWorldPosition(index), .Material = chunk.TerrainMaterials[cell] };
+        }
+        return m_Blocks.Get(chunk.Slots[cell]);
+    }
+
+    // Direct access to an occupied cell, bypassing the optional-like view. Doesn't wake the block up
+    // and doesn't unpack terrain.
+    BlockRef Ref(const int x, const int y) {
+        return Ref(GetIndex(x, y));
+    }
+    BlockRef Ref(const std::size_t index) {
+        return m_Blocks.Ref(GetSlot(index));
+    }
+
+    // Slot of the block in Blocks(). Fields of the block are at this position in the storage arrays.
+    std::uint32_t GetSlot(const std::size_t index) const {
+        assert(IsOccupied(index) and not IsTerrain(index));
+        return FindChunk(KeyOf(index))->Slots[LocalOf(index)];
+    }
+
+    // ----- Block identity -----
+
+    BlockId GetBlockId(const int x, const int y) const {
+        return GetBlockId(GetIndex(x, y));
+    }
+    BlockId GetBlockId(const std::size_t index) const {
+        return m_Blocks.GetId(GetSlot(index));
+    }
+
+    // Returns the index of the cell that holds the block or nullopt if the block has been removed.
+    std::optional<std::size_t> Find(const BlockId id) const {
+        if (not m_Blocks.IsAlive(id)) return std::nullopt;
+        return m_Blocks.Cell[id.Slot];
+    }
+
+    // Number of allocated chunks.
+    std::size_t ChunkCount() const { return m_Chunks.size(); }
+
+    // Calls `function(chunkX, chunkY)` for every allocated chunk, in no particular order.
+    template <typename Function>
+    void ForEachChunk(Function&& function) const {
+        for (const auto& [key, chunk] : m_Chunks) {
+            const auto [x, y] = GetXY(key << CELL_BITS);
+            function(ChunkOf(x), ChunkOf(y));
+        }
+    }
+    // Number of blocks in Blocks(). Terrain is not counted.
+    std::size_t BlockCount() const { return m_Blocks.Count(); }
+    BlockStorage& Blocks() { return m_Blocks; }
+    const BlockStorage& Blocks() const { return m_Blocks; }
+    MaterialTable& Materials() { return m_Blocks.Materials; }
+    const MaterialTable& Materials() const { return m_Blocks.Materials; }
+
+    /**
+     * Cells of a chunk are stored row by row. The index holds coordinates of the chunk in the bits above
+     * the cell: the row of chunks in the top 26 bits and the column in the next 26 bits. Coordinates are
+     * biased, so that negative ones become positive.
+     */
+    static std::size_t GetIndex(const int x, const int y) {
+        const std::uint64_t chunkX = static_cast<std::uint64_t>(ChunkOf(x) + CHUNK_BIAS);
+        const std::uint64_t chunkY = static_cast<std::uint64_t>(ChunkOf(y) + CHUNK_BIAS);
+        const std::uint64_t cell = (y & CHUNK_MASK) * CHUNK_SIZE + (x & CHUNK_MASK);
+        return chunkY << (CHUNK_BITS + CELL_BITS) | chunkX << CELL_BITS | cell;
+    }
+    static std::pair<int, int> GetXY(const std::size_t index) {
+        const int chunkX = static_cast<int>(index >> CELL_BITS & ((std::uint64_t{1} << CHUNK_BITS) - 1)) - CHUNK_BIAS;
+        const int chunkY = static_cast<int>(index >> (CHUNK_BITS + CELL_BITS)) - CHUNK_BIAS;
+        const int cell = static_cast<int>(LocalOf(index));
+        return {chunkX * CHUNK_SIZE + cell % CHUNK_SIZE, chunkY * CHUNK_SIZE + cell / CHUNK_SIZE};
+    }
+
+    Cursor GetCursor(const int x, const int y) const {
+        return {x, y};
+    }
+
+private:
+    static constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+    static constexpr int CHUNK_SHIFT = 6;
+    static constexpr std::size_t CELLS_PER_CHUNK = CHUNK_SIZE * CHUNK_SIZE;
+    static constexpr int CELL_BITS = 12;
+    static constexpr int CHUNK_BITS = 26;
+    static constexpr int CHUNK_BIAS = 1 << (CHUNK_BITS - 1);
+    static_assert(CELLS_PER_CHUNK == std::size_t{1} << CELL_BITS);
+    static_assert(CHUNK_SIZE == 1 << CHUNK_SHIFT and CHUNK_SIZE == 64, "A row of a chunk must fill exactly one word of bits");
+
+    using ChunkBits = std::array<std::uint64_t, CHUNK_SIZE>; // One word per row of the chunk
+
+    struct Chunk {
+        std::array<std::uint32_t, CELLS_PER_CHUNK> Slots; // Valid only for occupied cells without terrain
+        std::array<MaterialId, CELLS_PER_CHUNK> TerrainMaterials; // Valid only for terrain
+        ChunkBits OccupiedBits{};
+        ChunkBits DynamicBits{};
+        ChunkBits ActiveBits{};
+        ChunkBits TerrainBits{};
+        DirtyRect Dirty;
+        int BlockCount = 0; // Occupied cells, including terrain
+    };
+    struct CacheEntry {
+        std::uint64_t Key = UINT64_MAX;
+        Chunk* Value = nullptr;
+    };
+    // Holds chunks of an 8x8 neighbourhood without collisions.
+    static constexpr std::size_t CACHE_SIZE = 64;
+
+    // Chunk coordinate of a cell coordinate. Rounds down, also for negative coordinates.
+    static int ChunkOf(const int cell) { return cell >> CHUNK_SHIFT; }
+    static std::uint64_t KeyOf(const std::size_t index) { return index >> CELL_BITS; }
+    static std::uint64_t KeyOfChunk(const int chunkX, const int chunkY) { return KeyOf(GetIndex(chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE)); }
+    static std::size_t LocalOf(const std::size_t index) { return index & (CELLS_PER_CHUNK - 1); }
+    static std::size_t CacheSlotOf(const std::uint64_t key) { return (key & 7) | (key >> CHUNK_BITS & 7) << 3; }
+
+    static void SetBit(ChunkBits& bits, const std::size_t cell) { bits[cell / 64] |= std::uint64_t{1} << (cell % 64); }
+    static void ClearBit(ChunkBits& bits, const std::size_t cell) { bits[cell / 64] &= ~(std::uint64_t{1} << (cell % 64)); }
+    static bool TestBit(const ChunkBits& bits, const std::size_t cell) { return (bits[cell / 64] >> (cell % 64)) & 1; }
+
+    // Missing chunks are cached too, until the chunk is created.
+    Chunk* FindChunk(const std::uint64_t key) const {
+        CacheEntry& entry = m_ChunkCache[CacheSlotOf(key)];
+        if (entry.Key != key) {
+            const auto chunk = m_Chunks.find(key);
+            entry = {key, chunk != m_Chunks.end() ? const_cast<Chunk*>(&chunk->second) : nullptr};
+        }
+        return entry.Value;
+    }
+
+    Chunk& GetOrCreateChunk(const std::uint64_t key) {
+        if (Chunk* chunk = FindChunk(key)) return *chunk;
+        Chunk& chunk = m_Chunks[key];
+        m_ChunkCache[CacheSlotOf(key)] = {key, &chunk};
+        return chunk;
+    }
+
+    // Chunks in the dirty list keep their rectangle until TakeDirtyRects(), so they are never freed here.
+    void ReleaseIfEmpty(const std::uint64_t key, const Chunk& chunk) {
+        if (m_ResidencyEnabled or chunk.BlockCount != 0 or not chunk.Dirty.IsEmpty()) return;
+        m_Chunks.erase(key);
+        m_ChunkCache[CacheSlotOf(key)] = {key, nullptr};
+    }
+
+    void FreeSlots(const Chunk& chunk) {
+        for (std::size_t cell = 0; cell < CELLS_PER_CHUNK; cell++) {
+            if (TestBit(chunk.OccupiedBits, cell) and not TestBit(chunk.TerrainBits, cell)) m_Blocks.Free(chunk.Slots[cell]);
+        }
+    }
+
+    // Puts the block in a new slot of Blocks().
+    void Store(Chunk& chunk, const std::size_t index, const Block& block) {
+        const std::uint32_t slot = m_Blocks.Allocate(index);
+        chunk.Slots[LocalOf(index)] = slot;
+        m_Blocks.Set(slot, block);
+        m_Blocks.RestSteps[slot] = 0;
+        m_Blocks.PreviousPosition[slot] = block.WorldPosition;
+    }
+
+    std::uint16_t GetNeighboursAcrossChunks(const int x, const int y) const {
+        std::uint16_t mask = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (not InBounds(x + dx, y + dy) or IsOccupied(x + dx, y + dy)) mask |= Neighbours::Of(dx, dy);
+            }
+        }
+        if (InBounds(x, y + 1) and IsTerrain(GetIndex(x, y + 1))) mask |= Neighbours::STATIC_BELOW;
+        return mask;
+    }
+
+    void WakeNeighbours(const std::size_t index) {
+        const auto [x, y] = GetXY(index);
+        for (int neighbourY = y - 1; neighbourY <= y + 1; neighbourY++) {
+            for (int neighbourX = x - 1; neighbourX <= x + 1; neighbourX++) {
+                if (neighbourX != x or neighbourY != y) Wake(GetIndex(neighbourX, neighbourY));
+            }
+        }
+    }
+
+    BlockStorage m_Blocks;
+    std::unordered_map<std::uint64_t, Chunk> m_Chunks; // Node based, so chunks don't move when others are added
+    std::vector<std::uint64_t> m_DirtyChunks; // Keys of chunks with non-empty dirty rectangle
+    mutable std::array<CacheEntry, CACHE_SIZE> m_ChunkCache{};
+    bool m_ResidencyEnabled = false;
+};
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Grid.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * Hash of everything in a Grid that affects the next steps: blocks with their positions, velocities,
+ * forces and flags, terrain and the active set. Peers of a lockstep game compare it every step to
+ * detect a desync in the frame it happens. Floats are hashed bit by bit, so it is only useful together
+ * with Config::Deterministic. The fixed-point state of Config::FixedPoint is hashed too.
+ *
+ * Each chunk is hashed separately and the hash of the grid is their sum, so computing it again only
+ * hashes the chunks changed since the last time. The hash doesn't depend on the layout of the grid.
+ */
+class StateHash {
+public:
+    std::uint64_t Compute(Grid& grid);
+
+private:
+    static std::uint64_t HashChunk(const Grid& grid, std::size_t chunk);
+
+    const Grid* m_Grid = nullptr;
+    std::vector<std::uint64_t> m_ChunkHashes;
+    std::uint64_t m_Sum = 0;
+};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Grid.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+
+namespace snaps {
+
+/**
+ * Binary snapshot of a whole Grid in a versioned file, engine state included, so a loaded world continues
+ * exactly where the saved one stopped. Every storage array of the grid is one section of the file, byte for
+ * byte as it is in memory, aligned to a cache line. Loading copies the sections into a new grid in bulk,
+ * without decoding blocks one by one, then checks them and rebuilds the neighbours of every cell. So the
+ * loaded grid owns its memory, and loading takes time in proportion to the size of the world.
+ * The format is native: files are portable only between machines with the same byte order.
+ */
+class WorldFile {
+public:
+    static constexpr std::uint32_t VERSION = 2;
+
+    // Returns false if the file can't be written.
+    static bool Save(const Grid& grid, const std::filesystem::path& path);
+
+    /**
+     * Returns nullopt if the file can't be read, has another version, its sections don't fit the grid,
+     * or their contents contradict each other (e.g. a cell and the slot of its block), see IsConsistent().
+     */
+    static std::optional<Grid> Load(const std::filesystem::path& path);
+
+private:
+    template <typename GridType, typename Function>
+    static void ForEachArray(GridType& grid, Function&& function);
+
+    static bool IsConsistent(const Grid& grid);
+};
+
+}
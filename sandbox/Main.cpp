@@ -2,6 +2,7 @@
 #include <raylib.h>
 #include <cmath>
 #include <iostream>
+#include <utility>
 #include <raymath.h>
 
 #include "snaps/Block.hpp"
@@ -11,6 +12,10 @@
 constexpr Color STONE_COLOR = {128, 128, 128, 255};
 constexpr Color SAND_COLOR = {194, 178, 128, 255};
 
+// Registered in main().
+static snaps::MaterialId s_Stone = snaps::MaterialTable::DEFAULT;
+static snaps::MaterialId s_Sand = snaps::MaterialTable::DEFAULT;
+
 static bool s_ShowClaims = true;
 
 namespace snaps {
@@ -20,7 +25,7 @@ bool tick = false;
 Block StoneBlock(int x, int y) {
     return Block {
         .WorldPosition = {static_cast<float>(x) * BLOCK_SIZE, static_cast<float>(y) * BLOCK_SIZE},
-        .FillColor = STONE_COLOR,
+        .Material = s_Stone,
         .IsDynamic = false
     };
 }
@@ -28,7 +33,7 @@ Block StoneBlock(int x, int y) {
 Block SandBlock(int x, int y) {
     return Block {
         .WorldPosition = {static_cast<float>(x) * BLOCK_SIZE, static_cast<float>(y) * BLOCK_SIZE},
-        .FillColor = SAND_COLOR,
+        .Material = s_Sand,
         .IsDynamic = true
     };
 }
@@ -78,7 +83,7 @@ void DrawUi(const Grid& grid) {
             for (int x = 0; x < grid.Width(); x++) {
                 const auto& block = grid.At(x, y);
                 if (block.has_value()) {
-                    Color color = block->IsDynamic ? BLUE : RED;
+                    Color color = block->IsDynamic ? (block->IsSleeping ? DARKBLUE : BLUE) : RED;
                     DrawRectangleLines(x * BLOCK_SIZE, y * BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, color);
                 }
             }
@@ -109,18 +114,18 @@ void HandleInput(Grid& grid) {
     DrawRectangleLines(worldPosX, worldPosY, BLOCK_SIZE, BLOCK_SIZE, SAND_COLOR);
 
     if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        const auto& below = grid.At(gridPosX, gridPosY+1);
+        const auto& below = std::as_const(grid).At(gridPosX, gridPosY+1);
         if (below.has_value() and below->WorldPosition.y < (gridPosY+1) * BLOCK_SIZE) return;
         grid.At(gridPosX, gridPosY) = Block {
             .WorldPosition = {static_cast<float>(worldPosX), static_cast<float>(worldPosY)},
-            .FillColor = SAND_COLOR,
+            .Material = s_Sand,
             .IsDynamic = true
         };
     }
     if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
         grid.At(gridPosX, gridPosY) = Block {
             .WorldPosition = {static_cast<float>(worldPosX), static_cast<float>(worldPosY)},
-            .FillColor = STONE_COLOR,
+            .Material = s_Stone,
             .IsDynamic = false
         };
     }
@@ -129,13 +134,14 @@ void HandleInput(Grid& grid) {
     }
 
     if (IsKeyReleased(KEY_UP)) {
-        for (auto& block : grid.Data()) {
-            if (block and block->IsDynamic) {
+        for (std::size_t i = 0; i < grid.Size(); i++) {
+            if (grid.IsDynamic(i)) {
+                auto block = grid.At(i);
                 // AddForce(*block, {0, -BOX_SIZE * 2 * GRAVITY});
                 const int distanceToJump = 12;
                 const int pixelsToJump = BLOCK_SIZE * distanceToJump + 2; // +1 to add a margin
                 const float jumpVelocity = std::sqrt(400.0f * pixelsToJump);
-                const Vector2 jumpImpulse = Vector2{0, -jumpVelocity} / block->InvMass;
+                const Vector2 jumpImpulse = Vector2{0, -jumpVelocity} / block->GetMaterial().InvMass;
                 std::cout << "jump velocity: " << jumpVelocity << std::endl;
                 std::cout << "impulse: " << jumpImpulse.y << std::endl;
                 ApplyImpulse(*block, jumpImpulse);
@@ -143,15 +149,17 @@ void HandleInput(Grid& grid) {
         }
     }
     if (IsKeyReleased(KEY_LEFT)) {
-        for (auto& block : grid.Data()) {
-            if (block and block->IsDynamic) {
+        for (std::size_t i = 0; i < grid.Size(); i++) {
+            if (grid.IsDynamic(i)) {
+                auto block = grid.At(i);
                 ApplyImpulse(*block, {-200.0f, 0});
             }
         }
     }
     if (IsKeyReleased(KEY_RIGHT)) {
-        for (auto& block : grid.Data()) {
-            if (block and block->IsDynamic) {
+        for (std::size_t i = 0; i < grid.Size(); i++) {
+            if (grid.IsDynamic(i)) {
+                auto block = grid.At(i);
                 ApplyImpulse(*block, {+333.f, 0});
             }
         }
@@ -165,10 +173,16 @@ void HandleInput(Grid& grid) {
     }
 }
 
-void Draw(const Grid& grid) {
-    for (const auto& block : grid.Data()) {
-        if (block.has_value()) {
-            DrawRectangle(static_cast<int>(block->WorldPosition.x), static_cast<int>(block->WorldPosition.y), BLOCK_SIZE, BLOCK_SIZE, block->FillColor);
+void Draw(const Grid& grid, const float alpha) {
+    const BlockStorage& blocks = grid.Blocks();
+    for (std::size_t i = 0; i < grid.Size(); i++) {
+        if (grid.IsTerrain(i)) {
+            const Vector2 position = grid.GetWorldPosition(i);
+            DrawRectangle(static_cast<int>(position.x), static_cast<int>(position.y), BLOCK_SIZE, BLOCK_SIZE, grid.GetMaterial(i).FillColor);
+        } else if (grid.IsOccupied(i)) {
+            const std::uint32_t slot = grid.GetSlot(i);
+            const Vector2 position = Vector2Lerp(blocks.PreviousPosition[slot], blocks.WorldPosition[slot], alpha);
+            DrawRectangle(static_cast<int>(position.x), static_cast<int>(position.y), BLOCK_SIZE, BLOCK_SIZE, blocks.Materials[blocks.Material[slot]].FillColor);
         }
     }
 }
@@ -184,6 +198,8 @@ int main() {
 
     snaps::Grid grid(100, 100);
     snaps::SnapsEngine engine(grid);
+    s_Stone = grid.Materials().Add({.FillColor = STONE_COLOR});
+    s_Sand = grid.Materials().Add({.FillColor = SAND_COLOR});
 
     InitializeMap(grid);
 
@@ -192,8 +208,8 @@ int main() {
         BeginDrawing(); {
             ClearBackground(BLACK);
             HandleInput(grid);
-            engine.Step(1.0f / 60.0f);
-            Draw(grid);
+            engine.Advance(GetFrameTime());
+            Draw(grid, engine.GetInterpolationAlpha());
             DrawUi(grid);
             snaps::tick = false;
         }
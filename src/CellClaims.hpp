@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * One word per cell of a grid, owned by the worker thread that has claimed the cell in the current step,
+ * see Config::ConcurrentClaiming. A word holds the number of the step next to the worker index, so claims
+ * from earlier steps expire without clearing the words.
+ */
+class CellClaims {
+public:
+    static constexpr int MAX_WORKERS = 1 << 8;
+
+    // Expires all claims. The words are allocated on the first step only, or when the grid size changes.
+    void BeginStep(const std::size_t cellCount) {
+        if (m_Words.size() != cellCount or ++m_Step == MAX_STEP) {
+            m_Words.assign(cellCount, 0);
+            m_Step = 1;
+        }
+    }
+
+    // Returns true if the cell belongs to the worker, also when it has been claimed by the same worker before.
+    // Lock-free, the word is only retried when it changes between the load and the compare-and-swap.
+    bool Claim(const std::size_t cell, const int worker) {
+        assert(worker >= 0 and worker < MAX_WORKERS);
+        const std::uint32_t claim = m_Step << WORKER_BITS | static_cast<std::uint32_t>(worker);
+        std::atomic_ref word(m_Words[cell]);
+        std::uint32_t current = word.load(std::memory_order_relaxed);
+        while (current >> WORKER_BITS != m_Step) {
+            if (word.compare_exchange_weak(current, claim, std::memory_order_relaxed)) return true;
+        }
+        return current == claim;
+    }
+
+private:
+    static constexpr int WORKER_BITS = 8;
+    static constexpr std::uint32_t MAX_STEP = std::uint32_t{1} << (32 - WORKER_BITS);
+    static_assert(MAX_WORKERS == 1 << WORKER_BITS);
+
+    std::vector<std::uint32_t> m_Words;
+    std::uint32_t m_Step = 0; // Words of earlier steps are never equal, the first step is 1
+};
+
+}
@@ -0,0 +1,352 @@
+#include "snaps/ChunkStreamer.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <utility>
+
+
+namespace snaps {
+
+namespace {
+// File of a chunk: header followed by one record per occupied cell.
+constexpr char CHUNK_MAGIC[4] = {'S', 'N', 'C', 'K'};
+constexpr std::uint32_t CHUNK_VERSION = 2;
+
+struct ChunkHeader {
+    char Magic[4];
+    std::uint32_t Version;
+    std::uint32_t BlockCount;
+};
+
+struct BlockRecord {
+    std::uint16_t Cell; // Row-major index of the cell inside the chunk
+    MaterialId Material;
+    std::uint8_t IsDynamic;
+    Vector2 WorldPosition;
+    Vector2 Velocity;
+    FixedVector2 FixedPosition;
+    FixedVector2 FixedVelocity;
+};
+
+template <typename T>
+void Append(std::vector<std::byte>& data, const T& value) {
+    const auto* bytes = reinterpret_cast<const std::byte*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T Read(const std::span<const std::byte> data, const std::size_t offset) {
+    assert(offset + sizeof(T) <= data.size());
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+// Chunk of a cell coordinate, rounding down like SparseGrid does.
+int ChunkOf(const int cell) {
+    return cell >= 0 ? cell / SparseGrid::CHUNK_SIZE : (cell + 1) / SparseGrid::CHUNK_SIZE - 1;
+}
+
+// Returns no data if there's no file, nullopt if the file can't be read.
+std::optional<std::vector<std::byte>> ReadFile(const std::filesystem::path& path) {
+    std::error_code error;
+    if (not std::filesystem::exists(path, error)) {
+        if (error) return std::nullopt;
+        return std::vector<std::byte>();
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (not file) return std::nullopt;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad()) return std::nullopt;
+    std::vector<std::byte> data(bytes.size());
+    if (not data.empty()) std::memcpy(data.data(), bytes.data(), bytes.size());
+    return data;
+}
+
+// Returns false if the file can't be written. The data goes to a temporary file that replaces the chunk
+// file once it's complete, so a failed write never leaves a truncated chunk file behind.
+bool WriteFile(const std::filesystem::path& path, const std::vector<std::byte>& data) {
+    std::error_code error;
+    if (data.empty()) {
+        std::filesystem::remove(path, error);
+        return not error;
+    }
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    file.close();
+    if (file) std::filesystem::rename(temporary, path, error);
+    if (not file or error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+// Checks the whole file before any of its blocks is put into the grid.
+bool IsValidChunk(const std::span<const std::byte> data, const std::size_t materialCount) {
+    if (data.empty()) return true; // Never saved or empty
+    constexpr std::size_t CELL_COUNT = SparseGrid::CHUNK_SIZE * SparseGrid::CHUNK_SIZE;
+    if (data.size() < sizeof(ChunkHeader)) return false;
+    const auto header = Read<ChunkHeader>(data, 0);
+    if (std::memcmp(header.Magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 or header.Version != CHUNK_VERSION
+        or header.BlockCount > CELL_COUNT or data.size() != sizeof(ChunkHeader) + header.BlockCount * sizeof(BlockRecord)) {
+        return false;
+    }
+    for (std::uint32_t i = 0; i < header.BlockCount; i++) {
+        const auto record = Read<BlockRecord>(data, sizeof(ChunkHeader) + i * sizeof(BlockRecord));
+        if (record.Cell >= CELL_COUNT or record.Material >= materialCount or record.IsDynamic > 1) return false;
+        if (not std::isfinite(record.WorldPosition.x) or not std::isfinite(record.WorldPosition.y)
+            or not std::isfinite(record.Velocity.x) or not std::isfinite(record.Velocity.y)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+ChunkStreamer::ChunkStreamer(SparseGrid& grid, std::filesystem::path directory)
+    : m_Grid(grid), m_Directory(std::move(directory))
+{
+    std::filesystem::create_directories(m_Directory);
+    m_Grid.EnableResidency();
+    m_Grid.ForEachChunk([this](const int chunkX, const int chunkY) {
+        m_Resident.insert(KeyOf(chunkX, chunkY));
+    });
+    m_IoThread = std::thread(&ChunkStreamer::IoLoop, this);
+}
+
+ChunkStreamer::~ChunkStreamer() {
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_JobQueued.notify_one();
+    m_IoThread.join();
+}
+
+std::uint64_t ChunkStreamer::KeyOf(const int chunkX, const int chunkY) {
+    return static_cast<std::uint64_t>(static_cast<std::uint32_t>(chunkY)) << 32 | static_cast<std::uint32_t>(chunkX);
+}
+
+bool ChunkStreamer::Update(const std::span<const Area> areas) {
+    m_Wanted.clear();
+    for (const Area& area : areas) {
+        const int centerX = ChunkOf(area.X);
+        const int centerY = ChunkOf(area.Y);
+        for (int chunkY = centerY - area.Radius; chunkY <= centerY + area.Radius; chunkY++) {
+            for (int chunkX = centerX - area.Radius; chunkX <= centerX + area.Radius; chunkX++) {
+                m_Wanted.insert(KeyOf(chunkX, chunkY));
+            }
+        }
+    }
+
+    FinishJobs();
+
+    // The blocks of an unloaded chunk stay in memory until its file is written.
+    for (auto it = m_Resident.begin(); it != m_Resident.end();) {
+        if (m_Wanted.contains(*it)) {
+            ++it;
+            continue;
+        }
+        const int chunkX = static_cast<std::int32_t>(*it & UINT32_MAX);
+        const int chunkY = static_cast<std::int32_t>(*it >> 32);
+        Unsaved& unsaved = m_Unsaved[*it];
+        unsaved.Data = std::make_shared<const std::vector<std::byte>>(SaveChunk(chunkX, chunkY));
+        QueueWrite(*it, unsaved);
+        m_Grid.Evict(chunkX, chunkY);
+        it = m_Resident.erase(it);
+    }
+
+    for (const std::uint64_t key : m_Wanted) {
+        if (m_Resident.contains(key) or m_Loading.contains(key) or m_Rejected.contains(key)) continue;
+        const int chunkX = static_cast<std::int32_t>(key & UINT32_MAX);
+        const int chunkY = static_cast<std::int32_t>(key >> 32);
+        if (const auto unsaved = m_Unsaved.find(key); unsaved != m_Unsaved.end()) {
+            Install(chunkX, chunkY, *unsaved->second.Data);
+            m_Unsaved.erase(unsaved);
+            continue;
+        }
+        m_Loading.insert(key);
+        Enqueue({chunkX, chunkY, false, {}});
+    }
+
+    for (auto& [key, unsaved] : m_Unsaved) {
+        if (unsaved.Failed) QueueWrite(key, unsaved);
+    }
+    return not std::exchange(m_HasFailed, false);
+}
+
+bool ChunkStreamer::Flush() {
+    {
+        std::unique_lock lock(m_Mutex);
+        m_JobDone.wait(lock, [this] { return m_Jobs.empty() and not m_IsBusy; });
+    }
+    FinishJobs();
+    return not std::exchange(m_HasFailed, false);
+}
+
+void ChunkStreamer::SaveResident() {
+    for (const std::uint64_t key : m_Resident) {
+        const int chunkX = static_cast<std::int32_t>(key & UINT32_MAX);
+        const int chunkY = static_cast<std::int32_t>(key >> 32);
+        Enqueue({chunkX, chunkY, true, std::make_shared<const std::vector<std::byte>>(SaveChunk(chunkX, chunkY))});
+    }
+}
+
+void ChunkStreamer::QueueWrite(const std::uint64_t key, Unsaved& unsaved) {
+    unsaved.Write = ++m_WriteCount;
+    unsaved.Failed = false;
+    Enqueue({static_cast<std::int32_t>(key & UINT32_MAX), static_cast<std::int32_t>(key >> 32), true, unsaved.Data, unsaved.Write});
+}
+
+void ChunkStreamer::IoLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(m_Mutex);
+            m_JobQueued.wait(lock, [this] { return m_Stopping or not m_Jobs.empty(); });
+            // Pending writes are finished before stopping, so no chunk is lost.
+            if (m_Jobs.empty()) return;
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_IsBusy = true;
+        }
+
+        const std::filesystem::path path = PathOf(job.ChunkX, job.ChunkY);
+        if (job.IsWrite) {
+            job.Succeeded = WriteFile(path, *job.Data);
+            job.Data.reset();
+        } else if (std::optional<std::vector<std::byte>> data = ReadFile(path)) {
+            job.Data = std::make_shared<const std::vector<std::byte>>(std::move(*data));
+        } else {
+            job.Succeeded = false;
+        }
+
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Finished.push_back(std::move(job));
+            m_IsBusy = false;
+        }
+        m_JobDone.notify_all();
+    }
+}
+
+void ChunkStreamer::Enqueue(Job job) {
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Jobs.push_back(std::move(job));
+    }
+    m_JobQueued.notify_one();
+}
+
+// Unsaved chunks are released once their last write succeeds. Loaded chunks that are no longer wanted
+// are dropped, their files are still up to date.
+void ChunkStreamer::FinishJobs() {
+    std::vector<Job> finished;
+    {
+        std::lock_guard lock(m_Mutex);
+        finished.swap(m_Finished);
+    }
+    for (const Job& job : finished) {
+        const std::uint64_t key = KeyOf(job.ChunkX, job.ChunkY);
+        if (job.IsWrite) {
+            const auto unsaved = m_Unsaved.find(key);
+            const bool isLast = unsaved != m_Unsaved.end() and unsaved->second.Write == job.Write;
+            if (not job.Succeeded) {
+                m_HasFailed = true;
+                if (isLast) unsaved->second.Failed = true;
+            } else if (isLast) {
+                m_Unsaved.erase(unsaved);
+            }
+            continue;
+        }
+        m_Loading.erase(key);
+        if (not m_Wanted.contains(key) or m_Resident.contains(key)) continue;
+        if (job.Succeeded) {
+            Install(job.ChunkX, job.ChunkY, *job.Data);
+        } else {
+            m_Rejected.insert(key);
+            m_HasFailed = true;
+        }
+    }
+}
+
+void ChunkStreamer::Install(const int chunkX, const int chunkY, const std::span<const std::byte> data) {
+    if (not IsValidChunk(data, m_Grid.Materials().Size())) {
+        m_Rejected.insert(KeyOf(chunkX, chunkY));
+        m_HasFailed = true;
+        return;
+    }
+    m_Grid.MakeResident(chunkX, chunkY);
+    LoadChunk(chunkX, chunkY, data);
+    m_Resident.insert(KeyOf(chunkX, chunkY));
+}
+
+std::vector<std::byte> ChunkStreamer::SaveChunk(const int chunkX, const int chunkY) const {
+    std::vector<BlockRecord> records;
+    for (int cell = 0; cell < SparseGrid::CHUNK_SIZE * SparseGrid::CHUNK_SIZE; cell++) {
+        const int x = chunkX * SparseGrid::CHUNK_SIZE + cell % SparseGrid::CHUNK_SIZE;
+        const int y = chunkY * SparseGrid::CHUNK_SIZE + cell / SparseGrid::CHUNK_SIZE;
+        const std::optional<Block> block = std::as_const(m_Grid).At(x, y);
+        if (not block) continue;
+        // Terrain has no slot, its position is given by the cell.
+        const std::size_t index = m_Grid.GetIndex(x, y);
+        const bool isTerrain = m_Grid.IsTerrain(index);
+        const BlockStorage& blocks = m_Grid.Blocks();
+        records.push_back({
+            .Cell = static_cast<std::uint16_t>(cell),
+            .Material = block->Material,
+            .IsDynamic = block->IsDynamic,
+            .WorldPosition = block->WorldPosition,
+            .Velocity = block->Velocity,
+            .FixedPosition = isTerrain ? FixedVector2() : blocks.FixedPosition[m_Grid.GetSlot(index)],
+            .FixedVelocity = isTerrain ? FixedVector2() : blocks.FixedVelocity[m_Grid.GetSlot(index)]
+        });
+    }
+    if (records.empty()) return {};
+
+    std::vector<std::byte> data;
+    data.reserve(sizeof(ChunkHeader) + records.size() * sizeof(BlockRecord));
+    ChunkHeader header {.Magic = {}, .Version = CHUNK_VERSION, .BlockCount = static_cast<std::uint32_t>(records.size())};
+    std::memcpy(header.Magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    Append(data, header);
+    for (const BlockRecord& record : records) {
+        Append(data, record);
+    }
+    return data;
+}
+
+// The data has been checked by IsValidChunk().
+void ChunkStreamer::LoadChunk(const int chunkX, const int chunkY, const std::span<const std::byte> data) {
+    if (data.empty()) return; // Never saved or empty
+    const auto header = Read<ChunkHeader>(data, 0);
+    for (std::uint32_t i = 0; i < header.BlockCount; i++) {
+        const auto record = Read<BlockRecord>(data, sizeof(ChunkHeader) + i * sizeof(BlockRecord));
+        const int x = chunkX * SparseGrid::CHUNK_SIZE + record.Cell % SparseGrid::CHUNK_SIZE;
+        const int y = chunkY * SparseGrid::CHUNK_SIZE + record.Cell / SparseGrid::CHUNK_SIZE;
+        m_Grid.At(x, y) = Block {
+            .WorldPosition = record.WorldPosition,
+            .Velocity = record.Velocity,
+            .Material = record.Material,
+            .IsDynamic = record.IsDynamic != 0
+        };
+        const std::size_t index = m_Grid.GetIndex(x, y);
+        if (not m_Grid.IsTerrain(index)) {
+            BlockStorage& blocks = m_Grid.Blocks();
+            blocks.FixedPosition[m_Grid.GetSlot(index)] = record.FixedPosition;
+            blocks.FixedVelocity[m_Grid.GetSlot(index)] = record.FixedVelocity;
+        }
+    }
+}
+
+std::filesystem::path ChunkStreamer::PathOf(const int chunkX, const int chunkY) const {
+    return m_Directory / (std::to_string(chunkX) + "_" + std::to_string(chunkY) + ".chunk");
+}
+
+}
@@ -0,0 +1,260 @@
+#include "ForceKernels.hpp"
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SNAPS_KERNELS_AVX2
+#elif defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SNAPS_KERNELS_SSE2
+#endif
+
+
+namespace snaps::kernels {
+
+namespace {
+/**
+ * Every backend processes `BLOCKS` blocks at a time, gathered from and scattered back to their slots.
+ * Vector2 fields keep X and Y components in alternate lanes. Per-block floats are read with a getter
+ * that takes a slot, see MaterialProperty(), and are duplicated to match.
+ * Min(a, b) returns `a < b ? a : b`, Max(a, b) returns `a > b ? a : b` and comparisons are false for NaN,
+ * just like in scalar code.
+ */
+struct ScalarLanes {
+    static constexpr std::size_t BLOCKS = 1;
+    struct Vec { float Lane[2]; };
+    struct Mask { bool Lane[2]; };
+
+    static Vec Load(const Vector2* v, const std::uint32_t* slots) { return {v[slots[0]].x, v[slots[0]].y}; }
+    static void Store(Vector2* v, const std::uint32_t* slots, const Vec a) { v[slots[0]] = {a.Lane[0], a.Lane[1]}; }
+    template <typename Get>
+    static Vec LoadPerBlock(const Get& get, const std::uint32_t* slots) { return {get(slots[0]), get(slots[0])}; }
+    static Vec Pair(const float x, const float y) { return {x, y}; }
+    static Vec Splat(const float f) { return {f, f}; }
+
+    template <typename Op>
+    static Vec Apply(const Vec a, const Vec b, Op op) { return {op(a.Lane[0], b.Lane[0]), op(a.Lane[1], b.Lane[1])}; }
+    template <typename Op>
+    static Mask Compare(const Vec a, const Vec b, Op op) { return {op(a.Lane[0], b.Lane[0]), op(a.Lane[1], b.Lane[1])}; }
+
+    static Vec Add(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+    static Vec Sub(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+    static Vec Mul(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+    static Vec Div(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x / y; }); }
+    static Vec Min(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    static Vec Max(const Vec a, const Vec b) { return Apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    static Vec Abs(const Vec a) { return {std::abs(a.Lane[0]), std::abs(a.Lane[1])}; }
+
+    static Mask Less(const Vec a, const Vec b) { return Compare(a, b, [](float x, float y) { return x < y; }); }
+    static Mask LessEqual(const Vec a, const Vec b) { return Compare(a, b, [](float x, float y) { return x <= y; }); }
+    static Mask Greater(const Vec a, const Vec b) { return Compare(a, b, [](float x, float y) { return x > y; }); }
+
+    static Mask And(const Mask a, const Mask b) { return {a.Lane[0] and b.Lane[0], a.Lane[1] and b.Lane[1]}; }
+    static Mask Or(const Mask a, const Mask b) { return {a.Lane[0] or b.Lane[0], a.Lane[1] or b.Lane[1]}; }
+    static Mask AndNot(const Mask a, const Mask b) { return {a.Lane[0] and not b.Lane[0], a.Lane[1] and not b.Lane[1]}; }
+    static Mask SwapPairs(const Mask a) { return {a.Lane[1], a.Lane[0]}; }
+    static Mask XLanes() { return {true, false}; }
+    static int Count(const Mask m) { return m.Lane[0] + m.Lane[1]; } // Number of lanes that are set
+
+    static Vec Select(const Mask m, const Vec a, const Vec b) {
+        return {m.Lane[0] ? a.Lane[0] : b.Lane[0], m.Lane[1] ? a.Lane[1] : b.Lane[1]};
+    }
+    static Mask Select(const Mask m, const Mask a, const Mask b) {
+        return {m.Lane[0] ? a.Lane[0] : b.Lane[0], m.Lane[1] ? a.Lane[1] : b.Lane[1]};
+    }
+};
+
+#if defined(SNAPS_KERNELS_AVX2) or defined(SNAPS_KERNELS_SSE2)
+// Two Vector2 from arbitrary slots in a single register and back.
+__m128 LoadTwo(const Vector2* v, const std::uint32_t* slots) {
+    const __m128 low = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&v[slots[0]])));
+    return _mm_loadh_pi(low, reinterpret_cast<const __m64*>(&v[slots[1]]));
+}
+void StoreTwo(Vector2* v, const std::uint32_t* slots, const __m128 a) {
+    _mm_storel_pi(reinterpret_cast<__m64*>(&v[slots[0]]), a);
+    _mm_storeh_pi(reinterpret_cast<__m64*>(&v[slots[1]]), a);
+}
+#endif
+
+#if defined(SNAPS_KERNELS_AVX2)
+struct SimdLanes {
+    static constexpr std::size_t BLOCKS = 4;
+    using Vec = __m256;
+    using Mask = __m256;
+
+    static Vec Load(const Vector2* v, const std::uint32_t* slots) {
+        return _mm256_set_m128(LoadTwo(v, slots + 2), LoadTwo(v, slots));
+    }
+    static void Store(Vector2* v, const std::uint32_t* slots, const Vec a) {
+        StoreTwo(v, slots, _mm256_castps256_ps128(a));
+        StoreTwo(v, slots + 2, _mm256_extractf128_ps(a, 1));
+    }
+    template <typename Get>
+    static Vec LoadPerBlock(const Get& get, const std::uint32_t* slots) {
+        const float a = get(slots[0]), b = get(slots[1]), c = get(slots[2]), d = get(slots[3]);
+        return _mm256_setr_ps(a, a, b, b, c, c, d, d);
+    }
+    static Vec Pair(const float x, const float y) { return _mm256_setr_ps(x, y, x, y, x, y, x, y); }
+    static Vec Splat(const float f) { return _mm256_set1_ps(f); }
+
+    static Vec Add(const Vec a, const Vec b) { return _mm256_add_ps(a, b); }
+    static Vec Sub(const Vec a, const Vec b) { return _mm256_sub_ps(a, b); }
+    static Vec Mul(const Vec a, const Vec b) { return _mm256_mul_ps(a, b); }
+    static Vec Div(const Vec a, const Vec b) { return _mm256_div_ps(a, b); }
+    static Vec Min(const Vec a, const Vec b) { return _mm256_min_ps(a, b); }
+    static Vec Max(const Vec a, const Vec b) { return _mm256_max_ps(a, b); }
+    static Vec Abs(const Vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+    static Mask Less(const Vec a, const Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask LessEqual(const Vec a, const Vec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask Greater(const Vec a, const Vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+    static Mask And(const Mask a, const Mask b) { return _mm256_and_ps(a, b); }
+    static Mask Or(const Mask a, const Mask b) { return _mm256_or_ps(a, b); }
+    static Mask AndNot(const Mask a, const Mask b) { return _mm256_andnot_ps(b, a); }
+    static Mask SwapPairs(const Mask a) { return _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)); }
+    static Mask XLanes() { return _mm256_castsi256_ps(_mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0)); }
+    static int Count(const Mask m) { return std::popcount(static_cast<unsigned>(_mm256_movemask_ps(m))); }
+
+    static Vec Select(const Mask m, const Vec a, const Vec b) { return _mm256_blendv_ps(b, a, m); }
+};
+#elif defined(SNAPS_KERNELS_SSE2)
+struct SimdLanes {
+    static constexpr std::size_t BLOCKS = 2;
+    using Vec = __m128;
+    using Mask = __m128;
+
+    static Vec Load(const Vector2* v, const std::uint32_t* slots) { return LoadTwo(v, slots); }
+    static void Store(Vector2* v, const std::uint32_t* slots, const Vec a) { StoreTwo(v, slots, a); }
+    template <typename Get>
+    static Vec LoadPerBlock(const Get& get, const std::uint32_t* slots) {
+        const float a = get(slots[0]), b = get(slots[1]);
+        return _mm_setr_ps(a, a, b, b);
+    }
+    static Vec Pair(const float x, const float y) { return _mm_setr_ps(x, y, x, y); }
+    static Vec Splat(const float f) { return _mm_set1_ps(f); }
+
+    static Vec Add(const Vec a, const Vec b) { return _mm_add_ps(a, b); }
+    static Vec Sub(const Vec a, const Vec b) { return _mm_sub_ps(a, b); }
+    static Vec Mul(const Vec a, const Vec b) { return _mm_mul_ps(a, b); }
+    static Vec Div(const Vec a, const Vec b) { return _mm_div_ps(a, b); }
+    static Vec Min(const Vec a, const Vec b) { return _mm_min_ps(a, b); }
+    static Vec Max(const Vec a, const Vec b) { return _mm_max_ps(a, b); }
+    static Vec Abs(const Vec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    static Mask Less(const Vec a, const Vec b) { return _mm_cmplt_ps(a, b); }
+    static Mask LessEqual(const Vec a, const Vec b) { return _mm_cmple_ps(a, b); }
+    static Mask Greater(const Vec a, const Vec b) { return _mm_cmpgt_ps(a, b); }
+
+    static Mask And(const Mask a, const Mask b) { return _mm_and_ps(a, b); }
+    static Mask Or(const Mask a, const Mask b) { return _mm_or_ps(a, b); }
+    static Mask AndNot(const Mask a, const Mask b) { return _mm_andnot_ps(b, a); }
+    static Mask SwapPairs(const Mask a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+    static Mask XLanes() { return _mm_castsi128_ps(_mm_setr_epi32(-1, 0, -1, 0)); }
+    static int Count(const Mask m) { return std::popcount(static_cast<unsigned>(_mm_movemask_ps(m))); }
+
+    static Vec Select(const Mask m, const Vec a, const Vec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#else
+using SimdLanes = ScalarLanes;
+#endif
+
+// Getter of a material property of the block in a slot, for LoadPerBlock().
+template <float Material::*Property>
+auto MaterialProperty(const BlockStorage& blocks) {
+    return [&blocks](const std::uint32_t slot) { return blocks.Materials[blocks.Material[slot]].*Property; };
+}
+
+// Calls `kernel` for groups of SimdLanes::BLOCKS slots. The remaining slots go one by one through ScalarLanes.
+template <typename Kernel>
+void ForEachGroup(const std::span<const std::uint32_t> slots, Kernel&& kernel) {
+    constexpr std::size_t BLOCKS = SimdLanes::BLOCKS;
+    std::size_t i = 0;
+    for (; i + BLOCKS <= slots.size(); i += BLOCKS) {
+        kernel.template operator()<SimdLanes>(&slots[i]);
+    }
+    for (; i < slots.size(); i++) {
+        kernel.template operator()<ScalarLanes>(&slots[i]);
+    }
+}
+} // namespace
+
+void ApplyGravity(BlockStorage& blocks, const std::span<const std::uint32_t> slots, const float gravity) {
+    ForEachGroup(slots, [&]<typename L>(const std::uint32_t* s) {
+        const auto force = L::Load(blocks.ForceAccum.data(), s);
+        const auto scale = L::LoadPerBlock(MaterialProperty<&Material::GravityScale>(blocks), s);
+        const auto invMass = L::LoadPerBlock(MaterialProperty<&Material::InvMass>(blocks), s);
+        const auto gravityForce = L::Div(L::Mul(L::Pair(0.0f, gravity), scale), invMass);
+        L::Store(blocks.ForceAccum.data(), s, L::Add(force, gravityForce));
+    });
+}
+
+int ApplyDrag(BlockStorage& blocks, const std::span<const std::uint32_t> slots, const float drag, const float deltaTime) {
+    int stopped = 0;
+    ForEachGroup(slots, [&]<typename L>(const std::uint32_t* s) {
+        const auto velocity = L::Load(blocks.Velocity.data(), s);
+        const auto force = L::Load(blocks.ForceAccum.data(), s);
+        const auto invMass = L::LoadPerBlock(MaterialProperty<&Material::InvMass>(blocks), s);
+        const auto speed = L::Abs(velocity);
+
+        // If the block is almost stationary, skip to avoid tiny forces.
+        const auto slow = L::Select(L::XLanes(), L::Less(speed, L::Splat(0.01f)), L::LessEqual(speed, L::Splat(0.01f)));
+        const auto stationary = L::And(slow, L::SwapPairs(slow));
+        const auto skip = L::Or(L::LessEqual(invMass, L::Splat(0.0f)), stationary);
+
+        // Drag must not reverse the horizontal velocity. Only X lanes matter for the limit.
+        const auto acceleration = L::Mul(force, invMass);
+        const auto finalVelocity = L::Add(velocity, L::Mul(acceleration, L::Splat(deltaTime)));
+        const auto mass = L::Div(L::Splat(1.0f), invMass);
+        const auto maxForce = L::Div(L::Mul(mass, finalVelocity), L::Splat(deltaTime));
+        auto dragForce = L::Mul(velocity, L::Splat(drag));
+        const auto limited = L::And(L::XLanes(), L::Greater(L::Abs(dragForce), L::Abs(maxForce)));
+        dragForce = L::Select(limited, maxForce, dragForce);
+        stopped += L::Count(L::AndNot(limited, skip));
+
+        // Don't apply drag for slow objects to reduce snapping.
+        dragForce = L::Select(L::Less(speed, L::Splat(1.0f / deltaTime)), L::Splat(0.0f), dragForce);
+
+        L::Store(blocks.ForceAccum.data(), s, L::Select(skip, force, L::Sub(force, dragForce)));
+    });
+    return stopped;
+}
+
+void Integrate(BlockStorage& blocks, const std::span<const std::uint32_t> slots, const float deltaTime) {
+    constexpr float maxDistance = MAX_CELLS_PER_STEP * BLOCK_SIZE;
+    const float maxSpeed = maxDistance / deltaTime;
+    ForEachGroup(slots, [&]<typename L>(const std::uint32_t* s) {
+        const auto invMass = L::LoadPerBlock(MaterialProperty<&Material::InvMass>(blocks), s);
+        const auto skip = L::LessEqual(invMass, L::Splat(0.0f));
+        const auto force = L::Load(blocks.ForceAccum.data(), s);
+        const auto oldAcceleration = L::Load(blocks.Acceleration.data(), s);
+        const auto oldVelocity = L::Load(blocks.Velocity.data(), s);
+        const auto oldPosition = L::Load(blocks.WorldPosition.data(), s);
+
+        const auto acceleration = L::Mul(force, invMass);
+        auto velocity = L::Add(oldVelocity, L::Mul(acceleration, L::Splat(deltaTime)));
+
+        // Realistically, any velocity smaller than 1.0/DeltaTime will not move the object in a pixel space.
+        velocity = L::Select(L::Less(L::Abs(velocity), L::Splat(0.01f)), L::Splat(0.0f), velocity);
+        // Keeps the velocity in line with the distance the block can travel.
+        velocity = L::Max(L::Splat(-maxSpeed), L::Min(L::Splat(maxSpeed), velocity));
+
+        const auto distance = L::Max(L::Splat(-maxDistance), L::Min(L::Splat(maxDistance), L::Mul(velocity, L::Splat(deltaTime))));
+        const auto position = L::Add(oldPosition, distance);
+
+        L::Store(blocks.Acceleration.data(), s, L::Select(skip, oldAcceleration, acceleration));
+        L::Store(blocks.Velocity.data(), s, L::Select(skip, oldVelocity, velocity));
+        L::Store(blocks.WorldPosition.data(), s, L::Select(skip, oldPosition, position));
+        L::Store(blocks.PreviousPosition.data(), s, oldPosition);
+        L::Store(blocks.ForceAccum.data(), s, L::Select(skip, force, L::Splat(0.0f)));
+
+        for (std::size_t block = 0; block < L::BLOCKS; block++) {
+            if (blocks.Materials[blocks.Material[s[block]]].InvMass > 0.0f) {
+                blocks.Flags[s[block]].NeedsCollisionResolution = true;
+            }
+        }
+    });
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "snaps/BlockStorage.hpp"
+#include <cstdint>
+#include <span>
+
+
+namespace snaps::kernels {
+
+/**
+ * Pure-math parts of the force-and-integration phase. Each kernel updates blocks at the given `slots`
+ * of the storage, which must be distinct. Blocks don't depend on each other here, so they are processed
+ * several at once in SIMD lanes (AVX2 or SSE2, depending on the target) and the remaining ones one by one.
+ * Both paths run the same code and give bit-identical results.
+ */
+void ApplyGravity(BlockStorage& blocks, std::span<const std::uint32_t> slots, float gravity);
+// Returns the number of blocks whose horizontal drag has been limited, so that it stops them instead of reversing them.
+int ApplyDrag(BlockStorage& blocks, std::span<const std::uint32_t> slots, float drag, float deltaTime);
+// Also records the position from before the step in PreviousPosition. Velocity is limited to MAX_CELLS_PER_STEP cells per step.
+void Integrate(BlockStorage& blocks, std::span<const std::uint32_t> slots, float deltaTime);
+
+}
@@ -0,0 +1,191 @@
+#include "snaps/GridSnapshot.hpp"
+#include <atomic>
+#include <bit>
+#include <cassert>
+
+
+namespace snaps {
+
+namespace {
+// Versions are unique among all grids, so a copy of a grid never mistakes its chunks for the original ones.
+// Version 0 is an empty chunk of a new grid.
+std::uint64_t NextVersion() {
+    static std::atomic<std::uint64_t> lastVersion = 0;
+    return lastVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+std::uint64_t LengthMask(const int length) {
+    return length == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << length) - 1;
+}
+
+// Bits [start, start + length) of the array, the run can span two words.
+std::uint64_t ReadBits(const std::vector<std::uint64_t>& bits, const std::size_t start, const int length) {
+    const std::size_t word = start / 64;
+    const unsigned shift = start % 64;
+    std::uint64_t value = bits[word] >> shift;
+    if (shift != 0 and shift + length > 64) value |= bits[word + 1] << (64 - shift);
+    return value & LengthMask(length);
+}
+
+void WriteBits(std::vector<std::uint64_t>& bits, const std::size_t start, const int length, const std::uint64_t value) {
+    const std::size_t word = start / 64;
+    const unsigned shift = start % 64;
+    const std::uint64_t mask = LengthMask(length);
+    bits[word] = (bits[word] & ~(mask << shift)) | value << shift;
+    if (shift != 0 and shift + length > 64) {
+        bits[word + 1] = (bits[word + 1] & ~(mask >> (64 - shift))) | value >> (64 - shift);
+    }
+}
+} // namespace
+
+void GridSnapshot::Save(Grid& grid) {
+    if (grid.Width() != m_Width or grid.Height() != m_Height or grid.Layout() != m_Layout) {
+        m_Width = grid.Width();
+        m_Height = grid.Height();
+        m_Layout = grid.Layout();
+        m_Chunks.assign(grid.ChunkCount(), {});
+    }
+
+    m_CopiedChunkCount = 0;
+    for (std::size_t chunk = 0; chunk < m_Chunks.size(); chunk++) {
+        if (grid.m_ChangedChunks[chunk] & Grid::CHANGED_SINCE_SNAPSHOT) {
+            grid.m_ChunkVersions[chunk] = NextVersion();
+            grid.m_ChangedChunks[chunk] &= ~Grid::CHANGED_SINCE_SNAPSHOT;
+        }
+        if (m_Chunks[chunk].Version == grid.m_ChunkVersions[chunk]) continue;
+        SaveChunk(grid, chunk);
+        m_CopiedChunkCount++;
+    }
+
+    const BlockStorage& blocks = grid.m_Blocks;
+    m_Materials = blocks.Materials;
+    m_PoolSize = blocks.Size();
+    m_FreeSlots = blocks.m_FreeSlots;
+    m_FreeGenerations.clear();
+    for (const std::uint32_t slot : m_FreeSlots) {
+        m_FreeGenerations.push_back(blocks.Generation[slot]);
+    }
+
+    m_DirtyChunks.assign(grid.m_DirtyChunks.begin(), grid.m_DirtyChunks.begin() + grid.m_DirtyChunkCount);
+    m_DirtyRects.clear();
+    for (const std::size_t chunk : m_DirtyChunks) {
+        m_DirtyRects.push_back(grid.m_DirtyRects[chunk]);
+    }
+}
+
+void GridSnapshot::Restore(Grid& grid) const {
+    assert(not IsEmpty() and grid.Width() == m_Width and grid.Height() == m_Height and grid.Layout() == m_Layout);
+    BlockStorage& blocks = grid.m_Blocks;
+    // Slots allocated after the save are dropped, the cells that held them are restored below.
+    blocks.ForEachArray([this](auto& array) { array.resize(m_PoolSize); });
+
+    m_CopiedChunkCount = 0;
+    for (std::size_t chunk = 0; chunk < m_Chunks.size(); chunk++) {
+        const bool isChanged = grid.m_ChangedChunks[chunk] & Grid::CHANGED_SINCE_SNAPSHOT;
+        if (not isChanged and grid.m_ChunkVersions[chunk] == m_Chunks[chunk].Version) continue;
+        RestoreChunk(grid, chunk);
+        grid.ComputeNeighbours(chunk);
+        grid.m_ChunkVersions[chunk] = m_Chunks[chunk].Version;
+        grid.m_ChangedChunks[chunk] = Grid::CHANGED_SINCE_HASH;
+        m_CopiedChunkCount++;
+    }
+
+    blocks.Materials = m_Materials;
+    blocks.m_FreeSlots = m_FreeSlots;
+    for (std::size_t i = 0; i < m_FreeSlots.size(); i++) {
+        blocks.Generation[m_FreeSlots[i]] = m_FreeGenerations[i];
+        blocks.Cell[m_FreeSlots[i]] = BlockStorage::NO_CELL;
+    }
+
+    for (std::size_t i = 0; i < grid.m_DirtyChunkCount; i++) {
+        grid.m_DirtyRects[grid.m_DirtyChunks[i]] = {};
+    }
+    for (std::size_t i = 0; i < m_DirtyChunks.size(); i++) {
+        grid.m_DirtyChunks[i] = m_DirtyChunks[i];
+        grid.m_DirtyRects[m_DirtyChunks[i]] = m_DirtyRects[i];
+    }
+    grid.m_DirtyChunkCount = m_DirtyChunks.size();
+}
+
+void GridSnapshot::SaveChunk(const Grid& grid, const std::size_t chunk) {
+    const BlockStorage& blocks = grid.m_Blocks;
+    StoredChunk& stored = m_Chunks[chunk];
+    stored.Version = grid.m_ChunkVersions[chunk];
+    stored.TerrainMaterials.clear();
+    stored.Blocks.clear();
+    for (int run = 0; run < Grid::CHUNK_SIZE; run++) {
+        const auto [start, length] = grid.GetChunkRun(chunk, run);
+        if (length == 0) {
+            stored.OccupiedBits[run] = stored.DynamicBits[run] = stored.ActiveBits[run] = stored.TerrainBits[run] = 0;
+            continue;
+        }
+        stored.OccupiedBits[run] = ReadBits(grid.m_OccupiedBits, start, length);
+        stored.DynamicBits[run] = ReadBits(grid.m_DynamicBits, start, length);
+        stored.ActiveBits[run] = ReadBits(grid.m_ActiveBits, start, length);
+        stored.TerrainBits[run] = ReadBits(grid.m_TerrainBits, start, length);
+
+        for (std::uint64_t occupied = stored.OccupiedBits[run]; occupied != 0; occupied &= occupied - 1) {
+            const std::size_t index = start + std::countr_zero(occupied);
+            if (grid.IsTerrain(index)) {
+                stored.TerrainMaterials.push_back(grid.m_TerrainMaterials[index]);
+                continue;
+            }
+            const std::uint32_t slot = grid.m_Slots[index];
+            stored.Blocks.push_back({
+                .Slot = slot,
+                .Generation = blocks.Generation[slot],
+                .WorldPosition = blocks.WorldPosition[slot],
+                .Velocity = blocks.Velocity[slot],
+                .ForceAccum = blocks.ForceAccum[slot],
+                .Acceleration = blocks.Acceleration[slot],
+                .PreviousPosition = blocks.PreviousPosition[slot],
+                .FixedPosition = blocks.FixedPosition[slot],
+                .FixedVelocity = blocks.FixedVelocity[slot],
+                .Material = blocks.Material[slot],
+                .Flags = blocks.Flags[slot],
+                .RestSteps = blocks.RestSteps[slot]
+            });
+        }
+    }
+}
+
+void GridSnapshot::RestoreChunk(Grid& grid, const std::size_t chunk) const {
+    BlockStorage& blocks = grid.m_Blocks;
+    const StoredChunk& stored = m_Chunks[chunk];
+    auto terrainMaterial = stored.TerrainMaterials.begin();
+    auto block = stored.Blocks.begin();
+    for (int run = 0; run < Grid::CHUNK_SIZE; run++) {
+        const auto [start, length] = grid.GetChunkRun(chunk, run);
+        if (length == 0) continue;
+        WriteBits(grid.m_OccupiedBits, start, length, stored.OccupiedBits[run]);
+        WriteBits(grid.m_DynamicBits, start, length, stored.DynamicBits[run]);
+        WriteBits(grid.m_ActiveBits, start, length, stored.ActiveBits[run]);
+        WriteBits(grid.m_TerrainBits, start, length, stored.TerrainBits[run]);
+
+        for (std::uint64_t occupied = stored.OccupiedBits[run]; occupied != 0; occupied &= occupied - 1) {
+            const std::size_t index = start + std::countr_zero(occupied);
+            if (grid.IsTerrain(index)) {
+                grid.m_TerrainMaterials[index] = *terrainMaterial++;
+                continue;
+            }
+            const std::uint32_t slot = block->Slot;
+            grid.m_Slots[index] = slot;
+            blocks.Generation[slot] = block->Generation;
+            blocks.Cell[slot] = index;
+            blocks.WorldPosition[slot] = block->WorldPosition;
+            blocks.Velocity[slot] = block->Velocity;
+            blocks.ForceAccum[slot] = block->ForceAccum;
+            blocks.Acceleration[slot] = block->Acceleration;
+            blocks.PreviousPosition[slot] = block->PreviousPosition;
+            blocks.FixedPosition[slot] = block->FixedPosition;
+            blocks.FixedVelocity[slot] = block->FixedVelocity;
+            blocks.Material[slot] = block->Material;
+            blocks.Flags[slot] = block->Flags;
+            blocks.RestSteps[slot] = block->RestSteps;
+            ++block;
+        }
+    }
+    assert(terrainMaterial == stored.TerrainMaterials.end() and block == stored.Blocks.end());
+}
+
+}
@@ -1,222 +1,977 @@
 #include "snaps/SnapsEngine.hpp"
 #include "snaps/Block.hpp"
+#include "CellClaims.hpp"
+#include "ForceKernels.hpp"
+#include "WorkerPool.hpp"
 #include <raymath.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cfloat>
+#include <climits>
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Config::Deterministic relies on every float operation being rounded the same way everywhere.
+#if defined(__FAST_MATH__)
+#error "Snaps must not be built with -ffast-math, results of the simulation would not be reproducible"
+#endif
+#if FLT_EVAL_METHOD != 0
+#error "Snaps needs float expressions evaluated in float precision, results would not be reproducible"
+#endif
+static_assert(std::numeric_limits<float>::is_iec559, "Snaps needs IEEE 754 floats");
 
 
 namespace snaps {
 
 namespace {
+// Physics is written once for floats and for Fixed, see Config::FixedPoint. These overloads differ.
+template <typename Body> using VectorOf = std::remove_cvref_t<decltype(std::declval<Body&>().WorldPosition)>;
+template <typename Body> using RealOf = decltype(VectorOf<Body>::x);
+
+constexpr int BLOCK_SIZE_BITS = std::countr_zero(static_cast<unsigned>(BLOCK_SIZE));
+static_assert(std::has_single_bit(static_cast<unsigned>(BLOCK_SIZE)), "Fixed-point cells are found with a shift");
+
+// Square root is correctly rounded by IEEE 754, so it gives the same result on every conforming platform.
 float MinVelocityForDistance(float deceleration, float distance = BLOCK_SIZE) {
     return std::sqrt(2.0f * deceleration * distance);
 }
+// A negative product gives NaN above, which is never greater than a velocity, just like Max().
+Fixed MinVelocityForDistance(const Fixed deceleration, const Fixed distance = Fixed(BLOCK_SIZE)) {
+    const Fixed product = deceleration * 2 * distance;
+    return product < Fixed() ? Fixed::Max() : Sqrt(product);
+}
+
+float Abs(const float value) {
+    return std::abs(value);
+}
+
+float Sqrt(const float value) {
+    return std::sqrt(value);
+}
+
+float CopySign(const float magnitude, const float sign) {
+    return std::copysign(magnitude, sign);
+}
+Fixed CopySign(const Fixed magnitude, const Fixed sign) {
+    return sign < Fixed() ? -magnitude : magnitude;
+}
+
+// Cell that contains the coordinate.
+int CellOf(const float coordinate) {
+    return static_cast<int>(std::floor(coordinate / BLOCK_SIZE));
+}
+int CellOf(const Fixed coordinate) {
+    return static_cast<int>(coordinate.Raw() >> (Fixed::FRACTION_BITS + BLOCK_SIZE_BITS));
+}
+
+// Coordinate of the top-left corner of the cell.
+template <typename Real>
+Real CellStart(const int cell) {
+    return static_cast<Real>(cell) * BLOCK_SIZE;
+}
 
-void StopBlockAndAlignToX(Block& block, int gridX) {
-    block.WorldPosition.x = static_cast<float>(gridX) * BLOCK_SIZE;
-    block.Velocity.x = 0.0f;
+// Number of cells between the cell of the block and the one its leading edge has reached along an axis.
+template <typename Real>
+int CellsAhead(const Real position, const Real velocity, const int cell) {
+    if (velocity > Real()) return CellOf(position + static_cast<Real>(BLOCK_SIZE)) - cell;
+    if (velocity < Real()) return cell - CellOf(position);
+    return 0;
 }
 
-void StopBlockAndAlignToY(Block& block, int gridY) {
-    block.WorldPosition.y = static_cast<float>(gridY) * BLOCK_SIZE;
-    block.Velocity.y = 0.0f;
+// Time since the leading edge of the block crossed the border of its cell along an axis, see CellsAhead().
+template <typename Real>
+Real TimeSinceCrossing(const Real position, const Real velocity, const int cell) {
+    const Real distance = velocity > Real() ? position - CellStart<Real>(cell) : CellStart<Real>(cell) - position;
+    return distance / Abs(velocity);
 }
 
-Vector2 ClampToBlockSize(Vector2&& vec) {
-    vec.x = std::min(vec.x, static_cast<float>(BLOCK_SIZE));
-    vec.y = std::min(vec.y, static_cast<float>(BLOCK_SIZE));
-    return vec;
+// Where the block was along an axis `time` before it reached `position`, but not past the border of `cell`
+// that it hadn't crossed yet. Moves the block back the way the integration moved it forward.
+template <typename Real>
+Real PositionBefore(const Real position, const Real velocity, const Real time, const int cell) {
+    const Real maxDistance(MAX_CELLS_PER_STEP * BLOCK_SIZE);
+    const Real before = position - std::clamp(velocity * time, -maxDistance, maxDistance);
+    if (velocity > Real()) return std::min(before, CellStart<Real>(cell));
+    if (velocity < Real()) return std::max(before, CellStart<Real>(cell));
+    return position;
+}
+
+template <typename Body>
+void StopBlockAndAlignToX(Body& block, int gridX) {
+    block.WorldPosition.x = CellStart<RealOf<Body>>(gridX);
+    block.Velocity.x = {};
+}
+
+template <typename Body>
+void StopBlockAndAlignToY(Body& block, int gridY) {
+    block.WorldPosition.y = CellStart<RealOf<Body>>(gridY);
+    block.Velocity.y = {};
+}
+
+// Counterpart of Grid::LoadVelocity(), for blocks that other workers may read at the same time.
+void StoreVector(Vector2& target, const Vector2 value) {
+    std::atomic_ref(target.x).store(value.x, std::memory_order_relaxed);
+    std::atomic_ref(target.y).store(value.y, std::memory_order_relaxed);
+}
+
+// Times since crossing are never negative, so their order is the order of the integers, see MoveIntent::Priority.
+std::uint64_t PriorityOf(const float time) {
+    return std::bit_cast<std::uint32_t>(time);
+}
+std::uint64_t PriorityOf(const Fixed time) {
+    return static_cast<std::uint64_t>(time.Raw());
+}
+
+// Chunk coordinate of a cell coordinate. Rounds down, so that negative cells of a SparseGrid
+// end up in the chunk to the left or above.
+int ChunkOf(const int cell) {
+    return cell >= 0 ? cell / Grid::CHUNK_SIZE : (cell + 1) / Grid::CHUNK_SIZE - 1;
 }
 } // namespace
 
-SnapsEngine::SnapsEngine(Grid& grid) : m_Grid(grid) {}
+template <typename GridType>
+BasicSnapsEngine<GridType>::BasicSnapsEngine(GridType& grid) : m_Grid(grid), m_Candidates(1), m_SegmentSlots(1), m_Chains(1) {}
 
-void SnapsEngine::Step(float deltaTime) {
-    m_DeltaTime = deltaTime;
+template <typename GridType>
+BasicSnapsEngine<GridType>::~BasicSnapsEngine() = default;
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::Step(float deltaTime) {
+    PrepareSteps(deltaTime);
     SimulatePhysics();
 }
 
-void SnapsEngine::SimulatePhysics() {
-    const std::size_t numOfTiles = m_Grid.Data().size();
-    for (std::size_t i = 0; i < numOfTiles; i++) {
-        auto& block = m_Grid.At(i);
-        const auto [x, y] = m_Grid.GetXY(i);
-        if (block.has_value())
-            SimulateMovement(x, y, *block);
+template <typename GridType>
+typename BasicSnapsEngine<GridType>::StepResult BasicSnapsEngine<GridType>::StepN(const int steps, const float deltaTime) {
+    return RunSteps(steps, deltaTime, false);
+}
+
+template <typename GridType>
+typename BasicSnapsEngine<GridType>::StepResult BasicSnapsEngine<GridType>::StepUntilSettled(const int maxSteps, const float deltaTime) {
+    return RunSteps(maxSteps, deltaTime, true);
+}
+
+template <typename GridType>
+typename BasicSnapsEngine<GridType>::StepResult BasicSnapsEngine<GridType>::RunSteps(const int maxSteps, const float deltaTime, const bool stopAtRest) {
+    PrepareSteps(deltaTime);
+    const bool logEvents = std::exchange(m_LogEvents, false);
+
+    StepResult result;
+    while (result.Steps < maxSteps and not (stopAtRest and IsAtRest())) {
+        SimulatePhysics();
+        result.Steps++;
     }
 
-    for (int y = m_Grid.Height() - 1; y >= 0; y--) {
-        for (int x = 0; x < m_Grid.Width(); x++) {
-            SolveGridPhysics(x, y, CollisionPass::First);
+    m_LogEvents = logEvents;
+    result.IsAtRest = IsAtRest();
+    return result;
+}
+
+template <typename GridType>
+bool BasicSnapsEngine<GridType>::IsAtRest() const {
+    return not m_Grid.HasDirtyRects();
+}
+
+// Setup that doesn't change between steps with the same delta time and configuration.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::PrepareSteps(const float deltaTime) {
+    m_DeltaTime = deltaTime;
+    if (IsParallel()) {
+        int threadCount = m_Config.ThreadCount > 0
+            ? m_Config.ThreadCount
+            : static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+        // A claim has room for the index of a limited number of workers.
+        if (IsClaimingCells()) threadCount = std::min(threadCount, CellClaims::MAX_WORKERS);
+        if (not m_WorkerPool or m_WorkerPool->ThreadCount() != threadCount) {
+            m_WorkerPool = std::make_unique<WorkerPool>(threadCount);
+            m_Candidates.resize(threadCount);
+            for (int worker = 0; worker < threadCount; worker++) {
+                m_Candidates[worker].Worker = worker;
+            }
+            m_SegmentSlots.resize(threadCount);
+            m_Chains.resize(threadCount);
+        }
+    }
+    ReserveScratchBuffers();
+}
+
+// Buffers that are rebuilt in every step get their worst-case capacity up front, so steps don't allocate.
+// A block is postponed to each candidate stack once at most. The second pass is emptied after every row
+// and the third one after every chunk when chunks are solved one by one. The serial sweep keeps the third
+// pass for the whole step, so its stack takes 8 bytes per block of the pool. Intent rounds take a chain
+// of 4 bytes per block of the pool for each worker, as a chain may run through every moving block.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ReserveScratchBuffers() {
+    const std::size_t chunkCount = m_Grid.ChunkCount();
+    const std::size_t maxSegments = chunkCount * GridType::CHUNK_SIZE; // One per row of every chunk
+    const std::size_t poolSize = m_Grid.Blocks().Size();
+    for (auto& slots : m_SegmentSlots) {
+        slots.reserve(GridType::CHUNK_SIZE); // Segments never cross chunk borders
+    }
+    if (m_Config.TwoPhaseResolution) {
+        if (m_Intents.size() < poolSize) m_Intents.resize(poolSize);
+        m_Movers.reserve(poolSize);
+        for (auto& chain : m_Chains) {
+            chain.reserve(poolSize);
+        }
+    } else {
+        const bool solvesChunks = IsParallel() or m_Config.Deterministic;
+        std::size_t maxSecondPass = solvesChunks ? GridType::CHUNK_SIZE : poolSize;
+        if constexpr (std::same_as<GridType, Grid>) {
+            if (not solvesChunks) maxSecondPass = std::min(maxSecondPass, static_cast<std::size_t>(m_Grid.Width()));
+        }
+        const std::size_t maxThirdPass = solvesChunks ? GridType::CHUNK_SIZE * GridType::CHUNK_SIZE : poolSize;
+        for (CollisionPassCandidates& candidates : m_Candidates) {
+            candidates.SecondPass.reserve(maxSecondPass);
+            candidates.ThirdPass.reserve(maxThirdPass);
         }
-        SecondPassGridPhysicsHorizontal();
     }
-    ThirdPassGridPhysicsVertical();
+    if (m_DirtySegments.capacity() >= maxSegments) return;
+
+    m_DirtyRects.reserve(chunkCount);
+    m_PhaseChunks.reserve(chunkCount);
+    m_DirtySegments.reserve(maxSegments);
+    m_ColumnSegments.reserve(maxSegments);
+    m_ColumnStarts.reserve(chunkCount + 1);
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::LogEvent(const char* message) const {
+    if (m_LogEvents) std::cout << message << std::endl;
 }
 
-void SnapsEngine::SimulateMovement(const int x, const int y, Block& block) {
-    if (block.IsDynamic) {
-        ApplyGravity(block);
+template <typename GridType>
+int BasicSnapsEngine<GridType>::Advance(const float realDeltaTime) {
+    const float timeStep = m_Config.FixedTimeStep;
+    assert(timeStep > 0.0f);
+    m_TimeAccumulator += std::max(realDeltaTime, 0.0f);
+
+    int steps = 0;
+    while (m_TimeAccumulator >= timeStep and steps < std::max(m_Config.MaxSubsteps, 1)) {
+        Step(timeStep);
+        m_TimeAccumulator -= timeStep;
+        steps++;
+    }
+
+    // Too far behind. Catching up would take even longer, so drop whole steps that didn't fit.
+    if (m_TimeAccumulator >= timeStep) {
+        m_TimeAccumulator = std::fmod(m_TimeAccumulator, timeStep);
+    }
+    return steps;
+}
+
+template <typename GridType>
+float BasicSnapsEngine<GridType>::GetInterpolationAlpha() const {
+    return m_TimeAccumulator / m_Config.FixedTimeStep;
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SaveSnapshot(const std::uint64_t frame) requires std::same_as<GridType, Grid> {
+    const auto count = static_cast<std::size_t>(std::max(m_Config.SnapshotCount, 1));
+    if (m_Snapshots.size() != count) {
+        m_Snapshots.clear();
+        m_Snapshots.resize(count);
+    }
+    Snapshot& snapshot = m_Snapshots[frame % count];
+    snapshot.Frame = frame;
+    snapshot.GridState.Save(m_Grid);
+    snapshot.EngineConfig = m_Config;
+    snapshot.DeltaTime = m_DeltaTime;
+    snapshot.TimeAccumulator = m_TimeAccumulator;
+}
+
+template <typename GridType>
+bool BasicSnapsEngine<GridType>::RestoreSnapshot(const std::uint64_t frame) requires std::same_as<GridType, Grid> {
+    if (m_Snapshots.empty()) return false;
+    const Snapshot& snapshot = m_Snapshots[frame % m_Snapshots.size()];
+    if (snapshot.Frame != frame) return false;
+
+    snapshot.GridState.Restore(m_Grid);
+    m_Config = snapshot.EngineConfig;
+    m_DeltaTime = snapshot.DeltaTime;
+    m_TimeAccumulator = snapshot.TimeAccumulator;
+    // Left over from an interrupted step at most, they must not leak into the restored one.
+    for (CollisionPassCandidates& candidates : m_Candidates) {
+        candidates.SecondPass.clear();
+        candidates.ThirdPass.clear();
+    }
+    for (Snapshot& later : m_Snapshots) {
+        if (later.Frame > frame) later.Frame.reset();
+    }
+    return true;
+}
+
+template <typename GridType>
+std::uint64_t BasicSnapsEngine<GridType>::GetStateHash() requires std::same_as<GridType, Grid> {
+    return m_StateHash.Compute(m_Grid);
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SimulatePhysics() {
+    // Only dirty rectangles from the previous step are visited. Every active block lies inside one
+    // of them, so the cost of a step depends on the amount of activity rather than on the size of the grid.
+    CollectDirtySegments();
+    if (m_Config.FixedPoint) UpdateFixedMaterials();
+
+    if (m_Config.TwoPhaseResolution) {
+        if (IsParallel()) ApplyForcesAndIntegrateInParallel();
+        else ApplyForcesAndIntegrate();
+        ResolveIntents();
+    } else if (IsClaimingCells()) {
+        ApplyForcesAndIntegrateInParallel();
+        SolveDirtyChunksConcurrently();
+    } else if (IsParallel()) {
+        ApplyForcesAndIntegrateInParallel();
+        SolveDirtyChunksInPhases();
+    } else if (m_Config.Deterministic) {
+        ApplyForcesAndIntegrate();
+        SolveDirtyChunksInPhases();
+    } else {
+        ApplyForcesAndIntegrate();
+        SolveDirtySegments();
+        ThirdPassGridPhysicsVertical(m_Candidates.front());
+    }
+    UpdateActiveBlocks();
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::CollectDirtySegments() {
+    m_Grid.TakeDirtyRects(m_DirtyRects);
+    m_DirtySegments.clear();
+
+    // Rectangles are ordered by chunk, so the ones from the same row of chunks are next to each other.
+    for (auto chunkRow = m_DirtyRects.begin(); chunkRow != m_DirtyRects.end();) {
+        const int chunkY = ChunkOf(chunkRow->MinY);
+        const auto chunkRowEnd = std::find_if(chunkRow, m_DirtyRects.end(), [chunkY](const DirtyRect& rect) {
+            return ChunkOf(rect.MinY) != chunkY;
+        });
+
+        for (int y = chunkY * GridType::CHUNK_SIZE; y < chunkY * GridType::CHUNK_SIZE + GridType::CHUNK_SIZE; y++) {
+            for (auto rect = chunkRow; rect != chunkRowEnd; ++rect) {
+                if (y < rect->MinY or y > rect->MaxY) continue;
+                m_DirtySegments.push_back({y, rect->MinX, rect->MaxX + 1});
+            }
+        }
+        chunkRow = chunkRowEnd;
+    }
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ApplyForcesAndIntegrate() {
+    for (const RowSegment& segment : m_DirtySegments) {
+        ApplyForcesAndIntegrate(segment, m_SegmentSlots.front());
+    }
+}
+
+// Forces of a block depend only on the blocks above and below it, so columns of chunks are independent
+// as long as each of them is processed from top to bottom. The result is the same as in the serial step.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ApplyForcesAndIntegrateInParallel() {
+    // Only columns between the leftmost and the rightmost dirty chunk have any segments.
+    int firstColumn = INT_MAX;
+    int lastColumn = INT_MIN;
+    for (const DirtyRect& rect : m_DirtyRects) {
+        firstColumn = std::min(firstColumn, ChunkOf(rect.MinX));
+        lastColumn = std::max(lastColumn, ChunkOf(rect.MinX));
+    }
+    const int chunkColumns = m_DirtyRects.empty() ? 0 : lastColumn - firstColumn + 1;
+    const auto chunkColumnOf = [firstColumn](const RowSegment& segment) {
+        return ChunkOf(segment.MinX) - firstColumn;
+    };
+
+    m_ColumnStarts.assign(chunkColumns + 1, 0);
+    for (const RowSegment& segment : m_DirtySegments) {
+        m_ColumnStarts[chunkColumnOf(segment) + 1]++;
+    }
+    for (int column = 0; column < chunkColumns; column++) {
+        m_ColumnStarts[column + 1] += m_ColumnStarts[column];
+    }
+    // Counting sort keeps the top-to-bottom order of segments within a column. Starts are used as
+    // insertion cursors, which shifts them by one column, so they are shifted back afterwards.
+    m_ColumnSegments.resize(m_DirtySegments.size());
+    for (std::size_t i = 0; i < m_DirtySegments.size(); i++) {
+        m_ColumnSegments[m_ColumnStarts[chunkColumnOf(m_DirtySegments[i])]++] = i;
+    }
+    std::shift_right(m_ColumnStarts.begin(), m_ColumnStarts.end(), 1);
+    m_ColumnStarts.front() = 0;
+
+    m_WorkerPool->Run(chunkColumns, [this](const std::size_t column, const int worker) {
+        for (std::size_t i = m_ColumnStarts[column]; i < m_ColumnStarts[column + 1]; i++) {
+            ApplyForcesAndIntegrate(m_DirtySegments[m_ColumnSegments[i]], m_SegmentSlots[worker]);
+        }
+    });
+}
+
+// Blocks of a row don't depend on each other, so each step of the phase is done for the whole segment
+// before moving on to the next one. Pure-math steps run as vectorized kernels over slots of the active blocks.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ApplyForcesAndIntegrate(const RowSegment& segment, std::vector<std::uint32_t>& slots) {
+    if (m_Config.FixedPoint) {
+        ApplyForcesAndIntegrateFixed(segment);
+        return;
+    }
+    const auto& [y, minX, endX] = segment;
+    BlockStorage& blocks = m_Grid.Blocks();
+    slots.clear();
+    for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+        slots.push_back(m_Grid.GetSlot(m_Grid.GetIndex(x, y)));
+    }
+    const auto forEachActiveBlock = [&](auto&& function) {
+        for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+            BlockRef block = m_Grid.Ref(x, y);
+            function(x, block);
+        }
+    };
+
+    kernels::ApplyGravity(blocks, slots, m_Config.Gravity);
+    forEachActiveBlock([&](const int x, BlockRef& block) { ApplyFriction(x, y, block); });
+    if (m_Config.Drag > 0.0f) {
+        const int stopped = kernels::ApplyDrag(blocks, slots, m_Config.Drag, m_DeltaTime);
+        for (int i = 0; i < stopped; i++) LogEvent("drag stopped the object");
+    }
+    forEachActiveBlock([&](const int x, BlockRef& block) { DiscardResistanceForcesIfNecessary(x, y, block); });
+    kernels::Integrate(blocks, slots, m_DeltaTime);
+}
+
+template <typename GridType>
+void BasicSnapsEngine<GridType>::UpdateFixedMaterials() {
+    const MaterialTable& materials = m_Grid.Materials();
+    const Fixed gravity(m_Config.Gravity);
+    m_FixedMaterials.resize(materials.Size());
+    for (std::size_t id = 0; id < materials.Size(); id++) {
+        const Material& material = materials[static_cast<MaterialId>(id)];
+        const Fixed invMass(material.InvMass);
+        if (invMass <= Fixed()) {
+            m_FixedMaterials[id] = {};
+            continue;
+        }
+        m_FixedMaterials[id] = {
+            .InvMass = invMass,
+            .Mass = Fixed(1) / invMass,
+            .GravityForce = gravity * Fixed(material.GravityScale) / invMass
+        };
+    }
+}
+
+// The same phase with Config::FixedPoint, block by block. Each step matches its kernel above.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ApplyForcesAndIntegrateFixed(const RowSegment& segment) {
+    const auto& [y, minX, endX] = segment;
+    BlockStorage& blocks = m_Grid.Blocks();
+    const Fixed deltaTime(m_DeltaTime);
+    const Fixed drag(m_Config.Drag);
+    const Fixed minVelocity(0.01f);
+    const Fixed minDragVelocity = Fixed(1) / deltaTime;
+    const Fixed maxDistance(MAX_CELLS_PER_STEP * BLOCK_SIZE);
+    const Fixed maxSpeed = maxDistance / deltaTime;
+    for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+        const std::size_t index = m_Grid.GetIndex(x, y);
+        const std::uint32_t slot = m_Grid.GetSlot(index);
+        const FixedMaterial& material = m_FixedMaterials[blocks.Material[slot]];
+        const Fixed invMass = material.InvMass;
+        blocks.UpdateFixedState(slot);
+        if (invMass <= Fixed()) continue;
+
+        FixedBlockRef block = FixedRef(index);
+        FixedVector2& force = block.ForceAccum;
+        FixedVector2& velocity = block.Velocity;
+        FixedVector2& position = block.WorldPosition;
+        const FixedVector2 previousPosition = position;
+
+        force = FixedVector2(blocks.ForceAccum[slot]);
+        force.y += material.GravityForce;
         ApplyFriction(x, y, block);
-        ApplyDrag(block);
+
+        // If the block is almost stationary, skip to avoid tiny forces.
+        const FixedVector2 speed {Abs(velocity.x), Abs(velocity.y)};
+        if (m_Config.Drag > 0.0f and not (speed.x < minVelocity and speed.y <= minVelocity)) {
+            // Drag must not reverse the horizontal velocity.
+            const Fixed finalVelocityX = velocity.x + force.x * invMass * deltaTime;
+            const Fixed maxForceX = material.Mass * finalVelocityX / deltaTime;
+            FixedVector2 dragForce {velocity.x * drag, velocity.y * drag};
+            if (Abs(dragForce.x) > Abs(maxForceX)) {
+                dragForce.x = maxForceX;
+                LogEvent("drag stopped the object");
+            }
+
+            // Don't apply drag for slow objects to reduce snapping.
+            if (speed.x < minDragVelocity) dragForce.x = {};
+            if (speed.y < minDragVelocity) dragForce.y = {};
+            force.x -= dragForce.x;
+            force.y -= dragForce.y;
+        }
         DiscardResistanceForcesIfNecessary(x, y, block);
-        Integrate(block);
+
+        const FixedVector2 acceleration {force.x * invMass, force.y * invMass};
+        velocity.x += acceleration.x * deltaTime;
+        velocity.y += acceleration.y * deltaTime;
+        if (Abs(velocity.x) < minVelocity) velocity.x = {};
+        if (Abs(velocity.y) < minVelocity) velocity.y = {};
+        velocity.x = std::clamp(velocity.x, -maxSpeed, maxSpeed);
+        velocity.y = std::clamp(velocity.y, -maxSpeed, maxSpeed);
+        position.x += std::clamp(velocity.x * deltaTime, -maxDistance, maxDistance);
+        position.y += std::clamp(velocity.y * deltaTime, -maxDistance, maxDistance);
+
+        blocks.UpdateFloats(slot);
+        blocks.Acceleration[slot] = acceleration.ToVector2();
+        blocks.PreviousPosition[slot] = previousPosition.ToVector2();
+        blocks.ForceAccum[slot] = {0.0f, 0.0f};
+        blocks.Flags[slot].NeedsCollisionResolution = true;
+    }
+}
+
+// Resolves collisions row by row, from the bottom to the top and from left to right in each row.
+// A block that claims a cell to the right or above is visited again when the sweep reaches that cell.
+// The dirty rectangles have a margin of one cell, so such cell is always inside one of them. Blocks that
+// reach further are moved all the way at once, see SweepMovement().
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SolveDirtySegments() {
+    for (std::size_t rowEnd = m_DirtySegments.size(); rowEnd > 0;) {
+        const int y = m_DirtySegments[rowEnd - 1].Y;
+        std::size_t rowBegin = rowEnd;
+        while (rowBegin > 0 and m_DirtySegments[rowBegin - 1].Y == y) rowBegin--;
+
+        for (std::size_t segment = rowBegin; segment < rowEnd; segment++) {
+            const auto [_, minX, endX] = m_DirtySegments[segment];
+            for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+                SolveGridPhysics(x, y, CollisionPass::First, m_Candidates.front());
+            }
+        }
+        SecondPassGridPhysicsHorizontal(m_Candidates.front());
+        rowEnd = rowBegin;
     }
 }
 
-void SnapsEngine::Integrate(Block& block) {
-    if (block.InvMass <= 0.0f) return;
+// Chunks are updated in four phases, like fields of a checkerboard with 2x2 colors. Blocks claim cells at most
+// MAX_CELLS_PER_STEP away and look one cell further, so chunks of the same phase never touch the same cell.
+// Without the parallel step the chunks of a phase are solved one by one, with the same result.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SolveDirtyChunksInPhases() {
+    static_assert(2 * (MAX_CELLS_PER_STEP + 1) <= GridType::CHUNK_SIZE, "Chunks of the same phase would reach the same cell");
+    for (int phase = 0; phase < 4; phase++) {
+        m_PhaseChunks.clear();
+        for (const DirtyRect& rect : m_DirtyRects) {
+            const int chunkX = ChunkOf(rect.MinX);
+            const int chunkY = ChunkOf(rect.MinY);
+            if ((chunkX & 1) == phase % 2 and (chunkY & 1) == phase / 2) m_PhaseChunks.push_back(&rect);
+        }
+        if (not IsParallel()) {
+            for (const DirtyRect* rect : m_PhaseChunks) {
+                SolveDirtyChunk(*rect, m_Candidates.front());
+            }
+            continue;
+        }
+        m_WorkerPool->Run(m_PhaseChunks.size(), [this](const std::size_t chunk, const int worker) {
+            SolveDirtyChunk(*m_PhaseChunks[chunk], m_Candidates[worker]);
+        });
+    }
+}
 
-    block.Acceleration = {
-        block.ForceAccum.x * block.InvMass,
-        block.ForceAccum.y * block.InvMass
-    };
+// The same bottom-up sweep as SolveDirtySegments() but limited to a single chunk.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SolveDirtyChunk(const DirtyRect& rect, CollisionPassCandidates& candidates) {
+    for (int y = rect.MaxY; y >= rect.MinY; y--) {
+        const int endX = rect.MaxX + 1;
+        for (int x = m_Grid.FindNextActiveInRow(rect.MinX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+            SolveGridPhysics(x, y, CollisionPass::First, candidates);
+        }
+        SecondPassGridPhysicsHorizontal(candidates);
+    }
+    ThirdPassGridPhysicsVertical(candidates);
+}
+
+// Every dirty chunk is a task of its own. Workers claim cells as they go, see ClaimCell().
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SolveDirtyChunksConcurrently() {
+    if constexpr (GridType::SUPPORTS_PARALLEL_STEP) {
+        assert(m_WorkerPool->ThreadCount() <= CellClaims::MAX_WORKERS);
+        if (not m_CellClaims) m_CellClaims = std::make_unique<CellClaims>();
+        m_CellClaims->BeginStep(m_Grid.Size());
+        m_ClaimingCells = true;
+        m_WorkerPool->Run(m_DirtyRects.size(), [this](const std::size_t chunk, const int worker) {
+            SolveDirtyChunk(m_DirtyRects[chunk], m_Candidates[worker]);
+        });
+        m_ClaimingCells = false;
+    }
+}
+
+// A worker resolves a block only if it has claimed its cell, and moves it only to a cell it has claimed.
+// Claims last until the end of the step, so a cell never changes hands and a claimed cell can be entered
+// again by blocks of the same worker, e.g. by a falling column.
+template <typename GridType>
+bool BasicSnapsEngine<GridType>::ClaimCell(const std::size_t index, const CollisionPassCandidates& candidates) {
+    return not m_ClaimingCells or m_CellClaims->Claim(index, candidates.Worker);
+}
 
-    block.Velocity += block.Acceleration * m_DeltaTime;
+// Puts blocks that have been resting for a while to sleep. The ones that stay active are marked
+// dirty, so they are simulated in the next step.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::UpdateActiveBlocks() {
+    BlockStorage& blocks = m_Grid.Blocks();
+    const bool sleepingEnabled = m_Config.SleepAfterSteps > 0;
+    const float maxVelocity = m_Config.SleepVelocityThreshold;
+    const float maxAcceleration = m_Config.SleepAccelerationThreshold;
+    for (const auto& [y, minX, endX] : m_DirtySegments) {
+        for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+            const std::size_t i = m_Grid.GetIndex(x, y);
+            const std::uint32_t slot = m_Grid.GetSlot(i);
+            bool isResting = sleepingEnabled;
+            if (isResting and m_Config.FixedPoint) {
+                const FixedVector2 velocity = blocks.FixedVelocityOf(slot);
+                isResting = Abs(velocity.x) <= Fixed(maxVelocity)
+                    and Abs(velocity.y) <= Fixed(maxVelocity)
+                    and Abs(Fixed(blocks.Acceleration[slot].x)) <= Fixed(maxAcceleration)
+                    and blocks.FixedPositionOf(slot) == FixedVector2(CellStart<Fixed>(x), CellStart<Fixed>(y));
+            } else if (isResting) {
+                isResting = std::abs(blocks.Velocity[slot].x) <= maxVelocity
+                    and std::abs(blocks.Velocity[slot].y) <= maxVelocity
+                    and std::abs(blocks.Acceleration[slot].x) <= maxAcceleration
+                    and blocks.WorldPosition[slot].x == static_cast<float>(x * BLOCK_SIZE)
+                    and blocks.WorldPosition[slot].y == static_cast<float>(y * BLOCK_SIZE);
+            }
 
-    // Realistically, any velocity smaller than 1.0/DeltaTime will not move the object in a pixel space.
-    if (std::abs(block.Velocity.x) < 0.01f) block.Velocity.x = 0.0f;
-    if (std::abs(block.Velocity.y) < 0.01f) block.Velocity.y = 0.0f;
+            if (not isResting) {
+                blocks.RestSteps[slot] = 0;
+            } else if (++blocks.RestSteps[slot] >= m_Config.SleepAfterSteps) {
+                blocks.Velocity[slot] = {0.0f, 0.0f};
+                blocks.Flags[slot].NeedsCollisionResolution = false;
+                blocks.PreviousPosition[slot] = blocks.WorldPosition[slot];
+                m_Grid.Sleep(i);
+                continue;
+            }
+            m_Grid.MarkDirty(x, y);
+        }
+    }
+}
 
-    block.WorldPosition += ClampToBlockSize(block.Velocity * m_DeltaTime);
-    block.ForceAccum = {0, 0};
+// BlockRef of Config::FixedPoint. Position and velocity refer to the fixed-point arrays of the block.
+// Acceleration is converted from the float, only the solver reads it. Force is filled in by the integration.
+template <typename GridType>
+struct BasicSnapsEngine<GridType>::FixedBlockRef {
+    FixedVector2& WorldPosition;
+    FixedVector2& Velocity;
+    FixedVector2 ForceAccum;
+    FixedVector2 Acceleration;
+    bool& NeedsCollisionResolution;
+    const Material& BlockMaterial;
+
+    const Material& GetMaterial() const { return BlockMaterial; }
+};
+
+template <typename GridType>
+typename BasicSnapsEngine<GridType>::FixedBlockRef BasicSnapsEngine<GridType>::FixedRef(const std::size_t index) {
+    BlockStorage& blocks = m_Grid.Blocks();
+    const std::uint32_t slot = m_Grid.GetSlot(index);
+    return FixedBlockRef {
+        .WorldPosition = blocks.FixedPosition[slot],
+        .Velocity = blocks.FixedVelocity[slot],
+        .ForceAccum = {},
+        .Acceleration = FixedVector2(blocks.Acceleration[slot]),
+        .NeedsCollisionResolution = blocks.Flags[slot].NeedsCollisionResolution,
+        .BlockMaterial = blocks.Materials[blocks.Material[slot]]
+    };
+}
 
-    block.NeedsCollisionResolution = true;
+// Neighbours are only read, their floats may be newer than the fixed-point state, see BlockStorage::FixedPosition.
+template <typename GridType>
+template <typename Vector>
+Vector BasicSnapsEngine<GridType>::GetWorldPosition(const std::size_t index) const {
+    if constexpr (std::same_as<Vector, Vector2>) {
+        if constexpr (GridType::SUPPORTS_PARALLEL_STEP) {
+            if (m_ClaimingCells) return m_Grid.LoadWorldPosition(index);
+        }
+        return m_Grid.GetWorldPosition(index);
+    } else if (m_Grid.IsTerrain(index)) {
+        const auto [x, y] = m_Grid.GetXY(index);
+        return {CellStart<Fixed>(x), CellStart<Fixed>(y)};
+    } else {
+        return m_Grid.Blocks().FixedPositionOf(m_Grid.GetSlot(index));
+    }
 }
 
-void SnapsEngine::SolveGridPhysics(int x, int y, const CollisionPass collisionPass) {
-    auto& block = m_Grid.At(x, y);
-    if (not block.has_value() or not block->IsDynamic or not block->NeedsCollisionResolution) return;
-    SolveGridPhysics(x, y, *block, collisionPass);
+template <typename GridType>
+template <typename Vector>
+Vector BasicSnapsEngine<GridType>::GetVelocity(const std::size_t index) const {
+    if constexpr (std::same_as<Vector, Vector2>) {
+        if constexpr (GridType::SUPPORTS_PARALLEL_STEP) {
+            if (m_ClaimingCells) return m_Grid.LoadVelocity(index);
+        }
+        return m_Grid.GetVelocity(index);
+    } else {
+        return m_Grid.IsTerrain(index) ? FixedVector2() : m_Grid.Blocks().FixedVelocityOf(m_Grid.GetSlot(index));
+    }
 }
 
-void SnapsEngine::SolveGridPhysics(const int gridX, const int gridY, Block& block, const CollisionPass collisionPass) {
+template <typename GridType>
+typename BasicSnapsEngine<GridType>::MovementResolution BasicSnapsEngine<GridType>::SolveGridPhysics(int x, int y, const CollisionPass collisionPass, CollisionPassCandidates& candidates) {
+    const std::size_t index = m_Grid.GetIndex(x, y);
+    if (not m_Grid.IsDynamic(index)) return {x, y, collisionPass};
+    if (m_Config.FixedPoint) {
+        BlockStorage& blocks = m_Grid.Blocks();
+        if (not blocks.Flags[m_Grid.GetSlot(index)].NeedsCollisionResolution) return {x, y, collisionPass};
+        blocks.UpdateFixedState(m_Grid.GetSlot(index));
+        FixedBlockRef block = FixedRef(index);
+        const MovementResolution resolution = SolveGridPhysics(x, y, block, collisionPass, candidates);
+        blocks.UpdateFloats(m_Grid.GetSlot(m_Grid.GetIndex(resolution.X, resolution.Y)));
+        return resolution;
+    }
+    if (m_ClaimingCells) {
+        if (not ClaimCell(index, candidates)) return {x, y, collisionPass};
+        // Other workers may read the block as a neighbour. It's resolved in a copy, so they never see a half
+        // resolved block, and its motion is stored atomically at the end.
+        BlockStorage& blocks = m_Grid.Blocks();
+        const std::uint32_t slot = m_Grid.GetSlot(index);
+        if (not blocks.Flags[slot].NeedsCollisionResolution) return {x, y, collisionPass};
+        Block copy = {
+            .WorldPosition = blocks.WorldPosition[slot],
+            .Velocity = blocks.Velocity[slot],
+            .Material = blocks.Material[slot],
+            .IsDynamic = true,
+            .Acceleration = blocks.Acceleration[slot],
+            .NeedsCollisionResolution = true
+        };
+        BlockRef block {
+            copy.WorldPosition, copy.Velocity, copy.Material, copy.IsDynamic, copy.ForceAccum,
+            copy.Acceleration, copy.NeedsCollisionResolution, copy.IsSleeping, blocks.Materials
+        };
+        const MovementResolution resolution = SolveGridPhysics(x, y, block, collisionPass, candidates);
+        StoreVector(blocks.WorldPosition[slot], copy.WorldPosition);
+        StoreVector(blocks.Velocity[slot], copy.Velocity);
+        blocks.Flags[slot].NeedsCollisionResolution = copy.NeedsCollisionResolution;
+        return resolution;
+    }
+    BlockRef block = m_Grid.Ref(index);
+    if (not block.NeedsCollisionResolution) return {x, y, collisionPass};
+    return SolveGridPhysics(x, y, block, collisionPass, candidates);
+}
+
+template <typename GridType>
+template <typename Body>
+typename BasicSnapsEngine<GridType>::MovementResolution BasicSnapsEngine<GridType>::SolveGridPhysics(const int gridX, const int gridY, Body& block, const CollisionPass collisionPass, CollisionPassCandidates& candidates) {
     MovementResolution resolution {gridX, gridY, collisionPass};
 
+    // A fast block has reached further than the next cell, it's moved through the cells on its way first.
+    if ((collisionPass != CollisionPass::Third and CellsAhead(block.WorldPosition.x, block.Velocity.x, gridX) > 1)
+        or CellsAhead(block.WorldPosition.y, block.Velocity.y, gridY) > 1) {
+        SweepMovement(block, resolution, candidates);
+        if (resolution.Resolved) return resolution;
+    }
+
     if (collisionPass != CollisionPass::Third) {
-        SolveMovementHorizontal(block, resolution);
-        if (resolution.Resolved) return;
+        SolveMovementHorizontal(block, resolution, candidates);
+        if (resolution.Resolved) return resolution;
     }
 
-    assert(m_Grid.At(resolution.X, resolution.Y).has_value());
-    auto& movedBlock = *m_Grid.At(resolution.X, resolution.Y);
+    // The view follows the block, so it's still valid if the block has claimed a cell horizontally.
+    const int movedY = resolution.Y;
 
-    SolveMovementVertical(movedBlock, resolution);
-    if (resolution.Resolved) return;
+    SolveMovementVertical(block, resolution, candidates);
+    if (resolution.Resolved) return resolution;
 
-    // Mark as resolved so we don't try to resolve it again this frame.
-    movedBlock.NeedsCollisionResolution = false;
+    // Mark as resolved so we don't try to resolve it again this frame. A block that has claimed a cell
+    // vertically stays unresolved, so it's resolved again if the sweep reaches its new cell.
+    if (resolution.Y == movedY) block.NeedsCollisionResolution = false;
+    return resolution;
 }
 
+// Moves the block cell by cell along its path, like a grid DDA. Borders of cells are crossed in the order the
+// block reached them and each crossing is resolved by the movement to the next cell below, with the block put
+// back where it was along the other axis at that time. So the block stops at the first occupied cell on its way
+// and the centre checks see the cells it actually passed. The third pass moves blocks only vertically.
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SweepMovement(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
+    const bool horizontal = resolution.Pass != CollisionPass::Third;
+    const Real deltaTime(m_DeltaTime);
+    Vector target = block.WorldPosition;
+    while (not resolution.Resolved) {
+        const Vector velocity = block.Velocity;
+        const bool crossesX = horizontal and CellsAhead(target.x, velocity.x, resolution.X) > 0;
+        const bool crossesY = CellsAhead(target.y, velocity.y, resolution.Y) > 0;
+        if (not crossesX and not crossesY) return;
+
+        const Real timeX = crossesX ? TimeSinceCrossing(target.x, velocity.x, resolution.X) : Real();
+        const Real timeY = crossesY ? TimeSinceCrossing(target.y, velocity.y, resolution.Y) : Real();
+        // The earlier crossing is the one that happened longer ago. Ties go horizontally first, like in SolveGridPhysics().
+        if (crossesX and (not crossesY or timeX >= timeY)) {
+            const int x = resolution.X;
+            block.WorldPosition.y = PositionBefore(target.y, velocity.y, std::min(timeX, deltaTime), resolution.Y);
+            SolveMovementHorizontal(block, resolution, candidates);
+            block.WorldPosition.y = target.y;
+            if (resolution.X == x) target.x = block.WorldPosition.x; // Stopped, or postponed to the second pass
+        } else if (not crossesX and velocity.x == Real() and velocity.y > Real() and not m_ClaimingCells
+                   and CellOf(target.x + static_cast<Real>(BLOCK_SIZE / 2)) == resolution.X) {
+            // Falling straight down, the centre checks would only look at the cells below.
+            FallStraight(block, resolution, CellsAhead(target.y, velocity.y, resolution.Y));
+            return;
+        } else {
+            const int y = resolution.Y;
+            // The third pass doesn't move horizontally, so the block is stopped instead of postponed to it while
+            // horizontal crossings remain.
+            const CollisionPass pass = std::exchange(resolution.Pass, crossesX ? CollisionPass::Third : resolution.Pass);
+            block.WorldPosition.x = PositionBefore(target.x, velocity.x, std::min(timeY, deltaTime), resolution.X);
+            SolveMovementVertical(block, resolution, candidates);
+            block.WorldPosition.x = target.x;
+            resolution.Pass = pass;
+            if (resolution.Y == y) target.y = block.WorldPosition.y;
+        }
+    }
+}
+
+// SweepMovement() of a block falling straight down `cells` cells. Each cell would stop the block if the one below it
+// was occupied, so the first occupied cell below is found once in the column and the block moves right above it in
+// one go. The cells on its path are marked dirty and the blocks beside it woken up like the moves through every cell
+// would have done. Cells aren't claimed one by one on the way, so workers claiming cells sweep cell by cell instead.
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::FallStraight(Body& block, MovementResolution& resolution, const int cells) {
+    const int x = resolution.X;
+    const int y = resolution.Y;
+    const int surface = m_Grid.FindSurfaceBelow(x, y, y + cells);
+    const int landing = surface - 1;
+    if (landing > y) {
+        const std::size_t to = m_Grid.GetIndex(x, landing);
+        m_Grid.Move(m_Grid.GetIndex(x, y), to);
+        m_Grid.Wake(to);
+        for (int pathY = y + 1; pathY < landing; pathY++) {
+            m_Grid.MarkDirty(x, pathY);
+            if (m_Grid.InBounds(x - 1, pathY)) m_Grid.Wake(m_Grid.GetIndex(x - 1, pathY));
+            if (m_Grid.InBounds(x + 1, pathY)) m_Grid.Wake(m_Grid.GetIndex(x + 1, pathY));
+        }
+        resolution.Y = landing;
+    }
+    if (surface <= y + cells) {
+        StopBlockAndAlignToY(block, landing);
+    }
+}
 
-void SnapsEngine::SecondPassGridPhysicsHorizontal() {
-    while (not m_SecondPassCandidates.empty()) {
-        auto [x, y] = m_SecondPassCandidates.top();
-        SolveGridPhysics(x, y, CollisionPass::Secondary);
-        m_SecondPassCandidates.pop();
+template <typename GridType>
+void BasicSnapsEngine<GridType>::SecondPassGridPhysicsHorizontal(CollisionPassCandidates& candidates) {
+    while (not candidates.SecondPass.empty()) {
+        auto [x, y] = candidates.SecondPass.back();
+        SolveGridPhysics(x, y, CollisionPass::Secondary, candidates);
+        candidates.SecondPass.pop_back();
     }
 }
 
-void SnapsEngine::ThirdPassGridPhysicsVertical() {
-    while (not m_ThirdPassCandidates.empty()) {
-        auto [x, y] = m_ThirdPassCandidates.top();
-        SolveGridPhysics(x, y, CollisionPass::Third);
-        m_ThirdPassCandidates.pop();
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ThirdPassGridPhysicsVertical(CollisionPassCandidates& candidates) {
+    while (not candidates.ThirdPass.empty()) {
+        auto [x, y] = candidates.ThirdPass.back();
+        SolveGridPhysics(x, y, CollisionPass::Third, candidates);
+        candidates.ThirdPass.pop_back();
     }
 }
 
-void SnapsEngine::SolveMovementHorizontal(Block& block, MovementResolution& resolution) {
-    if (block.Velocity.x >= 0)
-        SolveMovementRight(block, resolution);
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementHorizontal(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    if (block.Velocity.x >= RealOf<Body>())
+        SolveMovementRight(block, resolution, candidates);
     else
-        SolveMovementLeft(block, resolution);
+        SolveMovementLeft(block, resolution, candidates);
 }
 
-void SnapsEngine::SolveMovementVertical(Block& block, MovementResolution& resolution) {
-    if (block.Velocity.y <= 0)
-        SolveMovementUp(block, resolution);
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementVertical(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    if (block.Velocity.y <= RealOf<Body>())
+        SolveMovementUp(block, resolution, candidates);
     else
-        SolveMovementDown(block, resolution);
+        SolveMovementDown(block, resolution, candidates);
 }
 
-void SnapsEngine::SolveMovementLeft(Block& block, MovementResolution& resolution) {
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementLeft(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    using Real = RealOf<Body>;
     const int x = resolution.X;
     const int y = resolution.Y;
 
     // Block is not moving left
-    if (block.Velocity.x >= 0) return; // moving right
+    if (block.Velocity.x >= Real()) return; // moving right
 
-    const int desiredXGrid = std::floor(block.WorldPosition.x / BLOCK_SIZE);
-    const bool wantsToMoveLeft = desiredXGrid < x and block.Velocity.x < 0;
+    const int desiredXGrid = CellOf(block.WorldPosition.x);
+    const bool wantsToMoveLeft = desiredXGrid < x and block.Velocity.x < Real();
 
-    // No blocks to the left
-    if (not m_Grid.InBounds(x-1, y)) {
+    const auto cell = m_Grid.GetCursor(x, y);
+    const std::uint16_t neighbours = m_Grid.GetNeighbours(cell.Index);
+
+    // Desired grid is occupied or there are no blocks to the left. Stop.
+    if (neighbours & Neighbours::LEFT) {
         if (wantsToMoveLeft) {
             StopBlockAndAlignToX(block, x);
         }
         return;
     }
 
-    auto& blockLeft = m_Grid.At(x - 1, y);
-
-    // Desired grid is occupied. Stop.
-    if (wantsToMoveLeft and blockLeft.has_value()) {
-        StopBlockAndAlignToX(block, x);
-        return;
-    }
-
     // Desired grid is free. Claim it if we have enough velocity to reach it.
-    if (wantsToMoveLeft and not blockLeft.has_value()) {
+    if (wantsToMoveLeft) {
         // Claim a block to the right only if the center of the block can reach it (smooth edge overlapping).
         // We basically slide the block vertically until its center point does not exceed the edge.
-        const float blockCenterY = block.WorldPosition.y + BLOCK_SIZE / 2;
-        const int blockCenterYGrid = std::floor(blockCenterY / BLOCK_SIZE);
-        const auto& blockLeftCenter = blockCenterYGrid == y ? blockLeft : m_Grid.At(x - 1, blockCenterYGrid);
-        if (blockLeftCenter.has_value()) {
+        const Real blockCenterY = block.WorldPosition.y + static_cast<Real>(BLOCK_SIZE / 2);
+        const int blockCenterYGrid = CellOf(blockCenterY);
+        assert(std::abs(blockCenterYGrid - y) <= 1);
+        if (neighbours & Neighbours::Of(-1, blockCenterYGrid - y)) {
             StopBlockAndAlignToX(block, x);
             return;
         }
 
-        const float deceleration = block.Acceleration.x > 0 ? block.Acceleration.x : 0.0f;
-        const float minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
+        const Real deceleration = block.Acceleration.x > Real() ? block.Acceleration.x : Real();
+        const Real minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
 
-        // Not enough velocity to reach the next grid. Stop and align to grid.
-        if (std::abs(block.Velocity.x) < minVelocityToReachNextGrid) {
+        // Not enough velocity to reach the next grid, or another worker has claimed it. Stop and align to grid.
+        const auto left = cell.Left();
+        if (Abs(block.Velocity.x) < minVelocityToReachNextGrid or not ClaimCell(left.Index, candidates)) {
             StopBlockAndAlignToX(block, x);
         } else { // Claim grid to the left.
-            blockLeft = block;
-            m_Grid.Remove(x, y);
+            m_Grid.Move(cell.Index, left.Index);
             resolution.X -= 1;
         }
     }
 }
 
 
-void SnapsEngine::SolveMovementRight(Block& block, MovementResolution& resolution) {
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementRight(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
     const int x = resolution.X;
     const int y = resolution.Y;
 
     // Block is not moving right
-    if (block.Velocity.x < 0) return; // moving left
+    if (block.Velocity.x < Real()) return; // moving left
+
+    const int desiredXGrid = CellOf(block.WorldPosition.x + static_cast<Real>(BLOCK_SIZE));
+    const bool wantsToMoveRight = desiredXGrid > x and block.Velocity.x > Real();
 
-    const int desiredXGrid = static_cast<int>(block.WorldPosition.x + BLOCK_SIZE) / BLOCK_SIZE;
-    const bool wantsToMoveRight = desiredXGrid > x and block.Velocity.x > 0;
+    const auto cell = m_Grid.GetCursor(x, y);
+    const std::uint16_t neighbours = m_Grid.GetNeighbours(cell.Index);
 
-    // No blocks to the right
-    if (not m_Grid.InBounds(x+1, y)) {
+    // No blocks to the right. Only checked when the cell looks occupied, cells outside of the grid do.
+    if (neighbours & Neighbours::RIGHT and not m_Grid.InBounds(x+1, y)) {
         if (wantsToMoveRight) {
             StopBlockAndAlignToX(block, x);
         }
         return;
     }
 
-    auto& blockRight = m_Grid.At(x + 1, y);
+    const auto right = cell.Right();
 
     // Desired grid is occupied. Stop.
-    if (wantsToMoveRight and blockRight.has_value()) {
-        const bool blockRightIsMoving = blockRight->Velocity.x != 0 or blockRight->Velocity.y != 0;
+    if (wantsToMoveRight and neighbours & Neighbours::RIGHT) {
+        const Vector blockRightVelocity = GetVelocity<Vector>(right.Index);
+        const bool blockRightIsMoving = blockRightVelocity.x != Real() or blockRightVelocity.y != Real();
         if (blockRightIsMoving and resolution.Pass != CollisionPass::Secondary) { // Try in the second pass. If we are lucky, the block on
-            m_SecondPassCandidates.push({x, y});                      // the right will claim another block and release this one.
+            candidates.SecondPass.push_back({x, y});                              // the right will claim another block and release this one.
             resolution.Resolved = true;
         } else { // Stop.
             StopBlockAndAlignToX(block, x);
@@ -225,122 +980,143 @@ void SnapsEngine::SolveMovementRight(Block& block, MovementResolution& resolutio
     }
 
     // Desired grid is free. Claim it if we have enough velocity to reach it.
-    if (wantsToMoveRight and not blockRight.has_value()) {
+    if (wantsToMoveRight and not (neighbours & Neighbours::RIGHT)) {
         // Claim a block to the right only if the center of the block can reach it (smooth edge overlapping).
         // We basically slide the block vertically until its center point does not exceed the edge.
-        const float blockCenterY = block.WorldPosition.y + BLOCK_SIZE / 2;
-        const int blockCenterYGrid = std::floor(blockCenterY / BLOCK_SIZE);
-        const auto& blockRightCenter = blockCenterYGrid == y ? blockRight : m_Grid.At(x + 1, blockCenterYGrid);
-        if (blockRightCenter.has_value() and blockCenterY > blockRightCenter->WorldPosition.y and blockCenterY < blockRightCenter->WorldPosition.y + BLOCK_SIZE) {
-            if (resolution.Pass != CollisionPass::Secondary) {
-                m_SecondPassCandidates.push({x, y});
-                resolution.Resolved = true;
-            } else {
-                StopBlockAndAlignToX(block, x);
+        const Real blockCenterY = block.WorldPosition.y + static_cast<Real>(BLOCK_SIZE / 2);
+        const int blockCenterYGrid = CellOf(blockCenterY);
+        assert(std::abs(blockCenterYGrid - y) <= 1);
+        if (neighbours & Neighbours::Of(1, blockCenterYGrid - y)) {
+            const Real blockRightCenterY = GetWorldPosition<Vector>(m_Grid.GetIndex(x + 1, blockCenterYGrid)).y;
+            if (blockCenterY > blockRightCenterY and blockCenterY < blockRightCenterY + static_cast<Real>(BLOCK_SIZE)) {
+                if (resolution.Pass != CollisionPass::Secondary) {
+                    candidates.SecondPass.push_back({x, y});
+                    resolution.Resolved = true;
+                } else {
+                    StopBlockAndAlignToX(block, x);
+                }
+                return;
             }
-            return;
         }
 
-        const float deceleration = block.Acceleration.x < 0 ? -block.Acceleration.x : 0.0f;
-        const float minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
+        const Real deceleration = block.Acceleration.x < Real() ? -block.Acceleration.x : Real();
+        const Real minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
 
-        // Not enough velocity to reach next grid. Stop and align to grid.
-        if (std::abs(block.Velocity.x) < minVelocityToReachNextGrid) {
+        // Not enough velocity to reach next grid, or another worker has claimed it. Stop and align to grid.
+        if (Abs(block.Velocity.x) < minVelocityToReachNextGrid or not ClaimCell(right.Index, candidates)) {
             StopBlockAndAlignToX(block, x);
             return;
-        } else if (block.Velocity.x > 0) { // Claim grid to the right.
-            blockRight = block;
-            m_Grid.Remove(x, y);
+        } else if (block.Velocity.x > Real()) { // Claim grid to the right.
+            m_Grid.Move(cell.Index, right.Index);
             resolution.X += 1;
         }
     }
 
     // ALIGN POSITION TO GRID IF NECESSARY
-    const float distanceFromCorrectPosition = static_cast<float>(x * BLOCK_SIZE) - block.WorldPosition.x;
+    const Real distanceFromCorrectPosition = CellStart<Real>(x) - block.WorldPosition.x;
     // Block stopped before reaching end of its own grid.
-    if (block.Velocity.x == 0 and block.Acceleration.x == 0 and distanceFromCorrectPosition != 0.0f) {
-        std::cout << "block stopped without reaching end of its own grid\n";
+    if (block.Velocity.x == Real() and block.Acceleration.x == Real() and distanceFromCorrectPosition != Real()) {
+        LogEvent("block stopped without reaching end of its own grid");
         // Snap it to the grid in one shot.
         StopBlockAndAlignToX(block, x);
     }
 }
 
-void SnapsEngine::SolveMovementDown(Block& block, MovementResolution& resolution) {
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementDown(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
     const int x = resolution.X;
     const int y = resolution.Y;
 
     // Block is not moving down
-    if (block.Velocity.y <= 0) return;
+    if (block.Velocity.y <= Real()) return;
 
-    const int desiredYGrid = static_cast<int>(block.WorldPosition.y + BLOCK_SIZE) / BLOCK_SIZE;
+    const int desiredYGrid = CellOf(block.WorldPosition.y + static_cast<Real>(BLOCK_SIZE));
     const bool wantsToMoveDown = desiredYGrid > y;
 
-    // No block below
-    if (not m_Grid.InBounds(x, y+1)) {
+    const auto cell = m_Grid.GetCursor(x, y);
+    const std::uint16_t neighbours = m_Grid.GetNeighbours(cell.Index);
+
+    // No block below. Only checked when the cell looks occupied, cells outside of the grid do.
+    if (neighbours & Neighbours::DOWN and not m_Grid.InBounds(x, y+1)) {
         if (wantsToMoveDown) {
             StopBlockAndAlignToY(block, y);
         }
         return;
     }
 
-    auto& blockBelow = m_Grid.At(x, y+1);
+    const auto below = cell.Down();
 
     // Desired grid is occupied. Stop.
-    if (wantsToMoveDown and blockBelow.has_value()) {
+    if (wantsToMoveDown and neighbours & Neighbours::DOWN) {
         StopBlockAndAlignToY(block, y);
         return;
     }
 
     // Desired grid is free, claim it. Assume we will always have enough velocity to reach it due to gravity.
-    if (wantsToMoveDown and not blockBelow.has_value()) {
+    if (wantsToMoveDown) {
         // Claim a block below only if the center of the block can reach it (smooth edge overlapping).
         // We basically slide the block horizontally until its center point does not exceed the edge.
-        const float blockCenterX = block.WorldPosition.x + BLOCK_SIZE / 2;
-        const int blockCenterXGrid = std::floor(blockCenterX / BLOCK_SIZE);
-        const auto& blockBelowCenter = blockCenterXGrid == x ? blockBelow : m_Grid.At(blockCenterXGrid, y+1);
-        if (blockBelowCenter.has_value()) {
+        const Real blockCenterX = block.WorldPosition.x + static_cast<Real>(BLOCK_SIZE / 2);
+        const int blockCenterXGrid = CellOf(blockCenterX);
+        assert(std::abs(blockCenterXGrid - x) <= 1);
+        if (neighbours & Neighbours::Of(blockCenterXGrid - x, 1) or not ClaimCell(below.Index, candidates)) {
             StopBlockAndAlignToY(block, y);
             return;
         }
 
-        blockBelow = block;
-        m_Grid.Remove(x, y);
+        m_Grid.Move(cell.Index, below.Index);
         resolution.Y += 1;
         return;
     }
 
     // Only accelerated movements mid-air collision can result with a stop because
     // the gravity will make the block fall again to the desired spot.
-    if (blockBelow and block.WorldPosition.y + BLOCK_SIZE >= blockBelow->WorldPosition.y) {
+    // Terrain below is at its cell and doesn't move, so it's not read at all.
+    if (not (neighbours & Neighbours::DOWN)) return;
+    const bool isStaticBelow = neighbours & Neighbours::STATIC_BELOW;
+    const Real blockBelowY = isStaticBelow ? CellStart<Real>(y + 1) : GetWorldPosition<Vector>(below.Index).y;
+    if (block.WorldPosition.y + static_cast<Real>(BLOCK_SIZE) >= blockBelowY) {
         // Collided with a block below. If it goes the same direction use its speed do continue down. Otherwise, stop.
-        block.Velocity.y = blockBelow->Velocity.y >= 0 ? blockBelow->Velocity.y : 0;
+        const Real blockBelowVelocityY = isStaticBelow ? Real() : GetVelocity<Vector>(below.Index).y;
+        block.Velocity.y = blockBelowVelocityY >= Real() ? blockBelowVelocityY : Real();
     }
 }
 
-void SnapsEngine::SolveMovementUp(Block& block, MovementResolution& resolution) {
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::SolveMovementUp(Body& block, MovementResolution& resolution, CollisionPassCandidates& candidates) {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
     const int x = resolution.X;
     const int y = resolution.Y;
     // Block is not moving up
-    if (block.Velocity.y > 0) return; // moving down
+    if (block.Velocity.y > Real()) return; // moving down
 
-    const int desiredYGrid = std::floor(block.WorldPosition.y / BLOCK_SIZE);
+    const int desiredYGrid = CellOf(block.WorldPosition.y);
     const bool wantsToMoveUp = desiredYGrid < y;
 
-    // No blocks above
-    if (not m_Grid.InBounds(x, y-1)) {
+    const auto cell = m_Grid.GetCursor(x, y);
+    const std::uint16_t neighbours = m_Grid.GetNeighbours(cell.Index);
+
+    // No blocks above. Only checked when the cell looks occupied, cells outside of the grid do.
+    if (neighbours & Neighbours::UP and not m_Grid.InBounds(x, y-1)) {
         if (wantsToMoveUp) {
             StopBlockAndAlignToY(block, y);
         }
         return;
     }
 
-    auto& blockAbove = m_Grid.At(x, y - 1);
+    const auto above = cell.Up();
 
     // Desired grid is occupied.
-    if (wantsToMoveUp and blockAbove.has_value()) {
-        const bool blockAboveIsMoving = blockAbove->Velocity.x != 0 or blockAbove->Velocity.y != 0;
+    if (wantsToMoveUp and neighbours & Neighbours::UP) {
+        const Vector blockAboveVelocity = GetVelocity<Vector>(above.Index);
+        const bool blockAboveIsMoving = blockAboveVelocity.x != Real() or blockAboveVelocity.y != Real();
         if (blockAboveIsMoving and resolution.Pass != CollisionPass::Third) { // Try in the second pass. If we are lucky, the block above
-            m_ThirdPassCandidates.push({x, y});                         // will claim another block and release this one.
+            candidates.ThirdPass.push_back({x, y});                           // will claim another block and release this one.
             resolution.Resolved = true;
         } else { // Stop.
             StopBlockAndAlignToY(block, y);
@@ -349,151 +1125,420 @@ void SnapsEngine::SolveMovementUp(Block& block, MovementResolution& resolution)
     }
 
     // Desired grid is free. Claim it if we have enough velocity to reach it.
-    if (wantsToMoveUp and not blockAbove.has_value()) {
+    if (wantsToMoveUp and not (neighbours & Neighbours::UP)) {
         // Claim a block above only if the center of the block can reach it (smooth edge overlapping).
         // We basically slide the block horizontally until its center point does not exceed the edge.
-        const float blockCenterX = block.WorldPosition.x + BLOCK_SIZE / 2;
-        const int blockCenterXGrid = std::floor(blockCenterX / BLOCK_SIZE);
-        const auto& blockAboveCenter = blockCenterXGrid == x ? blockAbove : m_Grid.At(blockCenterXGrid, y-1);
-        if (blockAboveCenter.has_value() and blockCenterX > blockAboveCenter->WorldPosition.x and blockCenterX < blockAboveCenter->WorldPosition.x + BLOCK_SIZE) {
-            if (resolution.Pass != CollisionPass::Third) {
-                m_ThirdPassCandidates.push({x, y});
-                resolution.Resolved = true;
-            } else {
-                StopBlockAndAlignToY(block, y);
+        const Real blockCenterX = block.WorldPosition.x + static_cast<Real>(BLOCK_SIZE / 2);
+        const int blockCenterXGrid = CellOf(blockCenterX);
+        assert(std::abs(blockCenterXGrid - x) <= 1);
+        if (neighbours & Neighbours::Of(blockCenterXGrid - x, -1)) {
+            const Real blockAboveCenterX = GetWorldPosition<Vector>(m_Grid.GetIndex(blockCenterXGrid, y-1)).x;
+            if (blockCenterX > blockAboveCenterX and blockCenterX < blockAboveCenterX + static_cast<Real>(BLOCK_SIZE)) {
+                if (resolution.Pass != CollisionPass::Third) {
+                    candidates.ThirdPass.push_back({x, y});
+                    resolution.Resolved = true;
+                } else {
+                    StopBlockAndAlignToY(block, y);
+                }
+                return;
             }
-            return;
         }
 
-        const float deceleration = block.Acceleration.y > 0 ? block.Acceleration.y : 0.0f;
-        const float minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
+        const Real deceleration = block.Acceleration.y > Real() ? block.Acceleration.y : Real();
+        const Real minVelocityToReachNextGrid = MinVelocityForDistance(deceleration);
 
-        // Not enough velocity to reach next grid. Stop.
-        if (std::abs(block.Velocity.y) < minVelocityToReachNextGrid) {
+        // Not enough velocity to reach next grid, or another worker has claimed it. Stop.
+        if (Abs(block.Velocity.y) < minVelocityToReachNextGrid or not ClaimCell(above.Index, candidates)) {
             StopBlockAndAlignToY(block, y);
         } else { // Claim grid above.
-            blockAbove = block;
-            m_Grid.Remove(x, y);
+            m_Grid.Move(cell.Index, above.Index);
             resolution.Y -= 1;
         }
     }
 }
 
-void SnapsEngine::ApplyGravity(Block& block) {
-    block.ForceAccum += Vector2{0.0f, m_Config.Gravity} * block.GravityScale / block.InvMass;
-}
-
-void SnapsEngine::ApplyFriction(const int x, const int y, Block& block) {
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::ApplyFriction(const int x, const int y, Body& block) {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
     if (not m_Grid.InBounds(x, y+1)) return;
     if (not m_Grid.InBounds(x, y-1)) return;
 
-    const auto& surface = block.ForceAccum.y > 0 ? m_Grid.At(x, y+1) : m_Grid.At(x, y-1);
-    const bool isSliding = surface.has_value()                                // Block below must exist
-        and AreTouching(block, *surface)                                      // Block must touch the surface
-        and surface->Velocity.x == 0                                          // Surface must be stationary in X
-        and block.Velocity.y >= 0;                                            // This I don't remember :D
+    const auto cell = m_Grid.GetCursor(x, y);
+    const std::uint16_t neighbours = m_Grid.GetNeighbours(cell.Index);
+    const bool isSurfaceBelow = block.ForceAccum.y > Real();
+    if (not (neighbours & (isSurfaceBelow ? Neighbours::DOWN : Neighbours::UP))) return; // Block below must exist
+    const std::size_t surface = isSurfaceBelow ? cell.Down().Index : cell.Up().Index;
+
+    // Terrain is at its cell and doesn't move, only its material is read.
+    if (isSurfaceBelow and neighbours & Neighbours::STATIC_BELOW) {
+        const Vector surfacePosition = {CellStart<Real>(x), CellStart<Real>(y + 1)};
+        if (AreTouching(block.WorldPosition, surfacePosition) and block.Velocity.y >= Real()) {
+            ApplyFrictionBetween(block, Vector{}, m_Grid.GetMaterial(surface));
+        }
+        return;
+    }
+
+    // The surface is often terrain, so it's read through the grid instead of a BlockRef.
+    const Vector surfaceVelocity = GetVelocity<Vector>(surface);
+    const bool isSliding = AreTouching(block.WorldPosition, GetWorldPosition<Vector>(surface)) // Block must touch the surface
+        and surfaceVelocity.x == Real()                                       // Surface must be stationary in X
+        and block.Velocity.y >= Real();                                       // This I don't remember :D
 
     if (isSliding) {
-        ApplyFrictionBetween(block, *surface);
+        ApplyFrictionBetween(block, surfaceVelocity, m_Grid.GetMaterial(surface));
     }
 }
 
-void SnapsEngine::ApplyFrictionBetween(Block& block, const Block& surface) {
-    const float blockAcceleration = block.ForceAccum.x * block.InvMass;
-    const float blockFinalVelocity = block.Velocity.x + blockAcceleration * m_DeltaTime;
-    const float relativeVelocity = std::abs(blockFinalVelocity - surface.Velocity.x);
-    if (relativeVelocity <= 0.01f) {
-        block.Velocity.x = surface.Velocity.x;
+template <typename GridType>
+template <typename Body, typename Vector>
+void BasicSnapsEngine<GridType>::ApplyFrictionBetween(Body& block, const Vector surfaceVelocity, const Material& surfaceMaterial) {
+    using Real = RealOf<Body>;
+    const Material& blockMaterial = block.GetMaterial();
+    const Real invMass(blockMaterial.InvMass);
+    const Real deltaTime(m_DeltaTime);
+    const Real blockAcceleration = block.ForceAccum.x * invMass;
+    const Real blockFinalVelocity = block.Velocity.x + blockAcceleration * deltaTime;
+    const Real relativeVelocity = Abs(blockFinalVelocity - surfaceVelocity.x);
+    if (relativeVelocity <= Real(0.01f)) {
+        block.Velocity.x = surfaceVelocity.x;
         return;
     }
 
-    const float dir = block.Velocity.x > 0 ? 1.0f : -1.0f;
-    const float mass = 1.0f / block.InvMass;
-    const float multiplier = std::sqrt(block.Friction * surface.Friction);
+    const Real dir = block.Velocity.x > Real() ? Real(1) : Real(-1);
+    const Real mass = Real(1) / invMass;
+    const Real multiplier = Sqrt(Real(blockMaterial.Friction) * Real(surfaceMaterial.Friction));
 
     // Assume the vertical force (gravity) is towards the surface
-    float frictionForce = std::abs(block.ForceAccum.y) * multiplier * mass * dir;
+    Real frictionForce = Abs(block.ForceAccum.y) * multiplier * mass * dir;
 
     // Clamp: if this force would reverse velocity, zero it instead
-    const float maxForce = mass * relativeVelocity / m_DeltaTime;
-    if (std::abs(frictionForce) > maxForce) {
+    const Real maxForce = mass * relativeVelocity / deltaTime;
+    if (Abs(frictionForce) > maxForce) {
         frictionForce = maxForce * dir;
-        std::cout << "friction stopped the object" << std::endl;
+        LogEvent("friction stopped the object");
     }
 
     block.ForceAccum.x -= frictionForce;
 }
 
-void SnapsEngine::ApplyDrag(Block& block) {
-    if (block.InvMass <= 0.0f) return;
-    if (m_Config.Drag <= 0.0f) return;
-
-    // If the block is almost stationary, skip to avoid tiny forces
-    if (std::abs(block.Velocity.x) < 0.01f and std::abs(block.Velocity.y) < 0.01) return;
-
-    Vector2 dragForce = block.Velocity * m_Config.Drag;
-
-    const float blockAcceleration = block.ForceAccum.x * block.InvMass;
-    const float blockFinalVelocity = block.Velocity.x + blockAcceleration * m_DeltaTime;
-    const float mass = 1.0f / block.InvMass;
-    const float maxForce = mass * blockFinalVelocity / m_DeltaTime;
-    if (std::abs(dragForce.x) > std::abs(maxForce)) {
-        dragForce.x = maxForce;
-        std::cout << "drag stopped the object" << std::endl;
-    }
-
-    // Don't apply drag for slow objects to reduce snapping.
-    if (std::abs(block.Velocity.x) < 1 / m_DeltaTime) {
-        dragForce.x = 0;
-    }
-    if (std::abs(block.Velocity.y) < 1 / m_DeltaTime) {
-        dragForce.y = 0;
-    }
-
-    block.ForceAccum -= dragForce;
-}
-
 // FIXME: Optimisation idea: instead of calculating finalX here and other things in applyGravity/Drag
 //        I could apply just velocity (without acceleration) and then decide whether I should apply
 //        resistance forces and how much. Only after that I would apply the forces by adding them to
 //        velocity and then to position.
-void SnapsEngine::DiscardResistanceForcesIfNecessary(int x, int y, Block& block) {
-    const float minSlidingVelocity = m_Config.SmoothSnappingMinVelocity;
-    const int alignedX = x * BLOCK_SIZE;
-    const float distance = static_cast<float>(alignedX) - block.WorldPosition.x;
-    if (std::abs(distance) == 0) return;
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::DiscardResistanceForcesIfNecessary(int x, int y, Body& block) {
+    using Real = RealOf<Body>;
+    const Real minSlidingVelocity(m_Config.SmoothSnappingMinVelocity);
+    const Real distance = CellStart<Real>(x) - block.WorldPosition.x;
+    if (Abs(distance) == Real()) return;
 
     // Calculate a final position as if deceleration was discarded and check
     // if a block will overshoot the current tile (reach the end)
-    const float targetVelocityX = std::copysign(std::max(minSlidingVelocity, std::abs(block.Velocity.x)), block.Velocity.x);
-    const float finalX = block.WorldPosition.x + targetVelocityX * m_DeltaTime;
-    const bool movingRight = block.Velocity.x > 0;
-    const float offset = movingRight ? BLOCK_SIZE : 0;
-    const int finalXGrid = static_cast<int>(finalX + offset) / BLOCK_SIZE;
+    const Real targetVelocityX = CopySign(std::max(minSlidingVelocity, Abs(block.Velocity.x)), block.Velocity.x);
+    const Real finalX = block.WorldPosition.x + targetVelocityX * Real(m_DeltaTime);
+    const bool movingRight = block.Velocity.x > Real();
+    const Real offset = movingRight ? Real(BLOCK_SIZE) : Real();
+    const int finalXGrid = CellOf(finalX + offset);
     if (finalXGrid != x) return;
 
-    const float deceleration = -block.ForceAccum.x * block.InvMass;
-    const float minVelocityToReachNextGrid = MinVelocityForDistance(deceleration, distance);
+    const Real deceleration = -block.ForceAccum.x * Real(block.GetMaterial().InvMass);
+    const Real minVelocityToReachNextGrid = MinVelocityForDistance(deceleration, distance);
 
     // Block is too slow to reach the end of a tile assuming deceleration will be constant.
-    if (std::abs(block.Velocity.x) < minVelocityToReachNextGrid) {
+    if (Abs(block.Velocity.x) < minVelocityToReachNextGrid) {
         // Discard deceleration force because if left it would stop the block mid-tile
         // not reaching the end of the tile. So we allow smooth sliding to the end with
         // no deceleration (friction, drag, et}c.)
-        block.ForceAccum.x = 0;
+        block.ForceAccum.x = Real();
 
         // If block is super slow, then we can speed it up
-        if (std::abs(block.Velocity.x) < minSlidingVelocity) {
-            block.Velocity.x = std::copysign(minSlidingVelocity, block.Velocity.x);
+        if (Abs(block.Velocity.x) < minSlidingVelocity) {
+            block.Velocity.x = CopySign(minSlidingVelocity, block.Velocity.x);
+        }
+    }
+}
+
+template <typename GridType>
+template <typename Vector>
+bool BasicSnapsEngine<GridType>::AreTouching(const Vector position1, const Vector position2) const {
+    using Real = decltype(Vector::x);
+    return position1.x + Real(BLOCK_SIZE) >= position2.x
+        and position1.x <= position2.x + Real(BLOCK_SIZE)
+        and position1.y + Real(BLOCK_SIZE) >= position2.y
+        and position1.y <= position2.y + Real(BLOCK_SIZE);
+}
+
+// Blocks enter one cell per round, so the rounds go on until no block has a cell left to enter. A round decides
+// what every block does from the grid as it was at the beginning of the round, then applies all of it at once.
+// Deciding runs over all blocks on worker threads. Moves are applied by the calling thread, because moving a
+// block wakes the neighbours of both cells and neighbours of blocks in a chain are shared.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ResolveIntents() {
+    if (m_Config.FixedPoint) {
+        RunIntentRounds<FixedBlockRef>();
+    } else {
+        RunIntentRounds<BlockRef>();
+    }
+}
+
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::RunIntentRounds() {
+    BlockStorage& blocks = m_Grid.Blocks();
+    if (m_Intents.size() < blocks.Size()) m_Intents.resize(blocks.Size());
+
+    m_Movers.clear();
+    for (const auto& [y, minX, endX] : m_DirtySegments) {
+        for (int x = m_Grid.FindNextActiveInRow(minX, y, endX); x < endX; x = m_Grid.FindNextActiveInRow(x + 1, y, endX)) {
+            const std::size_t index = m_Grid.GetIndex(x, y);
+            if (not IsMover(index)) continue;
+            if constexpr (std::same_as<Body, FixedBlockRef>) blocks.UpdateFixedState(m_Grid.GetSlot(index));
+            m_Movers.push_back(m_Grid.GetSlot(index));
+        }
+    }
+
+    while (not m_Movers.empty()) {
+        ForEachMover([this, &blocks](const std::uint32_t slot, int) {
+            const auto [x, y] = m_Grid.GetXY(blocks.Cell[slot]);
+            m_Intents[slot] = DecideIntent(RefOf<Body>(blocks.Cell[slot]), x, y);
+        });
+        ForEachMover([this](const std::uint32_t slot, int) {
+            m_Intents[slot].Won = m_Intents[slot].Kind == IntentKind::Move and WinsArbitration(slot);
+        });
+        ForEachMover([this](const std::uint32_t slot, const int worker) {
+            if (m_Intents[slot].Won) ResolveChain(slot, m_Chains[worker]);
+        });
+        CommitIntents<Body>();
+    }
+}
+
+template <typename GridType>
+template <typename Body>
+Body BasicSnapsEngine<GridType>::RefOf(const std::size_t index) {
+    if constexpr (std::same_as<Body, FixedBlockRef>) {
+        return FixedRef(index);
+    } else {
+        return m_Grid.Ref(index);
+    }
+}
+
+// Dynamic block that hasn't been resolved in this step yet.
+template <typename GridType>
+bool BasicSnapsEngine<GridType>::IsMover(const std::size_t index) const {
+    return m_Grid.IsDynamic(index) and m_Grid.Blocks().Flags[m_Grid.GetSlot(index)].NeedsCollisionResolution;
+}
+
+// The first phase, only reads the grid. The next cell is found like in SweepMovement() and checked by the same
+// rules as in SolveMovementLeft() and the others, except that a moving block in the way is followed instead of
+// postponed. The block stops right away where the sweep would stop it in any pass.
+template <typename GridType>
+template <typename Body>
+typename BasicSnapsEngine<GridType>::MoveIntent BasicSnapsEngine<GridType>::DecideIntent(const Body& block, const int x, const int y) const {
+    using Vector = VectorOf<Body>;
+    using Real = RealOf<Body>;
+    const Vector position = block.WorldPosition;
+    const Vector velocity = block.Velocity;
+    MoveIntent intent;
+
+    const bool crossesX = CellsAhead(position.x, velocity.x, x) > 0;
+    const bool crossesY = CellsAhead(position.y, velocity.y, y) > 0;
+    if (not crossesX and not crossesY) {
+        // Collided mid-air with a block below, see SolveMovementDown().
+        if (velocity.y > Real() and m_Grid.InBounds(x, y + 1)) {
+            const std::size_t below = m_Grid.GetIndex(x, y + 1);
+            if (m_Grid.IsOccupied(below) and position.y + static_cast<Real>(BLOCK_SIZE) >= GetWorldPosition<Vector>(below).y) {
+                const Real belowVelocityY = GetVelocity<Vector>(below).y;
+                intent.VelocityY = belowVelocityY >= Real() ? belowVelocityY : Real();
+            }
+        }
+        return intent;
+    }
+
+    const Real timeX = crossesX ? TimeSinceCrossing(position.x, velocity.x, x) : Real();
+    const Real timeY = crossesY ? TimeSinceCrossing(position.y, velocity.y, y) : Real();
+    intent.Horizontal = crossesX and (not crossesY or timeX >= timeY);
+    const Real time = intent.Horizontal ? timeX : timeY;
+    const int stepX = intent.Horizontal ? (velocity.x > Real() ? 1 : -1) : 0;
+    const int stepY = intent.Horizontal ? 0 : (velocity.y > Real() ? 1 : -1);
+    intent.TargetX = x + stepX;
+    intent.TargetY = y + stepY;
+    intent.Priority = PriorityOf(time);
+    intent.Kind = IntentKind::Stop;
+    if (not m_Grid.InBounds(intent.TargetX, intent.TargetY)) return intent;
+
+    const std::size_t target = m_Grid.GetIndex(intent.TargetX, intent.TargetY);
+    if (m_Grid.IsOccupied(target)) {
+        if (not IsMover(target)) return intent;
+    } else {
+        // Centre of the block along the other axis, where it was when it reached the target cell.
+        const Real before = intent.Horizontal
+            ? PositionBefore(position.y, velocity.y, std::min(time, Real(m_DeltaTime)), y)
+            : PositionBefore(position.x, velocity.x, std::min(time, Real(m_DeltaTime)), x);
+        const Real center = before + static_cast<Real>(BLOCK_SIZE / 2);
+        const int centerCell = CellOf(center);
+        const int sideX = intent.Horizontal ? intent.TargetX : centerCell;
+        const int sideY = intent.Horizontal ? centerCell : intent.TargetY;
+        if (centerCell != (intent.Horizontal ? y : x) and m_Grid.InBounds(sideX, sideY) and m_Grid.IsOccupied(m_Grid.GetIndex(sideX, sideY))) {
+            // Blocks to the left and below stop the block, the ones to the right and above only if the centre is inside them.
+            const std::size_t side = m_Grid.GetIndex(sideX, sideY);
+            if (stepX < 0 or stepY > 0) return intent;
+            const Vector sidePosition = GetWorldPosition<Vector>(side);
+            const Real sideStart = intent.Horizontal ? sidePosition.y : sidePosition.x;
+            if (center > sideStart and center < sideStart + static_cast<Real>(BLOCK_SIZE)) {
+                if (IsMover(side)) intent.Kind = IntentKind::Wait;
+                return intent;
+            }
+        }
+    }
+
+    // Enough velocity to reach the next cell, falling blocks always have it thanks to gravity.
+    if (stepY <= 0) {
+        const Real acceleration = intent.Horizontal ? block.Acceleration.x : block.Acceleration.y;
+        const Real deceleration = stepX > 0 ? -acceleration : acceleration;
+        const Real speed = Abs(intent.Horizontal ? velocity.x : velocity.y);
+        if (speed < MinVelocityForDistance(deceleration > Real() ? deceleration : Real())) return intent;
+    }
+    intent.Kind = IntentKind::Move;
+    return intent;
+}
+
+// Blocks entering the same cell are next to it. The one that reached it first wins, ties go to the upper one
+// and then to the left one, so exactly one of them wins no matter the order in which they are checked.
+template <typename GridType>
+bool BasicSnapsEngine<GridType>::WinsArbitration(const std::uint32_t slot) const {
+    const MoveIntent& intent = m_Intents[slot];
+    const auto [x, y] = m_Grid.GetXY(m_Grid.Blocks().Cell[slot]);
+    constexpr std::pair<int, int> SIDES[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& [dx, dy] : SIDES) {
+        const int rivalX = intent.TargetX + dx;
+        const int rivalY = intent.TargetY + dy;
+        if ((rivalX == x and rivalY == y) or not m_Grid.InBounds(rivalX, rivalY)) continue;
+        const std::size_t rivalIndex = m_Grid.GetIndex(rivalX, rivalY);
+        if (not IsMover(rivalIndex)) continue;
+
+        const MoveIntent& rival = m_Intents[m_Grid.GetSlot(rivalIndex)];
+        if (rival.Kind != IntentKind::Move or rival.TargetX != intent.TargetX or rival.TargetY != intent.TargetY) continue;
+        if (rival.Priority > intent.Priority or (rival.Priority == intent.Priority and std::pair(rivalY, rivalX) < std::pair(y, x))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The second phase. A block moves if its target cell is empty or the block in it moves too. Every cell has
+// a single winner, so following the targets either ends or returns to the first block, which is a cycle
+// of blocks swapping places that is blocked. Results are shared by all blocks of the chain. Chains that
+// overlap may be followed by several threads at once, all of them write the same results.
+template <typename GridType>
+void BasicSnapsEngine<GridType>::ResolveChain(const std::uint32_t slot, std::vector<std::uint32_t>& chain) {
+    chain.clear();
+    ChainResult result = ChainResult::Blocked;
+    for (std::uint32_t link = slot; ;) {
+        MoveIntent& intent = m_Intents[link];
+        if (intent.Kind != IntentKind::Move or not intent.Won) break;
+        const ChainResult known = std::atomic_ref(intent.Result).load(std::memory_order_relaxed);
+        if (known != ChainResult::Unknown) {
+            result = known;
+            break;
+        }
+        chain.push_back(link);
+
+        const std::size_t target = m_Grid.GetIndex(intent.TargetX, intent.TargetY);
+        if (not m_Grid.IsOccupied(target)) {
+            result = ChainResult::Moves;
+            break;
+        }
+        if (not m_Grid.IsDynamic(target)) break;
+        link = m_Grid.GetSlot(target);
+        if (link == slot) break;
+    }
+    for (const std::uint32_t link : chain) {
+        std::atomic_ref(m_Intents[link].Result).store(result, std::memory_order_relaxed);
+    }
+}
+
+// Applies the round. When nothing has moved, blocks waiting for others would wait forever, so they stop.
+template <typename GridType>
+template <typename Body>
+void BasicSnapsEngine<GridType>::CommitIntents() {
+    using Real = RealOf<Body>;
+    BlockStorage& blocks = m_Grid.Blocks();
+    int moves = 0;
+    for (const std::uint32_t slot : m_Movers) {
+        moves += CommitChain(slot);
+    }
+
+    std::erase_if(m_Movers, [&](const std::uint32_t slot) {
+        MoveIntent& intent = m_Intents[slot];
+        const std::size_t index = blocks.Cell[slot];
+        const auto [x, y] = m_Grid.GetXY(index);
+        Body block = RefOf<Body>(index);
+        const bool isDone = intent.Kind == IntentKind::Done;
+        if (isDone) {
+            // Stopped before reaching the end of its cell, see SolveMovementRight().
+            if (block.Velocity.x == Real() and block.Acceleration.x == Real() and block.WorldPosition.x != CellStart<Real>(x)) {
+                StopBlockAndAlignToX(block, x);
+            }
+            if (const Real* velocityY = std::get_if<Real>(&intent.VelocityY)) block.Velocity.y = *velocityY;
+            block.NeedsCollisionResolution = false;
+        } else if (intent.Kind == IntentKind::Stop or (intent.Result != ChainResult::Moved and moves == 0)) {
+            if (intent.Horizontal) {
+                StopBlockAndAlignToX(block, x);
+            } else {
+                StopBlockAndAlignToY(block, y);
+            }
         }
+        if constexpr (std::same_as<Body, FixedBlockRef>) blocks.UpdateFloats(slot);
+        if (isDone) intent = {};
+        return isDone;
+    });
+}
+
+// Moves the chain of the block, starting with the block at its head that enters an empty cell.
+template <typename GridType>
+int BasicSnapsEngine<GridType>::CommitChain(const std::uint32_t slot) {
+    if (m_Intents[slot].Result != ChainResult::Moves) return 0;
+    std::vector<std::uint32_t>& chain = m_Chains.front();
+    chain.clear();
+    for (std::uint32_t link = slot; ;) {
+        assert(m_Intents[link].Result == ChainResult::Moves);
+        chain.push_back(link);
+        const MoveIntent& intent = m_Intents[link];
+        const std::size_t target = m_Grid.GetIndex(intent.TargetX, intent.TargetY);
+        if (not m_Grid.IsOccupied(target)) break;
+        link = m_Grid.GetSlot(target);
+    }
+    for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+        MoveIntent& intent = m_Intents[*link];
+        m_Grid.Move(m_Grid.Blocks().Cell[*link], m_Grid.GetIndex(intent.TargetX, intent.TargetY));
+        intent.Result = ChainResult::Moved;
     }
+    return static_cast<int>(chain.size());
 }
 
-bool SnapsEngine::AreTouching(const Block& block1, const Block& block2) const {
-    return block1.WorldPosition.x + BLOCK_SIZE >= block2.WorldPosition.x
-        and block1.WorldPosition.x <= block2.WorldPosition.x + BLOCK_SIZE
-        and block1.WorldPosition.y + BLOCK_SIZE >= block2.WorldPosition.y
-        and block1.WorldPosition.y <= block2.WorldPosition.y + BLOCK_SIZE;
+// Both phases run on worker threads in batches of blocks, the calling thread runs small rounds alone.
+template <typename GridType>
+template <typename Function>
+void BasicSnapsEngine<GridType>::ForEachMover(const Function& function) {
+    constexpr std::size_t BATCH_SIZE = 256;
+    if (not IsParallel() or m_Movers.size() <= BATCH_SIZE) {
+        for (const std::uint32_t slot : m_Movers) {
+            function(slot, 0);
+        }
+        return;
+    }
+    m_WorkerPool->Run((m_Movers.size() + BATCH_SIZE - 1) / BATCH_SIZE, [&](const std::size_t batch, const int worker) {
+        const std::size_t end = std::min(m_Movers.size(), (batch + 1) * BATCH_SIZE);
+        for (std::size_t i = batch * BATCH_SIZE; i < end; i++) {
+            function(m_Movers[i], worker);
+        }
+    });
 }
 
+template class BasicSnapsEngine<Grid>;
+template class BasicSnapsEngine<SparseGrid>;
+
 }
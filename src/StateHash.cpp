@@ -0,0 +1,80 @@
+#include "snaps/StateHash.hpp"
+#include <bit>
+
+
+namespace snaps {
+
+namespace {
+// Finalizer of MurmurHash3, every bit of the input affects every bit of the result.
+std::uint64_t Mix(std::uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb93e53b5b5a9ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+std::uint64_t Combine(const std::uint64_t hash, const std::uint64_t value) {
+    return Mix(hash ^ value);
+}
+
+std::uint64_t Combine(const std::uint64_t hash, const Vector2 value) {
+    return Combine(hash, std::uint64_t{std::bit_cast<std::uint32_t>(value.x)} << 32 | std::bit_cast<std::uint32_t>(value.y));
+}
+
+std::uint64_t Combine(const std::uint64_t hash, const FixedVector2 value) {
+    return Combine(Combine(hash, static_cast<std::uint64_t>(value.x.Raw())), static_cast<std::uint64_t>(value.y.Raw()));
+}
+} // namespace
+
+std::uint64_t StateHash::Compute(Grid& grid) {
+    if (m_Grid != &grid or m_ChunkHashes.size() != grid.ChunkCount()) {
+        m_Grid = &grid;
+        m_ChunkHashes.assign(grid.ChunkCount(), 0);
+        m_Sum = 0;
+        for (std::size_t chunk = 0; chunk < m_ChunkHashes.size(); chunk++) {
+            grid.m_ChangedChunks[chunk] |= Grid::CHANGED_SINCE_HASH;
+        }
+    }
+
+    for (std::size_t chunk = 0; chunk < m_ChunkHashes.size(); chunk++) {
+        if (not (grid.m_ChangedChunks[chunk] & Grid::CHANGED_SINCE_HASH)) continue;
+        grid.m_ChangedChunks[chunk] &= ~Grid::CHANGED_SINCE_HASH;
+        const std::uint64_t hash = HashChunk(grid, chunk);
+        m_Sum += hash - m_ChunkHashes[chunk];
+        m_ChunkHashes[chunk] = hash;
+    }
+    return Mix(m_Sum);
+}
+
+// Cells are hashed with their coordinates and summed up, so the order of cells doesn't matter.
+std::uint64_t StateHash::HashChunk(const Grid& grid, const std::size_t chunk) {
+    const BlockStorage& blocks = grid.Blocks();
+    std::uint64_t sum = 0;
+    for (int run = 0; run < Grid::CHUNK_SIZE; run++) {
+        const auto [start, length] = grid.GetChunkRun(chunk, run);
+        for (std::size_t i = grid.FindNextOccupied(start, start + length); i < start + length; i = grid.FindNextOccupied(i + 1, start + length)) {
+            const auto [x, y] = grid.GetXY(i);
+            std::uint64_t hash = Mix(std::uint64_t{static_cast<std::uint32_t>(x)} << 32 | static_cast<std::uint32_t>(y));
+            if (grid.IsTerrain(i)) {
+                sum += Combine(hash, grid.m_TerrainMaterials[i]);
+                continue;
+            }
+            const std::uint32_t slot = grid.GetSlot(i);
+            const BlockFlags flags = blocks.Flags[slot];
+            hash = Combine(hash, blocks.WorldPosition[slot]);
+            hash = Combine(hash, blocks.Velocity[slot]);
+            hash = Combine(hash, blocks.ForceAccum[slot]);
+            hash = Combine(hash, blocks.Acceleration[slot]);
+            hash = Combine(hash, blocks.FixedPosition[slot]);
+            hash = Combine(hash, blocks.FixedVelocity[slot]);
+            hash = Combine(hash, std::uint64_t{blocks.Material[slot]} << 32 | std::uint64_t{blocks.RestSteps[slot]} << 8
+                | flags.IsDynamic << 3 | flags.NeedsCollisionResolution << 2 | flags.IsSleeping << 1 | grid.IsActive(i));
+            sum += hash;
+        }
+    }
+    return sum;
+}
+
+}
@@ -0,0 +1,69 @@
+#include "WorkerPool.hpp"
+
+
+namespace snaps {
+
+WorkerPool::WorkerPool(const int threadCount) {
+    for (int workerIndex = 1; workerIndex < threadCount; workerIndex++) {
+        m_Threads.emplace_back(&WorkerPool::WorkerLoop, this, workerIndex);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_BatchStarted.notify_all();
+    for (auto& thread : m_Threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const std::size_t taskCount, const Task& task) {
+    if (m_Threads.empty() or taskCount <= 1) {
+        for (std::size_t i = 0; i < taskCount; i++) task(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Task = &task;
+        m_TaskCount = taskCount;
+        m_NextTask = 0;
+        m_BusyWorkers = static_cast<int>(m_Threads.size());
+        m_Batch++;
+    }
+    m_BatchStarted.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock lock(m_Mutex);
+    m_BatchFinished.wait(lock, [this] { return m_BusyWorkers == 0; });
+    m_Task = nullptr;
+}
+
+void WorkerPool::WorkerLoop(const int workerIndex) {
+    std::uint64_t lastBatch = 0;
+    while (true) {
+        {
+            std::unique_lock lock(m_Mutex);
+            m_BatchStarted.wait(lock, [&] { return m_Stopping or m_Batch != lastBatch; });
+            if (m_Stopping) return;
+            lastBatch = m_Batch;
+        }
+
+        RunTasks(workerIndex);
+
+        std::lock_guard lock(m_Mutex);
+        if (--m_BusyWorkers == 0) m_BatchFinished.notify_one();
+    }
+}
+
+void WorkerPool::RunTasks(const int workerIndex) {
+    for (std::size_t i = m_NextTask++; i < m_TaskCount; i = m_NextTask++) {
+        (*m_Task)(i, workerIndex);
+    }
+}
+
+}
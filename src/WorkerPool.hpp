@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace snaps {
+
+/**
+ * Fixed set of threads that stay alive between batches of work. The thread calling Run() takes
+ * part in the batch as worker 0, so a pool of N threads starts N - 1 additional ones.
+ */
+class WorkerPool {
+public:
+    /**
+     * Non-owning reference to a callable `void(std::size_t taskIndex, int workerIndex)`.
+     * Unlike std::function it never allocates. The callable must outlive the Run() call.
+     */
+    class Task {
+    public:
+        template <typename Function> requires (not std::same_as<std::remove_cvref_t<Function>, Task>)
+        Task(Function&& function)
+            : m_Function(const_cast<void*>(static_cast<const void*>(std::addressof(function)))),
+              m_Invoke([](void* f, const std::size_t taskIndex, const int workerIndex) {
+                  (*static_cast<std::remove_reference_t<Function>*>(f))(taskIndex, workerIndex);
+              }) {}
+
+        void operator()(const std::size_t taskIndex, const int workerIndex) const {
+            m_Invoke(m_Function, taskIndex, workerIndex);
+        }
+
+    private:
+        void* m_Function;
+        void (*m_Invoke)(void*, std::size_t, int);
+    };
+
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int ThreadCount() const { return static_cast<int>(m_Threads.size()) + 1; }
+
+    // Runs `task` for every index in [0, taskCount) and returns when all of them are finished.
+    void Run(std::size_t taskCount, const Task& task);
+
+private:
+    void WorkerLoop(int workerIndex);
+    void RunTasks(int workerIndex);
+
+    std::vector<std::thread> m_Threads;
+    std::mutex m_Mutex;
+    std::condition_variable m_BatchStarted;
+    std::condition_variable m_BatchFinished;
+
+    const Task* m_Task = nullptr;
+    std::size_t m_TaskCount = 0;
+    std::atomic<std::size_t> m_NextTask = 0;
+    int m_BusyWorkers = 0;
+    std::uint64_t m_Batch = 0;
+    bool m_Stopping = false;
+};
+
+}
@@ -0,0 +1,318 @@
+#include "snaps/WorldFile.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace snaps {
+
+namespace {
+static_assert(sizeof(std::size_t) == 8, "Sections with cell indices are stored as 64-bit values");
+
+constexpr char WORLD_MAGIC[8] = {'S', 'N', 'A', 'P', 'S', 'W', 'L', 'D'};
+constexpr std::size_t SECTION_ALIGNMENT = 64;
+// Materials are the first section, followed by the arrays of the grid.
+constexpr std::size_t GRID_ARRAY_COUNT = 8;
+constexpr std::size_t SECTION_COUNT = 1 + GRID_ARRAY_COUNT + 13;
+
+struct FileHeader {
+    char Magic[8];
+    std::uint32_t Version;
+    std::uint32_t ByteOrder; // std::endian::native of the machine that wrote the file
+    std::int32_t Width;
+    std::int32_t Height;
+    std::uint32_t Layout;
+    std::uint32_t SectionCount;
+    std::uint64_t DirtyChunkCount;
+};
+
+// Followed by the table of sections.
+struct Section {
+    std::uint64_t Offset;
+    std::uint64_t Size;
+};
+
+std::uint64_t AlignUp(const std::uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+/**
+ * Read-only bytes of a whole file, needed only while the sections are copied into the grid. Where mmap
+ * is available the file is mapped rather than read into a buffer first. Elsewhere it's read at once.
+ */
+class FileContents {
+public:
+    explicit FileContents(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        std::ifstream file(path, std::ios::binary);
+        if (not file) return;
+        m_Buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_Bytes = std::as_bytes(std::span(m_Buffer));
+#else
+        const int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+        struct stat status {};
+        if (fstat(descriptor, &status) == 0 and status.st_size > 0) {
+            void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, status.st_size, MADV_SEQUENTIAL);
+                m_Bytes = {static_cast<const std::byte*>(data), static_cast<std::size_t>(status.st_size)};
+            }
+        }
+        close(descriptor);
+#endif
+    }
+
+    ~FileContents() {
+#ifndef _WIN32
+        if (not m_Bytes.empty()) munmap(const_cast<std::byte*>(m_Bytes.data()), m_Bytes.size());
+#endif
+    }
+
+    FileContents(const FileContents&) = delete;
+    FileContents& operator=(const FileContents&) = delete;
+
+    std::span<const std::byte> Bytes() const { return m_Bytes; }
+
+private:
+    std::span<const std::byte> m_Bytes;
+#if defined(_WIN32)
+    std::vector<char> m_Buffer;
+#endif
+};
+} // namespace
+
+// Arrays in the order of their sections. The first GRID_ARRAY_COUNT have a size given by the grid size,
+// the rest belong to the pool of blocks and have one element per slot, except for the free slots.
+template <typename GridType, typename Function>
+void WorldFile::ForEachArray(GridType& grid, Function&& function) {
+    function(grid.m_Slots);
+    function(grid.m_TerrainMaterials);
+    function(grid.m_OccupiedBits);
+    function(grid.m_DynamicBits);
+    function(grid.m_ActiveBits);
+    function(grid.m_TerrainBits);
+    function(grid.m_DirtyRects);
+    function(grid.m_DirtyChunks);
+
+    auto& blocks = grid.m_Blocks;
+    function(blocks.WorldPosition);
+    function(blocks.Velocity);
+    function(blocks.Material);
+    function(blocks.Flags);
+    function(blocks.ForceAccum);
+    function(blocks.Acceleration);
+    function(blocks.RestSteps);
+    function(blocks.PreviousPosition);
+    function(blocks.FixedPosition);
+    function(blocks.FixedVelocity);
+    function(blocks.Cell);
+    function(blocks.Generation);
+    function(blocks.m_FreeSlots);
+}
+
+bool WorldFile::Save(const Grid& grid, const std::filesystem::path& path) {
+    std::vector<Material> materials;
+    for (std::size_t id = 0; id < grid.Materials().Size(); id++) {
+        materials.push_back(grid.Materials()[static_cast<MaterialId>(id)]);
+    }
+
+    std::vector<std::span<const std::byte>> contents = {std::as_bytes(std::span(materials))};
+    ForEachArray(grid, [&contents](const auto& array) {
+        static_assert(std::is_trivially_copyable_v<typename std::remove_cvref_t<decltype(array)>::value_type>);
+        contents.push_back(std::as_bytes(std::span(array)));
+    });
+    assert(contents.size() == SECTION_COUNT);
+
+    FileHeader header {
+        .Magic = {},
+        .Version = VERSION,
+        .ByteOrder = static_cast<std::uint32_t>(std::endian::native),
+        .Width = grid.Width(),
+        .Height = grid.Height(),
+        .Layout = static_cast<std::uint32_t>(grid.Layout()),
+        .SectionCount = SECTION_COUNT,
+        .DirtyChunkCount = grid.m_DirtyChunkCount
+    };
+    std::memcpy(header.Magic, WORLD_MAGIC, sizeof(WORLD_MAGIC));
+
+    std::vector<Section> sections;
+    std::uint64_t offset = sizeof(FileHeader) + SECTION_COUNT * sizeof(Section);
+    for (const auto& content : contents) {
+        offset = AlignUp(offset);
+        sections.push_back({offset, content.size()});
+        offset += content.size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (not file) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(Section)));
+    offset = sizeof(FileHeader) + SECTION_COUNT * sizeof(Section);
+    for (std::size_t i = 0; i < contents.size(); i++) {
+        const char padding[SECTION_ALIGNMENT] = {};
+        file.write(padding, static_cast<std::streamsize>(sections[i].Offset - offset));
+        file.write(reinterpret_cast<const char*>(contents[i].data()), static_cast<std::streamsize>(contents[i].size()));
+        offset = sections[i].Offset + sections[i].Size;
+    }
+    return static_cast<bool>(file);
+}
+
+/**
+ * Checks what the engine relies on and the section sizes don't guarantee: bits of cells agree with each
+ * other, a block and its cell refer to each other, free slots are listed once, ids are in range, flags
+ * are booleans, numbers are finite and each dirty chunk is listed once with a rectangle inside of it.
+ */
+bool WorldFile::IsConsistent(const Grid& grid) {
+    const BlockStorage& blocks = grid.m_Blocks;
+    const std::size_t materialCount = blocks.Materials.Size();
+    const std::size_t cellCount = grid.Size();
+
+    for (std::size_t word = 0; word < grid.m_OccupiedBits.size(); word++) {
+        const std::uint64_t occupied = grid.m_OccupiedBits[word];
+        const std::uint64_t dynamic = grid.m_DynamicBits[word];
+        const std::uint64_t terrain = grid.m_TerrainBits[word];
+        const std::uint64_t active = grid.m_ActiveBits[word];
+        const std::size_t firstCell = word * 64;
+        const std::uint64_t outside = cellCount - firstCell >= 64 ? 0 : ~std::uint64_t{0} << (cellCount - firstCell);
+        if ((dynamic | terrain) & ~occupied or dynamic & terrain or active & ~dynamic or occupied & outside) return false;
+    }
+
+    // Bools are stored as bytes, any other value than 0 or 1 isn't a bool.
+    static_assert(sizeof(BlockFlags) == 3 * sizeof(bool));
+    for (const std::byte byte : std::as_bytes(std::span(blocks.Flags))) {
+        if (byte > std::byte{1}) return false;
+    }
+
+    const auto isFinite = [](const Vector2 vector) { return std::isfinite(vector.x) and std::isfinite(vector.y); };
+    std::size_t liveSlots = 0;
+    for (std::size_t i = grid.FindNextOccupied(0, cellCount); i < cellCount; i = grid.FindNextOccupied(i + 1, cellCount)) {
+        const auto [x, y] = grid.GetXY(i);
+        if (not grid.InBounds(x, y)) return false; // Cells that pad tiled layouts are never occupied
+        if (grid.IsTerrain(i)) {
+            if (grid.m_TerrainMaterials[i] >= materialCount) return false;
+            continue;
+        }
+        const std::uint32_t slot = grid.m_Slots[i];
+        if (slot >= blocks.Size() or blocks.Cell[slot] != i or blocks.Material[slot] >= materialCount) return false;
+        if (not isFinite(blocks.WorldPosition[slot]) or not isFinite(blocks.Velocity[slot])
+            or not isFinite(blocks.ForceAccum[slot]) or not isFinite(blocks.Acceleration[slot])) {
+            return false;
+        }
+        liveSlots++;
+    }
+    // Live slots are distinct, each one is back-referenced by its own cell. The rest are free, once each.
+    std::vector<bool> isFree(blocks.Size(), false);
+    for (const std::uint32_t slot : blocks.m_FreeSlots) {
+        if (slot >= blocks.Size() or blocks.Cell[slot] != BlockStorage::NO_CELL or isFree[slot]) return false;
+        isFree[slot] = true;
+    }
+    if (liveSlots + blocks.m_FreeSlots.size() != blocks.Size()) return false;
+
+    std::vector<bool> isListed(grid.m_DirtyRects.size(), false);
+    for (std::size_t i = 0; i < grid.m_DirtyChunkCount; i++) {
+        const std::size_t chunk = grid.m_DirtyChunks[i];
+        if (chunk >= isListed.size() or isListed[chunk]) return false;
+        isListed[chunk] = true;
+    }
+    for (std::size_t chunk = 0; chunk < grid.m_DirtyRects.size(); chunk++) {
+        const Grid::DirtyRect& rect = grid.m_DirtyRects[chunk];
+        if (not isListed[chunk]) {
+            // Grid::MarkDirty() lists a chunk when it finds its rectangle untouched.
+            const Grid::DirtyRect untouched;
+            if (rect.MinX != untouched.MinX or rect.MinY != untouched.MinY or rect.MaxX != untouched.MaxX or rect.MaxY != untouched.MaxY) return false;
+            continue;
+        }
+        const int minX = static_cast<int>(chunk % grid.m_ChunksX) * Grid::CHUNK_SIZE;
+        const int minY = static_cast<int>(chunk / grid.m_ChunksX) * Grid::CHUNK_SIZE;
+        const int maxX = std::min(minX + Grid::CHUNK_SIZE, grid.Width()) - 1;
+        const int maxY = std::min(minY + Grid::CHUNK_SIZE, grid.Height()) - 1;
+        if (rect.MinX < minX or rect.MinY < minY or rect.MaxX > maxX or rect.MaxY > maxY
+            or rect.MinX > rect.MaxX or rect.MinY > rect.MaxY) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<Grid> WorldFile::Load(const std::filesystem::path& path) {
+    const FileContents file(path);
+    const std::span<const std::byte> bytes = file.Bytes();
+    if (bytes.size() < sizeof(FileHeader) + SECTION_COUNT * sizeof(Section)) return std::nullopt;
+
+    FileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const bool isSupported = std::memcmp(header.Magic, WORLD_MAGIC, sizeof(WORLD_MAGIC)) == 0
+        and header.Version == VERSION
+        and header.ByteOrder == static_cast<std::uint32_t>(std::endian::native)
+        and header.SectionCount == SECTION_COUNT
+        and header.Width > 0 and header.Height > 0
+        and header.Layout <= static_cast<std::uint32_t>(GridLayout::Morton);
+    if (not isSupported) return std::nullopt;
+
+    Section sections[SECTION_COUNT];
+    std::memcpy(sections, bytes.data() + sizeof(FileHeader), sizeof(sections));
+    for (const Section& section : sections) {
+        if (section.Offset > bytes.size() or section.Size > bytes.size() - section.Offset) return std::nullopt;
+    }
+
+    const std::size_t materialCount = sections[0].Size / sizeof(Material);
+    if (materialCount == 0 or materialCount > MaterialTable::CAPACITY or sections[0].Size % sizeof(Material) != 0) return std::nullopt;
+    // Every cell has a slot in the file, so a grid bigger than the file isn't even allocated.
+    if (static_cast<std::uint64_t>(header.Width) * static_cast<std::uint64_t>(header.Height) > sections[1].Size / sizeof(std::uint32_t)) {
+        return std::nullopt;
+    }
+
+    std::optional<Grid> grid(std::in_place, header.Width, header.Height, static_cast<GridLayout>(header.Layout));
+    for (std::size_t id = 0; id < materialCount; id++) {
+        Material material;
+        std::memcpy(&material, bytes.data() + sections[0].Offset + id * sizeof(Material), sizeof(Material));
+        if (id == 0) grid->Materials()[MaterialTable::DEFAULT] = material;
+        else grid->Materials().Add(material);
+    }
+
+    // The grid already has arrays of the right size. Free slots are reused before the pool grows, so
+    // it never has more slots than the grid has cells.
+    const std::size_t maxPoolSize = grid->Size();
+    std::size_t index = 1;
+    bool isValid = true;
+    ForEachArray(*grid, [&](auto& array) {
+        using Element = typename std::remove_cvref_t<decltype(array)>::value_type;
+        const Section& section = sections[index];
+        const std::size_t count = section.Size / sizeof(Element);
+        const bool isGridArray = index <= GRID_ARRAY_COUNT;
+        index++;
+        if (section.Size % sizeof(Element) != 0 or (isGridArray ? count != array.size() : count > maxPoolSize)) {
+            isValid = false;
+            return;
+        }
+        array.resize(count);
+        if (count > 0) std::memcpy(array.data(), bytes.data() + section.Offset, section.Size);
+    });
+
+    BlockStorage& blocks = grid->m_Blocks;
+    blocks.ForEachArray([&](const auto& array) { isValid = isValid and array.size() == blocks.Size(); });
+    isValid = isValid and blocks.m_FreeSlots.size() <= blocks.Size();
+    if (not isValid or header.DirtyChunkCount > grid->m_DirtyChunks.size()) return std::nullopt;
+    grid->m_DirtyChunkCount = header.DirtyChunkCount;
+    if (not IsConsistent(*grid)) return std::nullopt;
+    grid->ComputeNeighbours(0, 0, grid->Width() - 1, grid->Height() - 1);
+    std::ranges::fill(grid->m_ChangedChunks, Grid::CHANGED); // Loaded chunks are not in any snapshot yet
+    return grid;
+}
+
+}
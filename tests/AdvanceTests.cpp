@@ -0,0 +1,63 @@
+#include "fixtures/SceneTest.hpp"
+#include <gtest/gtest.h>
+
+struct AdvanceTest : SceneTest {
+    static constexpr float TIME_STEP = 1.0f / 64.0f; // Exact in binary, so that time adds up without rounding.
+
+    void SetUp() override {
+        InitializeTestScene(5, 10);
+        m_Engine->GetConfig().FixedTimeStep = TIME_STEP;
+    }
+};
+
+TEST_F(AdvanceTest, CarriesOverTimeUntilWholeStep) {
+    EXPECT_EQ(m_Engine->Advance(TIME_STEP / 2), 0);
+    EXPECT_FLOAT_EQ(m_Engine->GetInterpolationAlpha(), 0.5f);
+
+    EXPECT_EQ(m_Engine->Advance(TIME_STEP * 3 / 4), 1);
+    EXPECT_FLOAT_EQ(m_Engine->GetInterpolationAlpha(), 0.25f);
+}
+
+TEST_F(AdvanceTest, NumberOfStepsIsCapped) {
+    m_Engine->GetConfig().MaxSubsteps = 4;
+    EXPECT_EQ(m_Engine->Advance(TIME_STEP * 10.5f), 4);
+    EXPECT_FLOAT_EQ(m_Engine->GetInterpolationAlpha(), 0.5f);
+
+    EXPECT_EQ(m_Engine->Advance(TIME_STEP / 2), 1);
+}
+
+TEST_F(AdvanceTest, SameResultAsFixedSteps) {
+    AddSand(2, 1);
+    m_Engine->GetConfig().MaxSubsteps = 20;
+    EXPECT_EQ(m_Engine->Advance(TIME_STEP * 20), 20);
+    const snaps::Grid advanced = *m_Grid;
+
+    SetUp();
+    AddSand(2, 1);
+    m_Scene->SetDeltaTime(TIME_STEP);
+    m_Scene->TickN(20);
+
+    for (int y = 0; y < m_Grid->Height(); y++) {
+        const auto expected = std::as_const(*m_Grid).At(2, y);
+        const auto actual = advanced.At(2, y);
+        ASSERT_EQ(expected.has_value(), actual.has_value()) << "at y = " << y;
+        if (not expected) continue;
+        EXPECT_EQ(expected->WorldPosition.y, actual->WorldPosition.y) << "at y = " << y;
+        EXPECT_EQ(expected->Velocity.y, actual->Velocity.y) << "at y = " << y;
+    }
+}
+
+TEST_F(AdvanceTest, PreviousPositionIsKeptForInterpolation) {
+    AddSand(2, 1);
+    const std::uint32_t slot = m_Grid->GetSlot(m_Grid->GetIndex(2, 1));
+    EXPECT_EQ(m_Grid->Blocks().PreviousPosition[slot].y, snaps::BLOCK_SIZE);
+
+    m_Engine->Advance(TIME_STEP);
+    const std::size_t movedIndex = m_Grid->GetIndex(2, 2);
+    ASSERT_TRUE(m_Grid->IsOccupied(movedIndex));
+    const std::uint32_t movedSlot = m_Grid->GetSlot(movedIndex);
+    const Vector2 previous = m_Grid->Blocks().PreviousPosition[movedSlot];
+    const Vector2 current = m_Grid->Blocks().WorldPosition[movedSlot];
+    EXPECT_EQ(previous.y, snaps::BLOCK_SIZE);
+    EXPECT_GT(current.y, previous.y);
+}
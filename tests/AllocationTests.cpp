@@ -0,0 +1,80 @@
+#include "fixtures/SceneTest.hpp"
+#include "utils/AllocationCounter.hpp"
+#include <gtest/gtest.h>
+
+struct AllocationTest : SceneTest {
+    // A box of walls with its top left corner in the corner of the grid, filled with sand `spacing` cells apart.
+    // Sand in the top row is thrown sideways and down fast, so it crosses several cells per step.
+    void BuildScene(const int width, const int height, const int spacing) const {
+        m_Grid->Clear();
+        for (int x = 0; x < width; x++) {
+            AddWall(x, 0);
+            AddWall(x, height - 1);
+        }
+        for (int y = 1; y < height - 1; y++) {
+            AddWall(0, y);
+            AddWall(width - 1, y);
+        }
+        for (int y = 1; y < height - 1; y += spacing) {
+            for (int x = 1 + y % 3 % spacing; x < width - 1; x += spacing) {
+                AddSand(x, y);
+                if (y == 1) GetBlock(x, y).Velocity = {x % 4 < 2 ? 2000.0f : -2000.0f, 3000.0f};
+            }
+        }
+    }
+
+    // The warm-up runs with more blocks than the measured steps, but all of them in the first column of chunks.
+    // The measured steps spread the blocks over the whole grid, into chunks that the warm-up never visited.
+    std::size_t CountAllocationsInSteps(const int steps) const {
+        const float deltaTime = m_Scene->GetDeltaTime();
+        BuildScene(snaps::Grid::CHUNK_SIZE, m_Grid->Height(), 1);
+        for (int i = 0; i < steps; i++) m_Engine->Step(deltaTime);
+        BuildScene(m_Grid->Width(), m_Grid->Height(), 2);
+
+        const std::size_t allocationsBefore = GetAllocationCount();
+        for (int i = 0; i < steps; i++) m_Engine->Step(deltaTime);
+        return GetAllocationCount() - allocationsBefore;
+    }
+
+    void UseParallelStep() const {
+        m_Engine->GetConfig().ParallelStep = true;
+        m_Engine->GetConfig().ThreadCount = 4;
+    }
+};
+
+TEST_F(AllocationTest, StepDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
+
+TEST_F(AllocationTest, ParallelStepDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    UseParallelStep();
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
+
+TEST_F(AllocationTest, TwoPhaseResolutionDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    m_Engine->GetConfig().TwoPhaseResolution = true;
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
+
+TEST_F(AllocationTest, ConcurrentClaimingDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    UseParallelStep();
+    m_Engine->GetConfig().ConcurrentClaiming = true;
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
+
+TEST_F(AllocationTest, DeterministicParallelStepDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    UseParallelStep();
+    m_Engine->GetConfig().Deterministic = true;
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
+
+TEST_F(AllocationTest, FixedPointStepDoesNotAllocate) {
+    InitializeTestScene(150, 100);
+    m_Engine->GetConfig().FixedPoint = true;
+    EXPECT_EQ(CountAllocationsInSteps(60), 0);
+}
@@ -1,6 +1,7 @@
 #include "fixtures/SceneTest.hpp"
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <string>
 
 using namespace testing;
 
@@ -178,7 +179,7 @@ TEST_F(BasicSceneTest, ContinuousCollisionDetectionToTheRight) {
 
     AddWall(6, 1);
     AddSand(1, 1);
-    GetBlock(1, 1).Friction = 0.0f;
+    SetFriction(1, 1, 0.0f);
     GetBlock(1, 1).Velocity.x = maxSpeed * 3.5f;
     m_Scene->Tick();
     // EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(5, 1));
@@ -188,30 +189,57 @@ TEST_F(BasicSceneTest, ContinuousCollisionDetectionToTheRight) {
     // EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(5, 1));
 }
 
-TEST_F(BasicSceneTest, MaxVelocityClamp) {
+TEST_F(BasicSceneTest, FastBlockCrossesSeveralCellsInOneStep) {
     InitializeTestScene(10, 3);
-    const float maxSpeed = snaps::BLOCK_SIZE / m_Scene->GetDeltaTime();
+    const float cellsPerStep = snaps::BLOCK_SIZE / m_Scene->GetDeltaTime();
 
     AddWall(6, 1);
     AddSand(1, 1);
-    GetBlock(1, 1).Friction = 0.0f;
-    GetBlock(1, 1).Velocity.x = maxSpeed * 3.5f;
+    SetFriction(1, 1, 0.0f);
+    GetBlock(1, 1).Velocity.x = cellsPerStep * 3.5f;
 
     m_Scene->Tick();
-    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(2, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(1, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(4, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(5, 1));
 
     m_Scene->Tick();
-    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(3, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(5, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(5, 1));
+}
+
+TEST_F(BasicSceneTest, FastBlockStopsAtFirstOccupiedCell) {
+    InitializeTestScene(12, 3);
+    const float cellsPerStep = snaps::BLOCK_SIZE / m_Scene->GetDeltaTime();
+
+    AddWall(3, 1);
+    AddSand(1, 1);
+    GetBlock(1, 1).Velocity.x = cellsPerStep * 6.0f;
 
     m_Scene->Tick();
-    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(4, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(2, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsStaticAt(3, 1));
+    for (int x = 4; x < 11; x++) {
+        EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(x, 1));
+    }
+}
+
+TEST_F(BasicSceneTest, FastFallStopsOnThinFloor) {
+    InitializeTestScene(3, 20);
+    const float cellsPerStep = snaps::BLOCK_SIZE / m_Scene->GetDeltaTime();
+
+    AddWall(1, 10);
+    AddSand(1, 1);
+    GetBlock(1, 1).Velocity.y = cellsPerStep * 6.0f;
 
     m_Scene->Tick();
-    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(5, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsMovingDownAt(1, 8));
 
     m_Scene->Tick();
-    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(5, 1));
-    EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(5, 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(1, 9));
+    EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(1, 9));
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(1, 11));
 }
 
 struct SmoothSliding : SceneTest {};
@@ -395,7 +423,7 @@ TEST_F(SmoothSliding, BlockSlowlySlidesRightOverTheEdgeWhileOtherBlockSlidesUnde
     GetBlock(1, 1).Velocity.x = +10.0f;
     AddSand(8, 3);
     GetBlock(8, 3).Velocity.x = -200.0f;
-    GetBlock(8, 3).Friction = 0.01f;
+    SetFriction(8, 3, 0.01f);
 
     m_Scene->TickTime(2.0f);
     EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(2, 2));
@@ -470,7 +498,7 @@ TEST_F(ImpulseTest, ImpulseAngular) {
     InitializeTestScene(5, 5);
     AddSand(1, 3);
 
-    auto& block = GetBlock(1, 3);
+    auto block = GetBlock(1, 3);
     snaps::ApplyImpulse(block, {50.0f, -m_Engine->GetConfig().Gravity});
 
     m_Scene->Tick(); // the block moves up and right
@@ -499,7 +527,7 @@ struct SlideTest : SceneTest {};
 TEST_F(SlideTest, SlideAndStopDueToFriction) {
     InitializeTestScene(10, 5);
     AddSand(2, 3);
-    GetBlock(2, 3).Friction = 2.0f;
+    SetFriction(2, 3, 2.0f);
     snaps::ApplyImpulse(GetBlock(2, 3), {500.0f, 0.0f});
 
     EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 3));
@@ -514,7 +542,7 @@ TEST_F(SlideTest, SlideAndStopDueToHitWithSolidWall) {
     InitializeTestScene(10, 5);
     AddSand(2, 3);
     AddWall(5, 3);
-    GetBlock(2, 3).Friction = 0.5f;
+    SetFriction(2, 3, 0.5f);
     GetBlock(2, 3).Velocity.x = 500.0f;
 
     EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 3));
@@ -529,7 +557,7 @@ TEST_F(SlideTest, SlideAndStopDueToHitWithDynamicWall) {
     InitializeTestScene(10, 5);
     AddSand(2, 3);
     AddSand(5, 3);
-    GetBlock(2, 3).Friction = 0.5f;
+    SetFriction(2, 3, 0.5f);
     GetBlock(2, 3).Velocity.x = 500.0f;
 
     EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 3));
@@ -547,9 +575,9 @@ TEST_F(SlideTest, SlideRightThreeBlocksNextToEachOther) {
     AddSand(2, 3);
     AddSand(3, 3);
     AddSand(4, 3);
-    GetBlock(2, 3).Friction = 1.0f;
-    GetBlock(3, 3).Friction = 1.0f;
-    GetBlock(4, 3).Friction = 1.0f;
+    SetFriction(2, 3, 1.0f);
+    SetFriction(3, 3, 1.0f);
+    SetFriction(4, 3, 1.0f);
     snaps::ApplyImpulse(GetBlock(2, 3), {400.0f, 0.0f});
     snaps::ApplyImpulse(GetBlock(3, 3), {400.0f, 0.0f});
     snaps::ApplyImpulse(GetBlock(4, 3), {400.0f, 0.0f});
@@ -573,9 +601,9 @@ TEST_F(SlideTest, SlideLeftThreeBlocksNextToEachOther) {
     AddSand(7, 3);
     AddSand(6, 3);
     AddSand(5, 3);
-    GetBlock(7, 3).Friction = 1.0f;
-    GetBlock(6, 3).Friction = 1.0f;
-    GetBlock(5, 3).Friction = 1.0f;
+    SetFriction(7, 3, 1.0f);
+    SetFriction(6, 3, 1.0f);
+    SetFriction(5, 3, 1.0f);
     snaps::ApplyImpulse(GetBlock(7, 3), {-400.0f, 0.0f});
     snaps::ApplyImpulse(GetBlock(6, 3), {-400.0f, 0.0f});
     snaps::ApplyImpulse(GetBlock(5, 3), {-400.0f, 0.0f});
@@ -925,14 +953,14 @@ struct FrictionTest : SceneTest {};
 TEST_F(FrictionTest, GreaterMassGivesStrongerFriction) {
     InitializeTestScene(10, 4);
     AddSand(1, 2);
-    GetBlock(1, 2).InvMass = 1 / 1.0f;
+    SetInvMass(1, 2, 1 / 1.0f);
     GetBlock(1, 2).Velocity.x = 250.0f;
 
     m_Scene->TickTime(1.0f);
     ASSERT_SCENE(m_Scene, check::BlockIsAlignedAt(8, 2)); // goes to the end
 
     AddSand(1, 2);
-    GetBlock(1, 2).InvMass = 1 / 2.0f; // 2 times greater mass
+    SetInvMass(1, 2, 1 / 2.0f); // 2 times greater mass
     GetBlock(1, 2).Velocity.x = 250.0f;
 
     m_Scene->TickTime(1.0f);
@@ -942,10 +970,10 @@ TEST_F(FrictionTest, GreaterMassGivesStrongerFriction) {
 TEST_F(FrictionTest, SlideWhenBottomBlockHasNoFriction) {
     InitializeTestScene(10, 4);
     for (int x = 0; x < 10; x++) {
-        GetBlock(x, 3).Friction = 0.0f; // no friction on bottom blocks
+        SetFriction(x, 3, 0.0f); // no friction on bottom blocks
     }
     AddSand(1, 2);
-    GetBlock(1, 2).Friction = 0.5f;
+    SetFriction(1, 2, 0.5f);
     GetBlock(1, 2).Velocity.x = 100.0f;
 
     m_Scene->TickTime(1.2f);
@@ -955,10 +983,10 @@ TEST_F(FrictionTest, SlideWhenBottomBlockHasNoFriction) {
 TEST_F(FrictionTest, SlideWhenUpperBlockHasNoFriction) {
     InitializeTestScene(10, 4);
     for (int x = 0; x < 10; x++) {
-        GetBlock(x, 3).Friction = 0.5f;
+        SetFriction(x, 3, 0.5f);
     }
     AddSand(1, 2);
-    GetBlock(1, 2).Friction = 0.0f;
+    SetFriction(1, 2, 0.0f);
     GetBlock(1, 2).Velocity.x = 100.0f;
 
     m_Scene->TickTime(1.2f);
@@ -968,12 +996,12 @@ TEST_F(FrictionTest, SlideWhenUpperBlockHasNoFriction) {
 TEST_F(FrictionTest, NoFrictionWhenTwoBlocksAreSlidingOnEachOther) {
     InitializeTestScene(10, 5);
     for (int x = 0; x < 10; x++) {
-        GetBlock(x, 4).Friction = 0.0f; // no friction on bottom blocks
+        SetFriction(x, 4, 0.0f); // no friction on bottom blocks
     }
     AddSand(1, 2);
     AddSand(1, 3);
-    GetBlock(1, 2).Friction = 0.5f;
-    GetBlock(1, 3).Friction = 0.5f;
+    SetFriction(1, 2, 0.5f);
+    SetFriction(1, 3, 0.5f);
     GetBlock(1, 2).Velocity.x = 100.0f;
     GetBlock(1, 3).Velocity.x = 100.0f;
 
@@ -985,9 +1013,7 @@ TEST_F(FrictionTest, NoFrictionWhenTwoBlocksAreSlidingOnEachOther) {
 struct BoundaryTest : SceneTest {
     BoundaryTest() {
         InitializeTestScene(5, 5);
-        for (auto& block: m_Grid->Data()) {
-            block.reset();
-        }
+        m_Grid->Clear();
     }
 };
 
@@ -1035,3 +1061,49 @@ TEST_F(BoundaryTest, BlockStopsAtBottomBoundary) {
     EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(4, 4));
     EXPECT_SCENE(m_Scene, check::BlockIsNotMovingAt(4, 4));
 }
+
+struct DragTest : SceneTest {};
+
+TEST_F(DragTest, BlocksInRowSlowDownEqually) {
+    // Wide enough row to be processed both in SIMD lanes and one by one at the edges.
+    InitializeTestScene(20, 10);
+    m_Engine->GetConfig().Gravity = 0.0f;
+    m_Engine->GetConfig().Drag = 0.5f;
+    for (int x = 1; x < 19; x++) {
+        AddSand(x, 7);
+        GetBlock(x, 7).Velocity = {0.0f, -100.0f};
+    }
+
+    m_Scene->TickN(3);
+    const float velocity = GetBlock(1, 6).Velocity.y;
+    EXPECT_GT(velocity, -100.0f);
+    EXPECT_LT(velocity, 0.0f);
+    for (int x = 1; x < 19; x++) {
+        EXPECT_SCENE(m_Scene, check::BlockVelocityAt(x, 6, {0.0f, velocity}));
+    }
+}
+
+TEST_F(DragTest, DragThatWouldReverseBlocksStopsThemAndIsReported) {
+    for (const bool fixedPoint : {false, true}) {
+        InitializeTestScene(20, 10);
+        m_Engine->GetConfig().Gravity = 0.0f;
+        m_Engine->GetConfig().Drag = 1000.0f;
+        m_Engine->GetConfig().FixedPoint = fixedPoint;
+        for (int x = 1; x < 19; x++) {
+            AddSand(x, 7);
+            GetBlock(x, 7).Velocity = {100.0f, 0.0f};
+        }
+
+        internal::CaptureStdout();
+        m_Scene->TickN(1);
+        const std::string output = internal::GetCapturedStdout();
+        std::size_t events = 0;
+        for (std::size_t at = output.find("drag stopped the object"); at != std::string::npos; at = output.find("drag stopped the object", at + 1)) {
+            events++;
+        }
+        EXPECT_EQ(events, 18) << "fixed point " << fixedPoint;
+        for (int x = 1; x < 19; x++) {
+            EXPECT_EQ(GetBlock(x, 7).Velocity.x, 0.0f) << "fixed point " << fixedPoint << ", at " << x;
+        }
+    }
+}
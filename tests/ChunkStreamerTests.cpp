@@ -0,0 +1,153 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/ChunkStreamer.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+struct ChunkStreamerTest : ::testing::Test {
+    void SetUp() override {
+        std::filesystem::remove_all(m_Directory);
+    }
+    void TearDown() override {
+        std::filesystem::remove_all(m_Directory);
+    }
+
+    const std::filesystem::path m_Directory = std::filesystem::temp_directory_path() / "SnapsChunkStreamerTest";
+};
+}
+
+TEST_F(ChunkStreamerTest, UnloadedChunksComeBackFromDisk) {
+    snaps::SparseGrid grid;
+    const snaps::MaterialId stone = grid.Materials().Add({.Friction = 0.5f});
+    grid.At(500, -500) = snaps::Block { .WorldPosition = {8000.0f, -8000.0f}, .Material = stone };
+    grid.At(501, -500) = snaps::Block { .WorldPosition = {8016.0f, -7990.0f}, .Velocity = {1.0f, 2.0f}, .IsDynamic = true };
+    grid.At(3, 3) = BlockAt(3, 3, false);
+
+    snaps::ChunkStreamer streamer(grid, m_Directory);
+    const snaps::ChunkStreamer::Area origin[] = {{0, 0, 1}};
+    streamer.Update(origin);
+    streamer.Flush();
+    EXPECT_FALSE(grid.InBounds(500, -500));
+    EXPECT_FALSE(grid.IsOccupied(500, -500));
+    EXPECT_TRUE(grid.IsOccupied(3, 3));
+    EXPECT_EQ(streamer.ResidentChunkCount(), 9);
+    EXPECT_EQ(grid.ChunkCount(), 9);
+    EXPECT_EQ(grid.BlockCount(), 0);
+
+    const snaps::ChunkStreamer::Area far[] = {{500, -500, 0}};
+    streamer.Update(far);
+    streamer.Flush();
+    EXPECT_EQ(grid.ChunkCount(), 1);
+    ASSERT_TRUE(grid.IsOccupied(500, -500));
+    ASSERT_TRUE(grid.IsOccupied(501, -500));
+    EXPECT_TRUE(grid.IsTerrain(grid.GetIndex(500, -500)));
+    EXPECT_EQ(&grid.GetMaterial(500, -500), &grid.Materials()[stone]);
+    const snaps::Block dynamic = *std::as_const(grid).At(501, -500);
+    EXPECT_TRUE(dynamic.IsDynamic);
+    EXPECT_EQ(dynamic.WorldPosition.y, -7990.0f);
+    EXPECT_EQ(dynamic.Velocity.y, 2.0f);
+
+    // Back at the origin, the chunk of (3, 3) has been saved in the meantime.
+    streamer.Update(origin);
+    streamer.Flush();
+    EXPECT_TRUE(grid.IsOccupied(3, 3));
+    EXPECT_FALSE(grid.IsOccupied(501, -500));
+}
+
+TEST_F(ChunkStreamerTest, BlocksWaitAtBorderOfResidentChunks) {
+    snaps::SparseGrid grid;
+    snaps::SparseSnapsEngine engine(grid);
+    snaps::ChunkStreamer streamer(grid, m_Directory);
+    const snaps::ChunkStreamer::Area top[] = {{0, 0, 0}};
+    streamer.Update(top);
+    streamer.Flush();
+
+    grid.At(5, 10) = BlockAt(5, 10, true);
+    ASSERT_TRUE(engine.StepUntilSettled(1000, DELTA_TIME).IsAtRest);
+    ASSERT_TRUE(grid.IsOccupied(5, 63));
+    EXPECT_EQ(grid.GetWorldPosition(5, 63).y, 63.0f * snaps::BLOCK_SIZE);
+
+    const snaps::ChunkStreamer::Area topAndBelow[] = {{0, 0, 0}, {0, 64, 0}};
+    streamer.Update(topAndBelow);
+    streamer.Flush();
+    ASSERT_TRUE(engine.StepUntilSettled(1000, DELTA_TIME).IsAtRest);
+    ASSERT_TRUE(grid.IsOccupied(5, 127));
+    EXPECT_EQ(grid.GetWorldPosition(5, 127).y, 127.0f * snaps::BLOCK_SIZE);
+}
+
+TEST_F(ChunkStreamerTest, FailedWriteKeepsChunkInMemory) {
+    snaps::SparseGrid grid;
+    grid.At(3, 3) = BlockAt(3, 3, true);
+    snaps::ChunkStreamer streamer(grid, m_Directory);
+    // A directory in place of the file of chunk (0, 0) fails every write of it.
+    std::filesystem::create_directories(m_Directory / "0_0.chunk" / "blocker");
+
+    const snaps::ChunkStreamer::Area origin[] = {{0, 0, 0}};
+    const snaps::ChunkStreamer::Area far[] = {{1000, 1000, 0}};
+    EXPECT_TRUE(streamer.Update(far));
+    EXPECT_FALSE(streamer.Flush());
+    EXPECT_FALSE(grid.InBounds(3, 3));
+    EXPECT_EQ(streamer.UnsavedChunkCount(), 1);
+
+    // The write is retried by the next update and fails again. The chunk comes back from memory.
+    EXPECT_TRUE(streamer.Update(far));
+    EXPECT_FALSE(streamer.Flush());
+    EXPECT_TRUE(streamer.Update(origin));
+    EXPECT_TRUE(grid.IsOccupied(3, 3));
+    EXPECT_TRUE(streamer.Flush());
+    EXPECT_EQ(streamer.UnsavedChunkCount(), 0);
+
+    std::filesystem::remove_all(m_Directory / "0_0.chunk");
+    streamer.Update(far);
+    EXPECT_TRUE(streamer.Flush());
+    EXPECT_EQ(streamer.UnsavedChunkCount(), 0);
+    streamer.Update(origin);
+    EXPECT_TRUE(streamer.Flush());
+    EXPECT_TRUE(grid.IsOccupied(3, 3));
+}
+
+TEST_F(ChunkStreamerTest, CorruptFilesAreRejected) {
+    const std::filesystem::path file = m_Directory / "0_0.chunk";
+    const auto corrupt = [&](const std::function<void(std::string&)>& change) {
+        snaps::SparseGrid grid;
+        grid.At(3, 3) = BlockAt(3, 3, true);
+        grid.At(4, 3) = BlockAt(4, 3, false);
+        snaps::ChunkStreamer streamer(grid, m_Directory);
+        const snaps::ChunkStreamer::Area origin[] = {{0, 0, 0}};
+        const snaps::ChunkStreamer::Area far[] = {{1000, 1000, 0}};
+        streamer.Update(far);
+        EXPECT_TRUE(streamer.Flush());
+
+        std::string bytes;
+        {
+            std::ifstream input(file, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+        change(bytes);
+        std::ofstream(file, std::ios::binary | std::ios::trunc) << bytes;
+
+        streamer.Update(origin);
+        EXPECT_FALSE(streamer.Flush());
+        EXPECT_FALSE(grid.InBounds(3, 3));
+        EXPECT_EQ(grid.BlockCount(), 0);
+        // The file is left alone, the chunk isn't requested again.
+        EXPECT_TRUE(streamer.Update(origin));
+        EXPECT_TRUE(streamer.Flush());
+        EXPECT_TRUE(std::filesystem::exists(file));
+    };
+    // The header is 12 bytes, each record starts with a 16-bit cell and an 8-bit material.
+    corrupt([](std::string& bytes) { bytes.resize(bytes.size() - 5); });
+    corrupt([](std::string& bytes) { bytes.resize(8); });
+    corrupt([](std::string& bytes) { bytes[0] = 'X'; });
+    corrupt([](std::string& bytes) { bytes[8] = 100; });
+    corrupt([](std::string& bytes) { bytes[12] = 0; bytes[13] = 0x40; });
+    corrupt([](std::string& bytes) { bytes[14] = 7; });
+}
@@ -0,0 +1,120 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+constexpr int SIZE = 4 * snaps::Grid::CHUNK_SIZE;
+
+// Floor and walls around blocks flying in random directions, dense enough that workers of neighbouring
+// chunks keep fighting over the cells along chunk borders.
+snaps::Grid MakeCrowdedGrid(const unsigned seed, std::vector<snaps::BlockId>& ids) {
+    snaps::Grid grid(SIZE, SIZE);
+    ids = AddRandomBlocks(grid, {
+        .Seed = seed,
+        .Border = RandomBlocks::Edges::Walls,
+        .DynamicPercent = 45,
+        .MaxCellsPerStep = {8.0f, 8.0f},
+        .DeltaTime = DELTA_TIME
+    });
+    return grid;
+}
+
+// Every block is in exactly one cell, every dynamic cell holds a block of its own, and blocks overlap their cells.
+void ExpectNoBlockLostOrDuplicated(const snaps::Grid& grid, const std::vector<snaps::BlockId>& ids, const int step) {
+    ASSERT_EQ(grid.Blocks().Count(), ids.size()) << "step " << step;
+    std::vector<std::size_t> cells;
+    for (const snaps::BlockId id : ids) {
+        const std::optional<std::size_t> cell = grid.Find(id);
+        ASSERT_TRUE(cell.has_value()) << "step " << step;
+        ASSERT_TRUE(grid.IsDynamic(*cell)) << "step " << step;
+        cells.push_back(*cell);
+    }
+    std::ranges::sort(cells);
+    ASSERT_EQ(std::ranges::adjacent_find(cells), cells.end()) << "step " << step;
+
+    std::size_t dynamicCells = 0;
+    for (std::size_t i = grid.FindNextDynamic(0, grid.Size()); i < grid.Size(); i = grid.FindNextDynamic(i + 1, grid.Size())) {
+        dynamicCells++;
+        const auto [x, y] = grid.GetXY(i);
+        const Vector2 position = grid.GetWorldPosition(i);
+        ASSERT_LE(std::abs(position.x - static_cast<float>(x * snaps::BLOCK_SIZE)), snaps::BLOCK_SIZE) << "step " << step;
+        ASSERT_LE(std::abs(position.y - static_cast<float>(y * snaps::BLOCK_SIZE)), snaps::BLOCK_SIZE) << "step " << step;
+    }
+    ASSERT_EQ(dynamicCells, ids.size()) << "step " << step;
+}
+}
+
+TEST(ConcurrentClaimingTest, NoBlockIsLostOrDuplicatedUnderContention) {
+    for (const unsigned seed : {1u, 2u, 3u}) {
+        std::vector<snaps::BlockId> ids;
+        snaps::Grid grid = MakeCrowdedGrid(seed, ids);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().ParallelStep = true;
+        engine.GetConfig().ConcurrentClaiming = true;
+        engine.GetConfig().ThreadCount = 8;
+        for (int step = 0; step < 40; step++) {
+            engine.Step(DELTA_TIME);
+            ExpectNoBlockLostOrDuplicated(grid, ids, step);
+            if (HasFatalFailure()) return;
+        }
+    }
+}
+
+TEST(ConcurrentClaimingTest, MoreThreadsThanClaimsCanHoldAreCapped) {
+    std::vector<snaps::BlockId> ids;
+    snaps::Grid grid = MakeCrowdedGrid(5, ids);
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().ParallelStep = true;
+    engine.GetConfig().ConcurrentClaiming = true;
+    engine.GetConfig().ThreadCount = 300;
+    for (int step = 0; step < 10; step++) {
+        engine.Step(DELTA_TIME);
+        ExpectNoBlockLostOrDuplicated(grid, ids, step);
+        if (HasFatalFailure()) return;
+    }
+}
+
+TEST(ConcurrentClaimingTest, ClaimsExpireBetweenSteps) {
+    // A column falling through a chunk border is claimed by a different worker every step.
+    snaps::Grid grid(3, 3 * snaps::Grid::CHUNK_SIZE);
+    for (int x = 0; x < grid.Width(); x++) {
+        grid.At(x, grid.Height() - 1) = snaps::Block { .WorldPosition = {static_cast<float>(x * snaps::BLOCK_SIZE), static_cast<float>((grid.Height() - 1) * snaps::BLOCK_SIZE)} };
+    }
+    const int top = snaps::Grid::CHUNK_SIZE - 5;
+    for (int y = top; y < top + 10; y++) {
+        grid.At(1, y) = snaps::Block { .WorldPosition = {snaps::BLOCK_SIZE, static_cast<float>(y * snaps::BLOCK_SIZE)}, .IsDynamic = true };
+    }
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().ParallelStep = true;
+    engine.GetConfig().ConcurrentClaiming = true;
+    engine.GetConfig().ThreadCount = 4;
+
+    EXPECT_TRUE(engine.StepUntilSettled(2000, DELTA_TIME).IsAtRest);
+    for (int y = grid.Height() - 11; y < grid.Height() - 1; y++) {
+        ASSERT_TRUE(grid.IsOccupied(1, y)) << "at " << y;
+        EXPECT_EQ(grid.GetWorldPosition(grid.GetIndex(1, y)).y, static_cast<float>(y * snaps::BLOCK_SIZE));
+    }
+}
+
+TEST(ConcurrentClaimingTest, IgnoredWhenDeterministic) {
+    std::vector<std::vector<std::uint64_t>> runs;
+    for (const bool concurrentClaiming : {false, true}) {
+        std::vector<snaps::BlockId> ids;
+        snaps::Grid grid = MakeCrowdedGrid(4, ids);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().ParallelStep = true;
+        engine.GetConfig().Deterministic = true;
+        engine.GetConfig().ConcurrentClaiming = concurrentClaiming;
+        engine.GetConfig().ThreadCount = 4;
+        std::vector<std::uint64_t>& hashes = runs.emplace_back();
+        for (int step = 0; step < 20; step++) {
+            engine.Step(DELTA_TIME);
+            hashes.push_back(engine.GetStateHash());
+        }
+    }
+    EXPECT_EQ(runs[1], runs[0]);
+}
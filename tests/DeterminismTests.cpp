@@ -0,0 +1,88 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include "snaps/StateHash.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+constexpr int STEPS = 60;
+
+snaps::Grid MakeSandBox(const snaps::GridLayout layout = snaps::GridLayout::RowMajor) {
+    snaps::Grid grid(200, 140, layout);
+    const snaps::MaterialId ice = grid.Materials().Add({.Friction = 0.1f});
+    AddRandomBlocks(grid, {
+        .Seed = 11,
+        .Border = RandomBlocks::Edges::Floor,
+        .StaticPercent = 3,
+        .DynamicPercent = 32,
+        .MaxCellsPerStep = {0.125f, 0.0f},
+        .StaticMaterial = ice
+    });
+    return grid;
+}
+
+// Hashes of the state after each step.
+std::vector<std::uint64_t> RunDeterministic(const bool parallelStep, const int threadCount) {
+    snaps::Grid grid = MakeSandBox();
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().Deterministic = true;
+    engine.GetConfig().ParallelStep = parallelStep;
+    engine.GetConfig().ThreadCount = threadCount;
+    std::vector<std::uint64_t> hashes;
+    for (int step = 0; step < STEPS; step++) {
+        engine.Step(DELTA_TIME);
+        hashes.push_back(engine.GetStateHash());
+    }
+    return hashes;
+}
+}
+
+TEST(DeterminismTest, ResultDoesNotDependOnThreading) {
+    const std::vector<std::uint64_t> serial = RunDeterministic(false, 1);
+    for (const int threadCount : {1, 2, 3, 8}) {
+        EXPECT_EQ(RunDeterministic(true, threadCount), serial) << threadCount << " threads";
+    }
+    EXPECT_EQ(RunDeterministic(false, 1), serial);
+}
+
+TEST(DeterminismTest, HashDetectsDivergenceInTheSameStep) {
+    snaps::Grid grid = MakeSandBox();
+    snaps::Grid other = grid;
+    snaps::SnapsEngine engine(grid);
+    snaps::SnapsEngine otherEngine(other);
+    for (int step = 0; step < 10; step++) {
+        engine.Step(DELTA_TIME);
+        otherEngine.Step(DELTA_TIME);
+        ASSERT_EQ(engine.GetStateHash(), otherEngine.GetStateHash()) << "step " << step;
+    }
+
+    // The smallest possible difference, one bit of a velocity.
+    const std::size_t index = grid.FindNextDynamic(0, grid.Size());
+    const float velocity = grid.At(index)->Velocity.y;
+    grid.At(index)->Velocity.y = velocity;
+    other.At(index)->Velocity.y = std::nextafter(velocity, INFINITY);
+    EXPECT_NE(engine.GetStateHash(), otherEngine.GetStateHash());
+}
+
+TEST(DeterminismTest, IncrementalHashMatchesFullHash) {
+    for (const snaps::GridLayout layout : {snaps::GridLayout::RowMajor, snaps::GridLayout::Tiled}) {
+        snaps::Grid grid = MakeSandBox(layout);
+        snaps::SnapsEngine engine(grid);
+        for (int step = 0; step < 30; step++) {
+            engine.Step(DELTA_TIME);
+            engine.GetStateHash();
+        }
+        grid.At(7, 7).reset();
+        snaps::Grid copy = grid;
+        EXPECT_EQ(engine.GetStateHash(), snaps::StateHash().Compute(copy));
+
+        // The hash doesn't depend on the layout.
+        snaps::Grid rowMajor = MakeSandBox();
+        snaps::SnapsEngine rowMajorEngine(rowMajor);
+        rowMajorEngine.StepN(30, DELTA_TIME);
+        rowMajor.At(7, 7).reset();
+        EXPECT_EQ(rowMajorEngine.GetStateHash(), engine.GetStateHash());
+    }
+}
@@ -0,0 +1,129 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/Fixed.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include "snaps/SparseGrid.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+// Floor, a pile of sand and blocks sliding into each other, with the top-left cell at (originX, originY).
+template <typename GridType>
+void AddScene(GridType& grid, const int originX, const int originY) {
+    for (int x = 0; x < 40; x++) {
+        grid.At(originX + x, originY + 20) = BlockAt(originX + x, originY + 20, false);
+    }
+    for (int y = 2; y < 12; y++) {
+        for (int x = 10; x < 14; x++) {
+            grid.At(originX + x, originY + y) = BlockAt(originX + x, originY + y, true);
+        }
+    }
+    grid.At(originX + 20, originY + 19) = BlockAt(originX + 20, originY + 19, true, {150.0f, 0.0f});
+    grid.At(originX + 30, originY + 19) = BlockAt(originX + 30, originY + 19, true, {-90.0f, 0.0f});
+}
+}
+
+TEST(FixedTest, OperationsRoundDown) {
+    EXPECT_EQ(snaps::Fixed(2.5f).Raw(), 5 * snaps::Fixed::ONE / 2);
+    EXPECT_EQ(snaps::Fixed(-0.25f).Floor(), -1);
+    EXPECT_EQ((snaps::Fixed(-3) / 2).Raw(), -3 * snaps::Fixed::ONE / 2);
+    EXPECT_EQ((snaps::Fixed(1) / snaps::Fixed(3)).Raw(), snaps::Fixed::ONE / 3);
+    EXPECT_EQ((snaps::Fixed(-1) / snaps::Fixed(3)).Raw(), -snaps::Fixed::ONE / 3 - 1);
+    EXPECT_EQ(Sqrt(snaps::Fixed(256)), snaps::Fixed(16));
+    EXPECT_EQ(Sqrt(snaps::Fixed(2)).Raw(), 92681); // sqrt(2) * 65536 = 92681.9
+    EXPECT_EQ(snaps::Fixed(100.125f).ToFloat(), 100.125f);
+}
+
+TEST(FixedPointTest, SettlesLikeFloatSimulation) {
+    std::vector<snaps::Grid> results;
+    for (const bool fixedPoint : {false, true}) {
+        snaps::Grid grid(40, 21);
+        AddScene(grid, 0, 0);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().FixedPoint = fixedPoint;
+        EXPECT_TRUE(engine.StepUntilSettled(1000, DELTA_TIME).IsAtRest);
+        results.push_back(grid);
+    }
+
+    const snaps::Grid& floats = results[0];
+    const snaps::Grid& fixed = results[1];
+    for (std::size_t i = 0; i < floats.Size(); i++) {
+        ASSERT_EQ(floats.IsOccupied(i), fixed.IsOccupied(i)) << "at index " << i;
+        if (not fixed.IsOccupied(i)) continue;
+        const auto [x, y] = fixed.GetXY(i);
+        EXPECT_EQ(fixed.GetWorldPosition(i).x, static_cast<float>(x * snaps::BLOCK_SIZE));
+        EXPECT_EQ(fixed.GetWorldPosition(i).y, static_cast<float>(y * snaps::BLOCK_SIZE));
+    }
+}
+
+// Floats far from the origin can't even represent a position between two pixels.
+TEST(FixedPointTest, BlocksFarFromOriginMoveLikeNearIt) {
+    constexpr int FAR = 1 << 22;
+    snaps::SparseGrid grid;
+    AddScene(grid, 0, 0);
+    AddScene(grid, FAR, FAR);
+    snaps::SparseSnapsEngine engine(grid);
+    engine.GetConfig().FixedPoint = true;
+
+    const snaps::BlockStorage& blocks = grid.Blocks();
+    const snaps::Fixed offset = snaps::Fixed(FAR) * snaps::BLOCK_SIZE;
+    for (int step = 0; step < 120; step++) {
+        engine.Step(DELTA_TIME);
+        for (int y = 0; y <= 20; y++) {
+            for (int x = 0; x < 40; x++) {
+                ASSERT_EQ(grid.IsOccupied(x, y), grid.IsOccupied(FAR + x, FAR + y)) << "step " << step;
+                if (not grid.IsOccupied(x, y) or grid.IsTerrain(grid.GetIndex(x, y))) continue;
+                const std::uint32_t near = grid.GetSlot(grid.GetIndex(x, y));
+                const std::uint32_t far = grid.GetSlot(grid.GetIndex(FAR + x, FAR + y));
+                ASSERT_EQ(blocks.FixedPosition[near].x + offset, blocks.FixedPosition[far].x) << "step " << step;
+                ASSERT_EQ(blocks.FixedPosition[near].y + offset, blocks.FixedPosition[far].y) << "step " << step;
+                ASSERT_EQ(blocks.FixedVelocity[near], blocks.FixedVelocity[far]) << "step " << step;
+            }
+        }
+    }
+}
+
+TEST(FixedPointTest, FloatsChangedFromOutsideAreTaken) {
+    snaps::Grid grid(20, 10);
+    for (int x = 0; x < grid.Width(); x++) {
+        grid.At(x, 9) = BlockAt(x, 9, false);
+    }
+    grid.At(5, 8) = BlockAt(5, 8, true);
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().FixedPoint = true;
+    ASSERT_TRUE(engine.StepUntilSettled(100, DELTA_TIME).IsAtRest);
+
+    grid.At(5, 8)->Velocity.x = 300.0f;
+    engine.StepUntilSettled(200, DELTA_TIME);
+    EXPECT_FALSE(grid.IsOccupied(5, 8));
+    const std::size_t moved = grid.FindNextDynamic(0, grid.Size());
+    EXPECT_GT(grid.GetXY(moved).first, 5);
+    EXPECT_EQ(grid.Blocks().FixedPosition[grid.GetSlot(moved)].ToVector2().x, grid.GetWorldPosition(moved).x);
+}
+
+TEST(FixedPointTest, ResultDoesNotDependOnThreading) {
+    std::vector<std::vector<std::uint64_t>> runs;
+    for (const int threadCount : {0, 1, 4}) {
+        snaps::Grid grid(120, 80);
+        AddRandomBlocks(grid, {
+            .Seed = 3,
+            .Border = RandomBlocks::Edges::Floor,
+            .StaticPercent = 3,
+            .DynamicPercent = 32,
+            .MaxCellsPerStep = {0.125f, 0.0f}
+        });
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().FixedPoint = true;
+        engine.GetConfig().Deterministic = true;
+        engine.GetConfig().ParallelStep = threadCount > 0;
+        engine.GetConfig().ThreadCount = threadCount;
+        std::vector<std::uint64_t>& hashes = runs.emplace_back();
+        for (int step = 0; step < 60; step++) {
+            engine.StepN(1, DELTA_TIME);
+            hashes.push_back(engine.GetStateHash());
+        }
+    }
+    EXPECT_EQ(runs[1], runs[0]);
+    EXPECT_EQ(runs[2], runs[0]);
+}
@@ -0,0 +1,94 @@
+#include "fixtures/SceneTest.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+namespace {
+constexpr snaps::GridLayout LAYOUTS[] = {snaps::GridLayout::RowMajor, snaps::GridLayout::Tiled, snaps::GridLayout::Morton};
+}
+
+TEST(GridLayoutTest, IndicesAreUniqueAndMapBackToCells) {
+    for (const snaps::GridLayout layout : LAYOUTS) {
+        const snaps::Grid grid(70, 130, layout);
+        std::set<std::size_t> indices;
+        for (int y = 0; y < grid.Height(); y++) {
+            for (int x = 0; x < grid.Width(); x++) {
+                const std::size_t index = grid.GetIndex(x, y);
+                ASSERT_LT(index, grid.Size());
+                ASSERT_TRUE(indices.insert(index).second) << "duplicate index of " << x << ", " << y;
+                ASSERT_EQ(grid.GetXY(index), std::make_pair(x, y));
+            }
+        }
+    }
+}
+
+TEST(GridLayoutTest, CursorStepsAcrossTileBorders) {
+    for (const snaps::GridLayout layout : LAYOUTS) {
+        const snaps::Grid grid(70, 70, layout);
+        for (int y = 1; y < grid.Height() - 1; y++) {
+            for (int x = 1; x < grid.Width() - 1; x++) {
+                const snaps::Grid::Cursor cell = grid.GetCursor(x, y);
+                ASSERT_EQ(cell.Left().Index, grid.GetIndex(x - 1, y));
+                ASSERT_EQ(cell.Right().Index, grid.GetIndex(x + 1, y));
+                ASSERT_EQ(cell.Up().Index, grid.GetIndex(x, y - 1));
+                ASSERT_EQ(cell.Down().Index, grid.GetIndex(x, y + 1));
+                ASSERT_EQ(cell.Down().Y, y + 1);
+            }
+        }
+    }
+}
+
+TEST(GridLayoutTest, RowScanFindsActiveBlocksInOrder) {
+    for (const snaps::GridLayout layout : LAYOUTS) {
+        snaps::Grid grid(100, 20, layout);
+        for (const int x : {3, 7, 8, 63, 64, 99}) {
+            grid.At(x, 10) = snaps::Block { .IsDynamic = true };
+        }
+        grid.At(5, 11) = snaps::Block { .IsDynamic = true };
+
+        std::vector<int> found;
+        for (int x = grid.FindNextActiveInRow(0, 10, 100); x < 100; x = grid.FindNextActiveInRow(x + 1, 10, 100)) {
+            found.push_back(x);
+        }
+        EXPECT_EQ(found, (std::vector<int>{3, 7, 8, 63, 64, 99}));
+        EXPECT_EQ(grid.FindNextActiveInRow(9, 10, 63), 63);
+        EXPECT_EQ(grid.FindNextActiveInRow(4, 10, 7), 7);
+    }
+}
+
+struct GridLayoutSceneTest : SceneTest {
+    void SimulateScatteredSand(const snaps::GridLayout layout) {
+        InitializeTestScene(150, 100, layout);
+        std::mt19937 random(3);
+        std::uniform_int_distribution<int> percent(0, 99);
+        for (int y = 1; y < m_Grid->Height() - 1; y++) {
+            for (int x = 1; x < m_Grid->Width() - 1; x++) {
+                const int value = percent(random);
+                if (value < 30) AddSand(x, y);
+                else if (value < 33) AddWall(x, y);
+            }
+        }
+        m_Scene->TickN(60);
+    }
+};
+
+TEST_F(GridLayoutSceneTest, ResultDoesNotDependOnLayout) {
+    SimulateScatteredSand(snaps::GridLayout::RowMajor);
+    const snaps::Grid rowMajor = *m_Grid;
+
+    for (const snaps::GridLayout layout : {snaps::GridLayout::Tiled, snaps::GridLayout::Morton}) {
+        SimulateScatteredSand(layout);
+        for (int y = 0; y < m_Grid->Height(); y++) {
+            for (int x = 0; x < m_Grid->Width(); x++) {
+                const auto expected = rowMajor.At(x, y);
+                const auto actual = std::as_const(*m_Grid).At(x, y);
+                ASSERT_EQ(expected.has_value(), actual.has_value()) << "at " << x << ", " << y;
+                if (not expected) continue;
+                EXPECT_EQ(expected->WorldPosition.x, actual->WorldPosition.x) << "at " << x << ", " << y;
+                EXPECT_EQ(expected->WorldPosition.y, actual->WorldPosition.y) << "at " << x << ", " << y;
+                EXPECT_EQ(expected->Velocity.x, actual->Velocity.x) << "at " << x << ", " << y;
+                EXPECT_EQ(expected->Velocity.y, actual->Velocity.y) << "at " << x << ", " << y;
+            }
+        }
+    }
+}
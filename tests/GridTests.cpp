@@ -0,0 +1,275 @@
+#include "snaps/Grid.hpp"
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+snaps::Block DynamicBlock() {
+    return snaps::Block { .IsDynamic = true };
+}
+
+snaps::Block StaticBlock() {
+    return snaps::Block { .IsDynamic = false };
+}
+}
+
+TEST(GridTest, CellBehavesLikeOptional) {
+    snaps::Grid grid(3, 3);
+    EXPECT_FALSE(grid.At(1, 1).has_value());
+
+    grid.At(1, 1) = snaps::Block { .Velocity = {1.0f, 2.0f}, .IsDynamic = true };
+    ASSERT_TRUE(grid.At(1, 1).has_value());
+    EXPECT_EQ(grid.At(1, 1)->Velocity.y, 2.0f);
+
+    grid.At(1, 1)->Velocity.y = 5.0f;
+    EXPECT_EQ(std::as_const(grid).At(1, 1)->Velocity.y, 5.0f);
+
+    grid.At(1, 1) = std::nullopt;
+    EXPECT_FALSE(grid.At(1, 1).has_value());
+}
+
+TEST(GridTest, OccupancyAndDynamicBitsFollowBlocks) {
+    snaps::Grid grid(10, 10);
+    const std::size_t dynamicIndex = grid.GetIndex(2, 3);
+    const std::size_t staticIndex = grid.GetIndex(5, 3);
+
+    grid.At(2, 3) = DynamicBlock();
+    grid.At(5, 3) = StaticBlock();
+    EXPECT_TRUE(grid.IsOccupied(dynamicIndex));
+    EXPECT_TRUE(grid.IsDynamic(dynamicIndex));
+    EXPECT_TRUE(grid.IsOccupied(staticIndex));
+    EXPECT_FALSE(grid.IsDynamic(staticIndex));
+
+    const std::size_t target = grid.GetIndex(2, 4);
+    grid.Move(dynamicIndex, target);
+    EXPECT_FALSE(grid.IsOccupied(dynamicIndex));
+    EXPECT_FALSE(grid.IsDynamic(dynamicIndex));
+    EXPECT_TRUE(grid.IsOccupied(target));
+    EXPECT_TRUE(grid.IsDynamic(target));
+
+    grid.Remove(target);
+    EXPECT_FALSE(grid.IsOccupied(target));
+    EXPECT_FALSE(grid.IsDynamic(target));
+}
+
+TEST(GridTest, FindNextDynamicSkipsEmptyWords) {
+    snaps::Grid grid(100, 100);
+    grid.At(0, 0) = StaticBlock();
+    grid.At(70, 1) = DynamicBlock();
+    grid.At(99, 99) = DynamicBlock();
+
+    const std::size_t end = grid.Size();
+    EXPECT_EQ(grid.FindNextOccupied(0, end), grid.GetIndex(0, 0));
+    EXPECT_EQ(grid.FindNextDynamic(0, end), grid.GetIndex(70, 1));
+    EXPECT_EQ(grid.FindNextDynamic(grid.GetIndex(71, 1), end), grid.GetIndex(99, 99));
+    EXPECT_EQ(grid.FindNextDynamic(grid.GetIndex(71, 1), grid.GetIndex(0, 99)), grid.GetIndex(0, 99));
+    EXPECT_EQ(grid.FindNextDynamic(end - 1, end), end - 1);
+}
+
+TEST(GridTest, WakingBlockMarksItsNeighbourhoodDirty) {
+    snaps::Grid grid(100, 100);
+    grid.At(10, 10) = DynamicBlock();
+
+    const auto& rect = grid.GetDirtyRect(0, 0);
+    EXPECT_EQ(rect.MinX, 9);
+    EXPECT_EQ(rect.MinY, 9);
+    EXPECT_EQ(rect.MaxX, 11);
+    EXPECT_EQ(rect.MaxY, 11);
+    EXPECT_TRUE(grid.GetDirtyRect(1, 0).IsEmpty());
+    EXPECT_TRUE(grid.GetDirtyRect(1, 1).IsEmpty());
+}
+
+TEST(GridTest, DirtyAreaSpillsOverChunkBorder) {
+    snaps::Grid grid(100, 100);
+    constexpr int border = snaps::Grid::CHUNK_SIZE;
+    grid.At(border - 1, border) = DynamicBlock();
+
+    std::vector<snaps::Grid::DirtyRect> rects;
+    grid.TakeDirtyRects(rects);
+    ASSERT_EQ(rects.size(), 4);
+    EXPECT_EQ(rects[0].MinX, border - 2);
+    EXPECT_EQ(rects[0].MaxX, border - 1);
+    EXPECT_EQ(rects[0].MinY, border - 1);
+    EXPECT_EQ(rects[0].MaxY, border - 1);
+    EXPECT_EQ(rects[1].MinX, border);
+    EXPECT_EQ(rects[1].MaxX, border);
+    EXPECT_EQ(rects[3].MinY, border);
+    EXPECT_EQ(rects[3].MaxY, border + 1);
+
+    grid.TakeDirtyRects(rects);
+    EXPECT_TRUE(rects.empty());
+}
+
+TEST(GridTest, BlockIdSurvivesMovement) {
+    snaps::Grid grid(10, 10);
+    grid.At(2, 3) = DynamicBlock();
+    const snaps::BlockId id = grid.GetBlockId(2, 3);
+    const std::uint32_t slot = grid.GetSlot(grid.GetIndex(2, 3));
+
+    grid.Move(grid.GetIndex(2, 3), grid.GetIndex(2, 4));
+    EXPECT_EQ(grid.GetBlockId(2, 4), id);
+    EXPECT_EQ(grid.GetSlot(grid.GetIndex(2, 4)), slot);
+    EXPECT_EQ(grid.Find(id), grid.GetIndex(2, 4));
+}
+
+TEST(GridTest, SlotOfRemovedBlockIsReusedWithNewId) {
+    snaps::Grid grid(10, 10);
+    grid.At(2, 3) = DynamicBlock();
+    const snaps::BlockId removedId = grid.GetBlockId(2, 3);
+    grid.Remove(2, 3);
+    EXPECT_FALSE(grid.Find(removedId).has_value());
+    EXPECT_EQ(grid.BlockCount(), 0);
+
+    grid.At(7, 7) = DynamicBlock();
+    const snaps::BlockId newId = grid.GetBlockId(7, 7);
+    EXPECT_EQ(newId.Slot, removedId.Slot);
+    EXPECT_NE(newId, removedId);
+    EXPECT_FALSE(grid.Find(removedId).has_value());
+    EXPECT_EQ(grid.Find(newId), grid.GetIndex(7, 7));
+    EXPECT_EQ(grid.Blocks().Size(), 1);
+}
+
+TEST(GridTest, OverwritingCellReplacesBlock) {
+    snaps::Grid grid(10, 10);
+    grid.At(2, 3) = DynamicBlock();
+    const snaps::BlockId oldId = grid.GetBlockId(2, 3);
+
+    grid.At(2, 3) = DynamicBlock();
+    EXPECT_FALSE(grid.Find(oldId).has_value());
+    EXPECT_EQ(grid.Find(grid.GetBlockId(2, 3)), grid.GetIndex(2, 3));
+    EXPECT_EQ(grid.BlockCount(), 1);
+
+    grid.At(2, 3) = StaticBlock();
+    EXPECT_FALSE(grid.Find(oldId).has_value());
+    EXPECT_EQ(grid.BlockCount(), 0);
+}
+
+TEST(GridTest, PoolOfBlocksGrowsWithBlocksOnly) {
+    snaps::Grid grid(256, 256);
+    for (int x = 0; x < grid.Width(); x++) {
+        grid.At(x, grid.Height() - 1) = StaticBlock();
+    }
+    EXPECT_EQ(grid.Blocks().Flags.capacity(), 0);
+
+    for (int x = 0; x < 10; x++) {
+        grid.At(x, 0) = DynamicBlock();
+    }
+    EXPECT_LT(grid.Blocks().Flags.capacity(), 100);
+    const snaps::Grid copy = grid;
+    EXPECT_LT(copy.Blocks().Flags.capacity(), 100);
+    EXPECT_EQ(copy.BlockCount(), 10);
+}
+
+TEST(GridTest, StaticBlocksAreStoredAsTerrain) {
+    snaps::Grid grid(10, 10);
+    const snaps::MaterialId stone = grid.Materials().Add({.Friction = 0.5f});
+    grid.At(4, 5) = snaps::Block { .Material = stone, .IsDynamic = false };
+    const std::size_t index = grid.GetIndex(4, 5);
+    EXPECT_TRUE(grid.IsOccupied(index));
+    EXPECT_TRUE(grid.IsTerrain(index));
+    EXPECT_EQ(grid.BlockCount(), 0);
+    EXPECT_EQ(grid.GetMaterial(index).Friction, 0.5f);
+    EXPECT_EQ(grid.GetVelocity(index).x, 0.0f);
+    EXPECT_EQ(grid.GetWorldPosition(index).x, 4.0f * snaps::BLOCK_SIZE);
+    EXPECT_EQ(grid.GetWorldPosition(index).y, 5.0f * snaps::BLOCK_SIZE);
+
+    const std::optional<snaps::Block> block = std::as_const(grid).At(index);
+    ASSERT_TRUE(block.has_value());
+    EXPECT_FALSE(block->IsDynamic);
+    EXPECT_EQ(block->Material, stone);
+    EXPECT_EQ(block->WorldPosition.y, 5.0f * snaps::BLOCK_SIZE);
+    EXPECT_EQ(grid.BlockCount(), 0);
+
+    // Mutable access unpacks the terrain, assigning a static block packs it again.
+    grid.At(index)->Velocity.x = 1.0f;
+    EXPECT_FALSE(grid.IsTerrain(index));
+    EXPECT_FALSE(grid.IsDynamic(index));
+    EXPECT_EQ(grid.GetVelocity(index).x, 1.0f);
+    EXPECT_EQ(grid.GetMaterial(index).Friction, 0.5f);
+    EXPECT_EQ(grid.BlockCount(), 1);
+
+    grid.At(index) = grid.At(index);
+    EXPECT_TRUE(grid.IsTerrain(index));
+    EXPECT_EQ(grid.BlockCount(), 0);
+
+    grid.Remove(index);
+    EXPECT_FALSE(grid.IsOccupied(index));
+    EXPECT_FALSE(grid.IsTerrain(index));
+}
+
+TEST(GridTest, NeighbourMasksFollowBlocks) {
+    using snaps::Neighbours;
+    snaps::Grid grid(10, 10);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(4, 4)), 0);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(0, 4)), Neighbours::LEFT | Neighbours::UP_LEFT | Neighbours::DOWN_LEFT);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(9, 9)), Neighbours::ALL & ~(Neighbours::LEFT | Neighbours::UP | Neighbours::UP_LEFT));
+
+    grid.At(4, 4) = DynamicBlock();
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(5, 4)), Neighbours::LEFT);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(3, 3)), Neighbours::DOWN_RIGHT);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(4, 3)), Neighbours::DOWN);
+
+    grid.Move(grid.GetIndex(4, 4), grid.GetIndex(5, 4));
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(4, 4)), Neighbours::RIGHT);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(5, 4)), 0);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(3, 3)), 0);
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(4, 3)), Neighbours::DOWN_RIGHT);
+
+    // Only terrain counts as static below, an unpacked static block may be moved around by hand.
+    grid.At(5, 4) = StaticBlock();
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(5, 3)), Neighbours::DOWN | Neighbours::STATIC_BELOW);
+    grid.At(5, 4)->Velocity.x = 1.0f;
+    EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(5, 3)), Neighbours::DOWN);
+
+    grid.Remove(5, 4);
+    for (int y = 1; y < 9; y++) {
+        for (int x = 1; x < 9; x++) {
+            EXPECT_EQ(grid.GetNeighbours(grid.GetIndex(x, y)), 0) << "at " << x << ", " << y;
+        }
+    }
+}
+
+TEST(GridTest, FindSurfaceBelowFollowsBlocks) {
+    snaps::Grid grid(4, 100);
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 0, 16), 17);
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 90, 120), 100); // Below the grid counts as occupied
+
+    grid.At(1, 70) = StaticBlock();
+    grid.At(1, 10) = DynamicBlock();
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 0, 16), 10);
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 60, 80), 70);
+    EXPECT_EQ(grid.FindSurfaceBelow(2, 0, 80), 81);
+
+    // Across words of the column, and by a move further than the next cell.
+    grid.Move(grid.GetIndex(1, 10), grid.GetIndex(1, 66));
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 0, 16), 17);
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 50, 80), 66);
+    grid.Move(grid.GetIndex(1, 66), grid.GetIndex(2, 66));
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 50, 80), 70);
+    EXPECT_EQ(grid.FindSurfaceBelow(2, 50, 80), 66);
+
+    grid.Remove(1, 70);
+    EXPECT_EQ(grid.FindSurfaceBelow(1, 50, 80), 81);
+}
+
+TEST(GridTest, BlocksShareTheirMaterial) {
+    snaps::Grid grid(10, 10);
+    const snaps::MaterialId ice = grid.Materials().Add({.Friction = 0.1f});
+    grid.At(2, 3) = snaps::Block { .Material = ice, .IsDynamic = true };
+    grid.At(5, 3) = snaps::Block { .Material = ice, .IsDynamic = true };
+    EXPECT_EQ(grid.At(2, 3)->GetMaterial().Friction, 0.1f);
+
+    grid.Materials()[ice].Friction = 0.2f;
+    EXPECT_EQ(grid.At(2, 3)->GetMaterial().Friction, 0.2f);
+    EXPECT_EQ(grid.At(5, 3)->GetMaterial().Friction, 0.2f);
+    EXPECT_EQ(grid.At(5, 3)->GetMaterial().InvMass, snaps::Material{}.InvMass);
+}
+
+TEST(GridTest, FullMaterialTableRejectsMoreMaterials) {
+    snaps::MaterialTable materials;
+    for (std::size_t id = materials.Size(); id < snaps::MaterialTable::CAPACITY; id++) {
+        EXPECT_EQ(materials.Add({}), id);
+    }
+    EXPECT_THROW(materials.Add({}), std::length_error);
+    EXPECT_EQ(materials.Size(), snaps::MaterialTable::CAPACITY);
+}
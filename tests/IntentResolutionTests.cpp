@@ -0,0 +1,126 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+constexpr float CELLS_PER_STEP = snaps::BLOCK_SIZE / DELTA_TIME;
+
+snaps::Grid MakeGridWithFloor(const int width, const int height) {
+    snaps::Grid grid(width, height);
+    for (int x = 0; x < width; x++) {
+        grid.At(x, height - 1) = BlockAt(x, height - 1, false);
+    }
+    return grid;
+}
+
+// Floor, a few obstacles and blocks flying in random directions, so that they fight over cells.
+snaps::Grid MakeBusyScene() {
+    snaps::Grid grid(150, 90);
+    AddRandomBlocks(grid, {
+        .Seed = 11,
+        .Border = RandomBlocks::Edges::Floor,
+        .StaticPercent = 2,
+        .DynamicPercent = 38,
+        .MaxCellsPerStep = {3.0f, 3.0f},
+        .DeltaTime = DELTA_TIME
+    });
+    return grid;
+}
+}
+
+TEST(IntentResolutionTest, FallingColumnMovesAsOneChain) {
+    snaps::Grid grid = MakeGridWithFloor(3, 20);
+    for (int y = 0; y < 5; y++) {
+        grid.At(1, y) = BlockAt(1, y, true, {0.0f, 0.8f * CELLS_PER_STEP});
+    }
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().TwoPhaseResolution = true;
+
+    engine.Step(DELTA_TIME);
+    EXPECT_FALSE(grid.IsOccupied(1, 0));
+    for (int y = 1; y <= 5; y++) {
+        EXPECT_TRUE(grid.IsOccupied(1, y)) << "at " << y;
+    }
+}
+
+TEST(IntentResolutionTest, SwappingBlocksStop) {
+    snaps::Grid grid = MakeGridWithFloor(6, 4);
+    grid.At(2, 2) = BlockAt(2, 2, true, {0.5f * CELLS_PER_STEP, 0.0f});
+    grid.At(3, 2) = BlockAt(3, 2, true, {-0.5f * CELLS_PER_STEP, 0.0f});
+    const snaps::BlockId left = grid.GetBlockId(2, 2);
+    const snaps::BlockId right = grid.GetBlockId(3, 2);
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().TwoPhaseResolution = true;
+
+    engine.Step(DELTA_TIME);
+    EXPECT_EQ(grid.GetBlockId(2, 2), left);
+    EXPECT_EQ(grid.GetBlockId(3, 2), right);
+    EXPECT_EQ(grid.At(2, 2)->Velocity.x, 0.0f);
+    EXPECT_EQ(grid.At(3, 2)->Velocity.x, 0.0f);
+    EXPECT_EQ(grid.At(2, 2)->WorldPosition.x, 2.0f * snaps::BLOCK_SIZE);
+    EXPECT_EQ(grid.At(3, 2)->WorldPosition.x, 3.0f * snaps::BLOCK_SIZE);
+}
+
+TEST(IntentResolutionTest, BlockThatReachedCellFirstWinsIt) {
+    snaps::Grid grid = MakeGridWithFloor(7, 4);
+    grid.At(1, 2) = BlockAt(1, 2, true, {0.5f * CELLS_PER_STEP, 0.0f});
+    grid.At(3, 2) = BlockAt(3, 2, true, {-0.5f * CELLS_PER_STEP, 0.0f});
+    grid.At(3, 2)->WorldPosition.x -= 4.0f; // Already on the way
+    const snaps::BlockId second = grid.GetBlockId(3, 2);
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().TwoPhaseResolution = true;
+
+    engine.Step(DELTA_TIME);
+    EXPECT_EQ(grid.GetBlockId(2, 2), second);
+    EXPECT_TRUE(grid.IsOccupied(1, 2));
+    EXPECT_EQ(grid.At(1, 2)->Velocity.x, 0.0f);
+}
+
+TEST(IntentResolutionTest, ResultDoesNotDependOnThreading) {
+    for (const bool fixedPoint : {false, true}) {
+        std::vector<std::vector<std::uint64_t>> runs;
+        for (const int threadCount : {0, 1, 4}) {
+            snaps::Grid grid = MakeBusyScene();
+            snaps::SnapsEngine engine(grid);
+            engine.GetConfig().TwoPhaseResolution = true;
+            engine.GetConfig().FixedPoint = fixedPoint;
+            engine.GetConfig().ParallelStep = threadCount > 0;
+            engine.GetConfig().ThreadCount = threadCount;
+            std::vector<std::uint64_t>& hashes = runs.emplace_back();
+            for (int step = 0; step < 60; step++) {
+                engine.StepN(1, DELTA_TIME);
+                hashes.push_back(engine.GetStateHash());
+            }
+        }
+        EXPECT_EQ(runs[1], runs[0]) << "fixed point " << fixedPoint;
+        EXPECT_EQ(runs[2], runs[0]) << "fixed point " << fixedPoint;
+    }
+}
+
+TEST(IntentResolutionTest, SettlesLikeSweep) {
+    std::vector<snaps::Grid> results;
+    for (const bool twoPhase : {false, true}) {
+        snaps::Grid grid = MakeGridWithFloor(40, 21);
+        for (int y = 2; y < 12; y++) {
+            for (int x = 10; x < 14; x++) {
+                grid.At(x, y) = BlockAt(x, y, true);
+            }
+        }
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().TwoPhaseResolution = twoPhase;
+        EXPECT_TRUE(engine.StepUntilSettled(1000, DELTA_TIME).IsAtRest);
+        results.push_back(grid);
+    }
+
+    const snaps::Grid& sweep = results[0];
+    const snaps::Grid& twoPhase = results[1];
+    for (std::size_t i = 0; i < sweep.Size(); i++) {
+        ASSERT_EQ(sweep.IsOccupied(i), twoPhase.IsOccupied(i)) << "at index " << i;
+        if (not twoPhase.IsOccupied(i)) continue;
+        const auto [x, y] = twoPhase.GetXY(i);
+        EXPECT_EQ(twoPhase.GetWorldPosition(i).x, static_cast<float>(x * snaps::BLOCK_SIZE));
+        EXPECT_EQ(twoPhase.GetWorldPosition(i).y, static_cast<float>(y * snaps::BLOCK_SIZE));
+    }
+}
@@ -0,0 +1,76 @@
+#include "fixtures/SceneTest.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+struct ParallelStepTest : SceneTest {
+    void InitializeParallelScene(const int gridWidth, const int gridHeight, const int threadCount = 4) {
+        InitializeTestScene(gridWidth, gridHeight);
+        m_Engine->GetConfig().ParallelStep = true;
+        m_Engine->GetConfig().ThreadCount = threadCount;
+    }
+
+    // Sand scattered randomly over the whole grid, so that it falls across chunk borders.
+    void ScatterSand(const unsigned seed) const {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> percent(0, 99);
+        for (int y = 1; y < m_Grid->Height() - 1; y++) {
+            for (int x = 1; x < m_Grid->Width() - 1; x++) {
+                if (percent(random) < 30) AddSand(x, y);
+            }
+        }
+    }
+
+    std::size_t CountBlocks() const {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < m_Grid->Size(); i++) {
+            count += m_Grid->IsOccupied(i);
+        }
+        return count;
+    }
+};
+
+TEST_F(ParallelStepTest, SandFallsAcrossChunkBorder) {
+    constexpr int border = snaps::Grid::CHUNK_SIZE;
+    InitializeParallelScene(3, border + 10);
+    AddSand(1, border - 3);
+    AddSand(1, border - 2);
+    AddSand(1, border - 1);
+
+    m_Scene->TickTime(3.0f);
+    const int floor = border + 10 - 1;
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(1, floor - 1));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(1, floor - 2));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(1, floor - 3));
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(1, floor - 4));
+}
+
+TEST_F(ParallelStepTest, BlocksAreNeitherLostNorDuplicated) {
+    InitializeParallelScene(200, 150);
+    ScatterSand(1);
+    const std::size_t blocks = CountBlocks();
+
+    m_Scene->TickN(60);
+    EXPECT_EQ(CountBlocks(), blocks);
+}
+
+TEST_F(ParallelStepTest, ResultDoesNotDependOnThreadCount) {
+    InitializeParallelScene(200, 150, 1);
+    ScatterSand(2);
+    m_Scene->TickN(60);
+    const snaps::Grid singleThreaded = *m_Grid;
+
+    InitializeParallelScene(200, 150, 4);
+    ScatterSand(2);
+    m_Scene->TickN(60);
+
+    for (std::size_t i = 0; i < m_Grid->Size(); i++) {
+        const auto expected = std::as_const(singleThreaded).At(i);
+        const auto actual = std::as_const(*m_Grid).At(i);
+        ASSERT_EQ(expected.has_value(), actual.has_value()) << "at index " << i;
+        if (not expected) continue;
+        EXPECT_EQ(expected->WorldPosition.x, actual->WorldPosition.x) << "at index " << i;
+        EXPECT_EQ(expected->WorldPosition.y, actual->WorldPosition.y) << "at index " << i;
+        EXPECT_EQ(expected->Velocity.x, actual->Velocity.x) << "at index " << i;
+        EXPECT_EQ(expected->Velocity.y, actual->Velocity.y) << "at index " << i;
+    }
+}
@@ -0,0 +1,97 @@
+#include "fixtures/SceneTest.hpp"
+#include <gtest/gtest.h>
+
+struct SleepTest : SceneTest {
+    bool IsActive(const int x, const int y) const {
+        return m_Grid->IsActive(m_Grid->GetIndex(x, y));
+    }
+    bool IsSleeping(const int x, const int y) const {
+        return m_Grid->Blocks().Flags[m_Grid->GetSlot(m_Grid->GetIndex(x, y))].IsSleeping;
+    }
+};
+
+TEST_F(SleepTest, RestingBlockFallsAsleep) {
+    InitializeTestScene(5, 5);
+    AddSand(2, 3);
+    EXPECT_TRUE(IsActive(2, 3));
+    EXPECT_FALSE(IsSleeping(2, 3));
+
+    m_Scene->TickN(m_Engine->GetConfig().SleepAfterSteps);
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 3));
+    EXPECT_FALSE(IsActive(2, 3));
+    EXPECT_TRUE(IsSleeping(2, 3));
+}
+
+TEST_F(SleepTest, SleepingDisabled) {
+    InitializeTestScene(5, 5);
+    m_Engine->GetConfig().SleepAfterSteps = 0;
+    AddSand(2, 3);
+
+    m_Scene->TickTime(1.0f);
+    EXPECT_TRUE(IsActive(2, 3));
+    EXPECT_FALSE(IsSleeping(2, 3));
+}
+
+TEST_F(SleepTest, FallingBlockStaysAwake) {
+    InitializeTestScene(5, 10);
+    AddSand(2, 1);
+
+    m_Scene->TickN(m_Engine->GetConfig().SleepAfterSteps + 1);
+    EXPECT_SCENE(m_Scene, check::BlockIsMovingDownAt(2, 2));
+    EXPECT_TRUE(IsActive(2, 2));
+}
+
+TEST_F(SleepTest, BlockWakesUpWhenNeighbourIsRemoved) {
+    InitializeTestScene(5, 5);
+    AddSand(2, 2);
+    AddSand(2, 3);
+    m_Scene->TickTime(1.0f);
+    ASSERT_FALSE(IsActive(2, 2));
+    ASSERT_FALSE(IsActive(2, 3));
+
+    GetBlockOpt(2, 3).reset();
+    EXPECT_TRUE(IsActive(2, 2));
+
+    m_Scene->TickTime(0.5f);
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(2, 2));
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 3));
+}
+
+TEST_F(SleepTest, ImpulseWakesBlockUp) {
+    InitializeTestScene(6, 5);
+    AddSand(1, 3);
+    m_Scene->TickTime(1.0f);
+    ASSERT_FALSE(IsActive(1, 3));
+
+    snaps::ApplyImpulse(GetBlock(1, 3), {400.0f, 0.0f});
+    EXPECT_TRUE(IsActive(1, 3));
+
+    m_Scene->Tick();
+    EXPECT_SCENE(m_Scene, check::BlockIsEmptyAt(1, 3));
+    EXPECT_SCENE(m_Scene, check::BlockIsMovingRightAt(2, 3));
+}
+
+TEST_F(SleepTest, BlockWakesUpWhenDiagonalNeighbourChanges) {
+    InitializeTestScene(5, 5);
+    AddSand(2, 3);
+    AddSand(3, 3);
+    m_Scene->TickTime(1.0f);
+    ASSERT_TRUE(IsSleeping(2, 3));
+    ASSERT_TRUE(IsSleeping(3, 3));
+
+    AddWall(1, 2);
+    EXPECT_TRUE(IsActive(2, 3));
+    EXPECT_FALSE(IsSleeping(2, 3));
+    EXPECT_TRUE(IsSleeping(3, 3)); // Not a neighbour of the changed cell
+}
+
+TEST_F(SleepTest, SleepingWorldHasNoDirtyArea) {
+    InitializeTestScene(5, 5);
+    AddSand(2, 3);
+    m_Scene->TickN(m_Engine->GetConfig().SleepAfterSteps);
+    ASSERT_TRUE(IsSleeping(2, 3));
+
+    std::vector<snaps::Grid::DirtyRect> rects;
+    m_Grid->TakeDirtyRects(rects);
+    EXPECT_TRUE(rects.empty());
+}
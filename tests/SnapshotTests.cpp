@@ -0,0 +1,120 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/GridSnapshot.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+// The width is not a multiple of the chunk size, so rows of chunks don't start at a word of bits.
+snaps::Grid MakeSand(const snaps::GridLayout layout) {
+    snaps::Grid grid(150, 100, layout);
+    AddRandomBlocks(grid, {.Seed = 7, .Border = RandomBlocks::Edges::Floor, .StaticPercent = 3, .DynamicPercent = 27});
+    return grid;
+}
+
+// Edits made by the player in the middle of the simulation.
+void EditAtFrame(snaps::Grid& grid, const int frame) {
+    if (frame != 25) return;
+    grid.At(70, 2) = BlockAt(70, 2, true);
+    grid.At(140, 97).reset();
+}
+
+void ExpectSameState(const snaps::Grid& expected, const snaps::Grid& actual) {
+    ASSERT_EQ(expected.BlockCount(), actual.BlockCount());
+    for (std::size_t i = 0; i < expected.Size(); i++) {
+        const auto expectedBlock = expected.At(i);
+        const auto actualBlock = actual.At(i);
+        ASSERT_EQ(expectedBlock.has_value(), actualBlock.has_value()) << "at index " << i;
+        // Restored masks are computed from scratch, the expected ones were kept up to date by moves.
+        EXPECT_EQ(expected.GetNeighbours(i), actual.GetNeighbours(i)) << "at index " << i;
+        if (not expectedBlock) continue;
+        EXPECT_EQ(expectedBlock->WorldPosition.x, actualBlock->WorldPosition.x) << "at index " << i;
+        EXPECT_EQ(expectedBlock->WorldPosition.y, actualBlock->WorldPosition.y) << "at index " << i;
+        EXPECT_EQ(expectedBlock->Velocity.x, actualBlock->Velocity.x) << "at index " << i;
+        EXPECT_EQ(expectedBlock->Velocity.y, actualBlock->Velocity.y) << "at index " << i;
+        EXPECT_EQ(expected.IsActive(i), actual.IsActive(i)) << "at index " << i;
+        if (not expected.IsTerrain(i)) {
+            EXPECT_EQ(expected.GetBlockId(i), actual.GetBlockId(i)) << "at index " << i;
+        }
+    }
+}
+}
+
+TEST(SnapshotTest, RollbackSimulatesTheSameFramesAgain) {
+    for (const snaps::GridLayout layout : {snaps::GridLayout::RowMajor, snaps::GridLayout::Morton}) {
+        snaps::Grid grid = MakeSand(layout);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().ParallelStep = layout == snaps::GridLayout::Morton;
+        for (int frame = 0; frame < 30; frame++) {
+            engine.SaveSnapshot(frame);
+            EditAtFrame(grid, frame);
+            engine.Step(DELTA_TIME);
+        }
+        const snaps::Grid expected = grid;
+
+        // The ring holds the last 8 frames.
+        EXPECT_FALSE(engine.RestoreSnapshot(21));
+        ASSERT_TRUE(engine.RestoreSnapshot(22));
+        for (int frame = 22; frame < 30; frame++) {
+            engine.SaveSnapshot(frame);
+            EditAtFrame(grid, frame);
+            engine.Step(DELTA_TIME);
+        }
+        ExpectSameState(expected, grid);
+    }
+}
+
+TEST(SnapshotTest, SavingCopiesOnlyChangedChunks) {
+    snaps::Grid grid(256, 256);
+    for (int x = 0; x < grid.Width(); x++) {
+        grid.At(x, 255) = BlockAt(x, 255, false);
+    }
+    grid.At(10, 10) = BlockAt(10, 10, true);
+    const snaps::BlockId sand = grid.GetBlockId(10, 10);
+    snaps::SnapsEngine engine(grid);
+
+    snaps::GridSnapshot snapshot;
+    snapshot.Save(grid);
+    EXPECT_EQ(snapshot.CopiedChunkCount(), 16);
+
+    engine.StepN(5, DELTA_TIME);
+    snapshot.Save(grid);
+    EXPECT_EQ(snapshot.CopiedChunkCount(), 1);
+    snapshot.Save(grid);
+    EXPECT_EQ(snapshot.CopiedChunkCount(), 0);
+
+    const std::size_t savedCell = *grid.Find(sand);
+    const Vector2 savedPosition = grid.GetWorldPosition(savedCell);
+    engine.StepN(30, DELTA_TIME);
+    ASSERT_NE(*grid.Find(sand), savedCell);
+    snapshot.Restore(grid);
+    EXPECT_EQ(snapshot.CopiedChunkCount(), 1);
+    ASSERT_EQ(grid.Find(sand), savedCell);
+    EXPECT_EQ(grid.GetWorldPosition(savedCell).y, savedPosition.y);
+}
+
+TEST(SnapshotTest, RestoreReturnsRemovedBlocksAndConfig) {
+    snaps::Grid grid(20, 20);
+    grid.At(5, 19) = BlockAt(5, 19, false);
+    grid.At(5, 5) = BlockAt(5, 5, true);
+    const snaps::BlockId removedId = grid.GetBlockId(5, 5);
+    snaps::SnapsEngine engine(grid);
+    engine.SaveSnapshot(0);
+
+    grid.At(5, 5).reset();
+    grid.At(8, 8) = BlockAt(8, 8, true);
+    const snaps::BlockId addedId = grid.GetBlockId(8, 8);
+    engine.GetConfig().Gravity = 10.0f;
+    engine.Step(DELTA_TIME);
+    engine.SaveSnapshot(1);
+
+    ASSERT_TRUE(engine.RestoreSnapshot(0));
+    EXPECT_EQ(engine.GetConfig().Gravity, snaps::Config{}.Gravity);
+    EXPECT_EQ(grid.Find(removedId), grid.GetIndex(5, 5));
+    EXPECT_FALSE(grid.Find(addedId).has_value());
+    EXPECT_FALSE(grid.IsOccupied(8, 8));
+    EXPECT_TRUE(grid.IsActive(grid.GetIndex(5, 5)));
+    // Frame 1 was in the discarded future.
+    EXPECT_FALSE(engine.RestoreSnapshot(1));
+}
@@ -0,0 +1,117 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include "snaps/SparseGrid.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <utility>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+}
+
+TEST(SparseGridTest, NegativeCoordinatesMapBackToCells) {
+    const snaps::SparseGrid grid;
+    for (int y = -130; y <= 130; y++) {
+        for (int x = -130; x <= 130; x++) {
+            ASSERT_EQ(grid.GetXY(grid.GetIndex(x, y)), std::make_pair(x, y));
+
+            const snaps::SparseGrid::Cursor cell = grid.GetCursor(x, y);
+            ASSERT_EQ(cell.Left().Index, grid.GetIndex(x - 1, y));
+            ASSERT_EQ(cell.Right().Index, grid.GetIndex(x + 1, y));
+            ASSERT_EQ(cell.Up().Index, grid.GetIndex(x, y - 1));
+            ASSERT_EQ(cell.Down().Index, grid.GetIndex(x, y + 1));
+        }
+    }
+}
+
+TEST(SparseGridTest, ChunksExistOnlyWhileTheyHoldBlocks) {
+    snaps::SparseGrid grid;
+    EXPECT_EQ(grid.ChunkCount(), 0);
+
+    grid.At(-1000, 5000) = BlockAt(-1000, 5000, false);
+    grid.At(-1001, 5000) = BlockAt(-1001, 5000, false);
+    EXPECT_EQ(grid.ChunkCount(), 1);
+    EXPECT_TRUE(grid.IsOccupied(-1000, 5000));
+    EXPECT_FALSE(grid.IsOccupied(-1000, 5001));
+    EXPECT_EQ(std::as_const(grid).At(-1000, 5000)->WorldPosition.x, -1000.0f * snaps::BLOCK_SIZE);
+
+    grid.At(-1000, 5000) = std::nullopt;
+    EXPECT_EQ(grid.ChunkCount(), 1);
+    grid.At(-1001, 5000).reset();
+    EXPECT_EQ(grid.ChunkCount(), 0);
+    EXPECT_FALSE(grid.IsOccupied(-1001, 5000));
+}
+
+TEST(SparseGridTest, RowScanSkipsMissingChunks) {
+    snaps::SparseGrid grid;
+    for (const int x : {-200, -65, -64, -1, 0, 63, 300}) {
+        grid.At(x, -7) = BlockAt(x, -7, true);
+    }
+
+    std::vector<int> found;
+    for (int x = grid.FindNextActiveInRow(-300, -7, 400); x < 400; x = grid.FindNextActiveInRow(x + 1, -7, 400)) {
+        found.push_back(x);
+    }
+    EXPECT_EQ(found, (std::vector<int>{-200, -65, -64, -1, 0, 63, 300}));
+    EXPECT_EQ(grid.FindNextActiveInRow(1, -7, 63), 63);
+}
+
+TEST(SparseGridTest, SandFallsAcrossChunksAndFreesThemBehind) {
+    snaps::SparseGrid grid;
+    snaps::SparseSnapsEngine engine(grid);
+    for (int x = -70; x <= -60; x++) {
+        grid.At(x, -10) = BlockAt(x, -10, false);
+    }
+    grid.At(-65, -100) = BlockAt(-65, -100, true);
+
+    const auto result = engine.StepUntilSettled(1000, DELTA_TIME);
+    ASSERT_TRUE(result.IsAtRest);
+    ASSERT_TRUE(grid.IsOccupied(-65, -11));
+    EXPECT_EQ(grid.GetWorldPosition(-65, -11).x, -65.0f * snaps::BLOCK_SIZE);
+    EXPECT_EQ(grid.GetWorldPosition(-65, -11).y, -11.0f * snaps::BLOCK_SIZE);
+    // Only the two chunks under the floor are left, the ones the sand fell through are freed.
+    EXPECT_EQ(grid.ChunkCount(), 2);
+}
+
+TEST(SparseGridTest, ResultMatchesDenseGrid) {
+    constexpr int WIDTH = 150;
+    constexpr int HEIGHT = 100;
+    snaps::Grid dense(WIDTH, HEIGHT);
+    snaps::SparseGrid sparse;
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            const bool isBorder = x == 0 or y == 0 or x == WIDTH - 1 or y == HEIGHT - 1;
+            const int value = percent(random);
+            if (isBorder or value < 3) {
+                dense.At(x, y) = BlockAt(x, y, false);
+                sparse.At(x, y) = BlockAt(x, y, false);
+            } else if (value < 33) {
+                dense.At(x, y) = BlockAt(x, y, true);
+                sparse.At(x, y) = BlockAt(x, y, true);
+            }
+        }
+    }
+
+    snaps::SnapsEngine denseEngine(dense);
+    snaps::SparseSnapsEngine sparseEngine(sparse);
+    denseEngine.StepN(60, DELTA_TIME);
+    sparseEngine.StepN(60, DELTA_TIME);
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            const auto expected = std::as_const(dense).At(x, y);
+            const auto actual = std::as_const(sparse).At(x, y);
+            ASSERT_EQ(expected.has_value(), actual.has_value()) << "at " << x << ", " << y;
+            if (x > 0 and y > 0 and x < WIDTH - 1 and y < HEIGHT - 1) { // Cells outside of the dense grid count as occupied
+                EXPECT_EQ(dense.GetNeighbours(dense.GetIndex(x, y)), sparse.GetNeighbours(sparse.GetIndex(x, y))) << "at " << x << ", " << y;
+            }
+            if (not expected) continue;
+            EXPECT_EQ(expected->WorldPosition.x, actual->WorldPosition.x) << "at " << x << ", " << y;
+            EXPECT_EQ(expected->WorldPosition.y, actual->WorldPosition.y) << "at " << x << ", " << y;
+            EXPECT_EQ(expected->Velocity.x, actual->Velocity.x) << "at " << x << ", " << y;
+            EXPECT_EQ(expected->Velocity.y, actual->Velocity.y) << "at " << x << ", " << y;
+        }
+    }
+}
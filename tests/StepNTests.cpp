@@ -0,0 +1,54 @@
+#include "fixtures/SceneTest.hpp"
+#include <gtest/gtest.h>
+
+struct StepNTest : SceneTest {
+    float DeltaTime() const { return m_Scene->GetDeltaTime(); }
+};
+
+TEST_F(StepNTest, StepNMatchesSingleSteps) {
+    InitializeTestScene(5, 20);
+    AddSand(2, 1);
+    AddSand(2, 2);
+    m_Scene->TickN(30);
+    const snaps::Grid expected = *m_Grid;
+
+    InitializeTestScene(5, 20);
+    AddSand(2, 1);
+    AddSand(2, 2);
+    const auto result = m_Engine->StepN(30, DeltaTime());
+    EXPECT_EQ(result.Steps, 30);
+    EXPECT_FALSE(result.IsAtRest);
+
+    for (std::size_t i = 0; i < m_Grid->Size(); i++) {
+        const auto expectedBlock = std::as_const(expected).At(i);
+        const auto actualBlock = std::as_const(*m_Grid).At(i);
+        ASSERT_EQ(expectedBlock.has_value(), actualBlock.has_value()) << "at index " << i;
+        if (not expectedBlock) continue;
+        EXPECT_EQ(expectedBlock->WorldPosition.y, actualBlock->WorldPosition.y) << "at index " << i;
+        EXPECT_EQ(expectedBlock->Velocity.y, actualBlock->Velocity.y) << "at index " << i;
+    }
+}
+
+TEST_F(StepNTest, StepUntilSettledStopsWhenAllBlocksSleep) {
+    InitializeTestScene(5, 10);
+    AddSand(2, 1);
+
+    const auto result = m_Engine->StepUntilSettled(1000, DeltaTime());
+    EXPECT_TRUE(result.IsAtRest);
+    EXPECT_LT(result.Steps, 1000);
+    EXPECT_TRUE(m_Engine->IsAtRest());
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 8));
+
+    EXPECT_EQ(m_Engine->StepUntilSettled(1000, DeltaTime()).Steps, 0);
+}
+
+TEST_F(StepNTest, StepUntilSettledRunsAllStepsWhenSleepingIsDisabled) {
+    InitializeTestScene(5, 10);
+    m_Engine->GetConfig().SleepAfterSteps = 0;
+    AddSand(2, 1);
+
+    const auto result = m_Engine->StepUntilSettled(200, DeltaTime());
+    EXPECT_EQ(result.Steps, 200);
+    EXPECT_FALSE(result.IsAtRest);
+    EXPECT_SCENE(m_Scene, check::BlockIsAlignedAt(2, 8));
+}
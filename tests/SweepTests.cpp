@@ -0,0 +1,129 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 30.0f;
+constexpr int BOX_MIN = 10;
+constexpr int BOX_MAX = 50;
+
+// A closed box of walls one cell thick, half filled with blocks flying in random directions.
+snaps::Grid MakeBoxOfFastBlocks() {
+    snaps::Grid grid(60, 60);
+    AddRandomBlocks(grid, {
+        .Seed = 5,
+        .X = BOX_MIN,
+        .Y = BOX_MIN,
+        .Width = BOX_MAX - BOX_MIN + 1,
+        .Height = BOX_MAX - BOX_MIN + 1,
+        .Border = RandomBlocks::Edges::Walls,
+        .DynamicPercent = 50,
+        .MaxCellsPerStep = {30.0f, 30.0f},
+        .DeltaTime = DELTA_TIME
+    });
+    return grid;
+}
+
+void ExpectNoBlockEscaped(snaps::SnapsEngine& engine, snaps::Grid& grid) {
+    const std::size_t blockCount = grid.Blocks().Count();
+    for (int step = 0; step < 90; step++) {
+        engine.Step(DELTA_TIME);
+        ASSERT_EQ(grid.Blocks().Count(), blockCount);
+        for (std::size_t i = grid.FindNextDynamic(0, grid.Size()); i < grid.Size(); i = grid.FindNextDynamic(i + 1, grid.Size())) {
+            const auto [x, y] = grid.GetXY(i);
+            ASSERT_TRUE(x > BOX_MIN and x < BOX_MAX and y > BOX_MIN and y < BOX_MAX) << "step " << step;
+            // The block overlaps its cell.
+            const Vector2 position = grid.GetWorldPosition(i);
+            ASSERT_LE(std::abs(position.x - static_cast<float>(x * snaps::BLOCK_SIZE)), snaps::BLOCK_SIZE) << "step " << step;
+            ASSERT_LE(std::abs(position.y - static_cast<float>(y * snaps::BLOCK_SIZE)), snaps::BLOCK_SIZE) << "step " << step;
+        }
+    }
+}
+}
+
+TEST(SweepTest, FastBlocksDontTunnelThroughWalls) {
+    snaps::Grid grid = MakeBoxOfFastBlocks();
+    snaps::SnapsEngine engine(grid);
+    ExpectNoBlockEscaped(engine, grid);
+}
+
+TEST(SweepTest, FastBlocksDontTunnelThroughWallsInFixedPoint) {
+    snaps::Grid grid = MakeBoxOfFastBlocks();
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().FixedPoint = true;
+    ExpectNoBlockEscaped(engine, grid);
+}
+
+TEST(SweepTest, FastBlocksDontTunnelThroughWallsInParallel) {
+    snaps::Grid grid = MakeBoxOfFastBlocks();
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().ParallelStep = true;
+    engine.GetConfig().ThreadCount = 4;
+    ExpectNoBlockEscaped(engine, grid);
+}
+
+TEST(SweepTest, FastBlocksDontTunnelThroughWallsWithTwoPhaseResolution) {
+    snaps::Grid grid = MakeBoxOfFastBlocks();
+    snaps::SnapsEngine engine(grid);
+    engine.GetConfig().TwoPhaseResolution = true;
+    ExpectNoBlockEscaped(engine, grid);
+}
+
+TEST(SweepTest, FastFallStopsRightAboveTheFirstBlockBelow) {
+    for (const bool fixedPoint : {false, true}) {
+        snaps::Grid grid(5, 40);
+        grid.At(2, 20) = snaps::Block { .WorldPosition = {2.0f * snaps::BLOCK_SIZE, 20.0f * snaps::BLOCK_SIZE} };
+        grid.At(2, 2) = snaps::Block {
+            .WorldPosition = {2.0f * snaps::BLOCK_SIZE, 2.0f * snaps::BLOCK_SIZE},
+            .Velocity = {0.0f, 12.0f * snaps::BLOCK_SIZE / DELTA_TIME},
+            .IsDynamic = true
+        };
+        const snaps::BlockId id = grid.GetBlockId(2, 2);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().FixedPoint = fixedPoint;
+
+        engine.Step(DELTA_TIME);
+        const std::optional<std::size_t> cell = grid.Find(id);
+        ASSERT_TRUE(cell.has_value());
+        const auto [x, y] = grid.GetXY(*cell);
+        EXPECT_EQ(x, 2);
+        EXPECT_GT(y, 12) << "fixed point " << fixedPoint;
+        EXPECT_LT(y, 19) << "fixed point " << fixedPoint;
+
+        engine.Step(DELTA_TIME);
+        EXPECT_EQ(grid.Find(id), grid.GetIndex(2, 19)) << "fixed point " << fixedPoint;
+        EXPECT_EQ(grid.At(2, 19)->WorldPosition.y, 19.0f * snaps::BLOCK_SIZE);
+        EXPECT_EQ(grid.At(2, 19)->Velocity.y, 0.0f);
+    }
+}
+
+TEST(SweepTest, BlocksFasterThanTheLimitMoveAsFastAsTheirVelocitySays) {
+    constexpr float maxSpeed = snaps::MAX_CELLS_PER_STEP * snaps::BLOCK_SIZE / DELTA_TIME;
+    for (const bool fixedPoint : {false, true}) {
+        snaps::Grid grid(100, 20);
+        grid.At(2, 2) = snaps::Block {
+            .WorldPosition = {2.0f * snaps::BLOCK_SIZE, 2.0f * snaps::BLOCK_SIZE},
+            .Velocity = {30.0f * snaps::BLOCK_SIZE / DELTA_TIME, 0.0f},
+            .IsDynamic = true
+        };
+        const snaps::BlockId id = grid.GetBlockId(2, 2);
+        snaps::SnapsEngine engine(grid);
+        engine.GetConfig().FixedPoint = fixedPoint;
+
+        float previousX = 2.0f * snaps::BLOCK_SIZE;
+        for (int step = 0; step < 4; step++) {
+            engine.Step(DELTA_TIME);
+            const std::optional<std::size_t> cell = grid.Find(id);
+            ASSERT_TRUE(cell.has_value());
+            const auto [x, y] = grid.GetXY(*cell);
+            const Vector2 position = grid.At(x, y)->WorldPosition;
+            const Vector2 velocity = grid.At(x, y)->Velocity;
+            EXPECT_LE(velocity.x, maxSpeed * 1.001f) << "fixed point " << fixedPoint << ", step " << step;
+            EXPECT_GT(velocity.x, maxSpeed * 0.9f) << "fixed point " << fixedPoint << ", step " << step;
+            EXPECT_NEAR(position.x - previousX, velocity.x * DELTA_TIME, 0.05f * snaps::BLOCK_SIZE)
+                << "fixed point " << fixedPoint << ", step " << step;
+            previousX = position.x;
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#include "utils/TestGrid.hpp"
+#include "snaps/SnapsEngine.hpp"
+#include "snaps/WorldFile.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace {
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+struct WorldFileTest : ::testing::Test {
+    void TearDown() override {
+        std::filesystem::remove(m_Path);
+    }
+
+    // Scattered sand in the middle of falling, so that the engine state is saved too.
+    static snaps::Grid MakeFallingSand(const snaps::GridLayout layout) {
+        snaps::Grid grid(150, 100, layout);
+        const snaps::MaterialId ice = grid.Materials().Add({.Friction = 0.1f});
+        AddRandomBlocks(grid, {.Seed = 5, .StaticPercent = 3, .DynamicPercent = 30, .StaticMaterial = ice});
+        snaps::SnapsEngine(grid).StepN(20, DELTA_TIME);
+        return grid;
+    }
+
+    static void ExpectSameBlocks(const snaps::Grid& expected, const snaps::Grid& actual) {
+        ASSERT_EQ(expected.BlockCount(), actual.BlockCount());
+        for (int y = 0; y < expected.Height(); y++) {
+            for (int x = 0; x < expected.Width(); x++) {
+                const auto expectedBlock = expected.At(x, y);
+                const auto actualBlock = actual.At(x, y);
+                ASSERT_EQ(expectedBlock.has_value(), actualBlock.has_value()) << "at " << x << ", " << y;
+                EXPECT_EQ(expected.GetNeighbours(expected.GetIndex(x, y)), actual.GetNeighbours(actual.GetIndex(x, y))) << "at " << x << ", " << y;
+                if (not expectedBlock) continue;
+                EXPECT_EQ(expectedBlock->WorldPosition.x, actualBlock->WorldPosition.x) << "at " << x << ", " << y;
+                EXPECT_EQ(expectedBlock->WorldPosition.y, actualBlock->WorldPosition.y) << "at " << x << ", " << y;
+                EXPECT_EQ(expectedBlock->Velocity.y, actualBlock->Velocity.y) << "at " << x << ", " << y;
+                EXPECT_EQ(expectedBlock->Material, actualBlock->Material) << "at " << x << ", " << y;
+                EXPECT_EQ(expectedBlock->IsSleeping, actualBlock->IsSleeping) << "at " << x << ", " << y;
+            }
+        }
+    }
+
+    const std::filesystem::path m_Path = std::filesystem::temp_directory_path() / "SnapsWorldFileTest.world";
+};
+}
+
+TEST_F(WorldFileTest, LoadedWorldContinuesLikeTheSavedOne) {
+    for (const snaps::GridLayout layout : {snaps::GridLayout::RowMajor, snaps::GridLayout::Morton}) {
+        snaps::Grid saved = MakeFallingSand(layout);
+        ASSERT_TRUE(snaps::WorldFile::Save(saved, m_Path));
+
+        std::optional<snaps::Grid> loaded = snaps::WorldFile::Load(m_Path);
+        ASSERT_TRUE(loaded.has_value());
+        EXPECT_EQ(loaded->Layout(), layout);
+        EXPECT_EQ(loaded->Materials().Size(), 2);
+        EXPECT_EQ(loaded->Materials()[1].Friction, 0.1f);
+        ExpectSameBlocks(saved, *loaded);
+
+        snaps::SnapsEngine(saved).StepN(40, DELTA_TIME);
+        snaps::SnapsEngine(*loaded).StepN(40, DELTA_TIME);
+        ExpectSameBlocks(saved, *loaded);
+    }
+}
+
+TEST_F(WorldFileTest, BlockIdsSurviveSaving) {
+    snaps::Grid grid(10, 10);
+    grid.At(1, 1) = snaps::Block { .IsDynamic = true };
+    grid.At(2, 1) = snaps::Block { .IsDynamic = true };
+    grid.Remove(1, 1);
+    grid.At(3, 1) = snaps::Block { .IsDynamic = true };
+    const snaps::BlockId id = grid.GetBlockId(3, 1);
+    ASSERT_TRUE(snaps::WorldFile::Save(grid, m_Path));
+
+    std::optional<snaps::Grid> loaded = snaps::WorldFile::Load(m_Path);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->Find(id), loaded->GetIndex(3, 1));
+    EXPECT_EQ(loaded->GetBlockId(2, 1), grid.GetBlockId(2, 1));
+}
+
+TEST_F(WorldFileTest, RejectsDamagedAndForeignFiles) {
+    EXPECT_FALSE(snaps::WorldFile::Load(m_Path).has_value());
+
+    ASSERT_TRUE(snaps::WorldFile::Save(MakeFallingSand(snaps::GridLayout::RowMajor), m_Path));
+    const auto size = std::filesystem::file_size(m_Path);
+    std::filesystem::resize_file(m_Path, size - 1);
+    EXPECT_FALSE(snaps::WorldFile::Load(m_Path).has_value());
+
+    ASSERT_TRUE(snaps::WorldFile::Save(MakeFallingSand(snaps::GridLayout::RowMajor), m_Path));
+    {
+        std::fstream file(m_Path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(8); // Version
+        const std::uint32_t version = snaps::WorldFile::VERSION + 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    EXPECT_FALSE(snaps::WorldFile::Load(m_Path).has_value());
+}
+
+TEST_F(WorldFileTest, RejectsSectionsThatContradictEachOther) {
+    snaps::Grid grid(10, 10);
+    const snaps::MaterialId ice = grid.Materials().Add({.Friction = 0.1f});
+    grid.At(1, 1) = snaps::Block { .Material = ice };
+    grid.At(2, 1) = snaps::Block { .IsDynamic = true };
+    grid.At(3, 1) = snaps::Block { .IsDynamic = true };
+    grid.At(4, 1) = snaps::Block { .IsDynamic = true };
+    grid.Remove(3, 1);
+    const std::size_t terrainCell = grid.GetIndex(1, 1);
+    const std::size_t cell = grid.GetIndex(2, 1);
+    const std::uint32_t slot = grid.GetSlot(cell);
+    const std::uint32_t freeSlot = grid.GetSlot(grid.GetIndex(4, 1)) == 2 ? 1 : 2;
+    ASSERT_TRUE(grid.HasDirtyRects());
+
+    // Overwrites an element of a section of a saved copy of the grid, sections are listed after the header.
+    enum Section { SLOTS = 1, TERRAIN_MATERIALS = 2, DYNAMIC_BITS = 4, DIRTY_RECTS = 7, DIRTY_CHUNKS = 8,
+                   POSITIONS = 9, MATERIALS = 11, FLAGS = 12, CELLS = 19, FREE_SLOTS = 21 };
+    const auto expectRejected = [&](const Section section, const std::size_t offset, const auto value) {
+        ASSERT_TRUE(snaps::WorldFile::Save(grid, m_Path));
+        ASSERT_TRUE(snaps::WorldFile::Load(m_Path).has_value());
+        {
+            std::fstream file(m_Path, std::ios::binary | std::ios::in | std::ios::out);
+            std::uint64_t sectionOffset;
+            file.seekg(40 + section * 2 * sizeof(std::uint64_t));
+            file.read(reinterpret_cast<char*>(&sectionOffset), sizeof(sectionOffset));
+            file.seekp(static_cast<std::streamoff>(sectionOffset + offset * sizeof(value)));
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        EXPECT_FALSE(snaps::WorldFile::Load(m_Path).has_value()) << "section " << section << " at " << offset;
+    };
+
+    expectRejected(SLOTS, cell, std::uint32_t{1000}); // Past the pool
+    expectRejected(SLOTS, cell, freeSlot);
+    expectRejected(CELLS, slot, std::size_t{0}); // Not the cell of the block
+    expectRejected(CELLS, freeSlot, cell);
+    expectRejected(FREE_SLOTS, 0, std::uint32_t{1000});
+    expectRejected(FREE_SLOTS, 0, slot);
+    expectRejected(MATERIALS, slot, snaps::MaterialId{200});
+    expectRejected(TERRAIN_MATERIALS, terrainCell, snaps::MaterialId{200});
+    expectRejected(FLAGS, slot, std::uint8_t{2});
+    expectRejected(DYNAMIC_BITS, 0, std::uint64_t{1}); // An empty cell
+    expectRejected(POSITIONS, slot, Vector2{NAN, 0.0f});
+    expectRejected(DIRTY_CHUNKS, 0, std::size_t{1000});
+    expectRejected(DIRTY_RECTS, 0, snaps::Grid::DirtyRect{0, 0, 10, 5}); // Outside of the grid
+}
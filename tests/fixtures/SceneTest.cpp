@@ -4,13 +4,10 @@
 #include "GlobalConfiguration.hpp"
 
 namespace {
-constexpr Color SAND_COLOR = { 194, 178, 128, 255 };
-constexpr Color STONE_COLOR = {128, 128, 128, 255};
-
 snaps::Block SandBlock(const int x, const int y) {
     return snaps::Block {
         .WorldPosition = {static_cast<float>(x), static_cast<float>(y)},
-        .FillColor = SAND_COLOR,
+        .Material = materials::SAND,
         .IsDynamic = true
     };
 }
@@ -18,7 +15,7 @@ snaps::Block SandBlock(const int x, const int y) {
 snaps::Block StoneBlock(const int x, const int y) {
     return snaps::Block {
         .WorldPosition = {static_cast<float>(x), static_cast<float>(y)},
-        .FillColor = STONE_COLOR,
+        .Material = materials::STONE,
         .IsDynamic = false
     };
 }
@@ -29,8 +26,8 @@ std::string GetTestName() {
 }
 }
 
-void SceneTest::InitializeTestScene(const int gridWidth, const int gridHeight) {
-    m_Grid = std::make_unique<snaps::Grid>(MakeTestGrid(gridWidth, gridHeight));
+void SceneTest::InitializeTestScene(const int gridWidth, const int gridHeight, const snaps::GridLayout layout) {
+    m_Grid = std::make_unique<snaps::Grid>(MakeTestGrid(gridWidth, gridHeight, layout));
     m_Engine = std::make_unique<snaps::SnapsEngine>(*m_Grid);
     m_Scene = std::make_unique<TestScene>(*m_Engine, *m_Grid);
 
@@ -53,22 +50,34 @@ void SceneTest::TearDown() {
 }
 
 void SceneTest::AddSand(const int x, const int y) const {
-    auto& block = GetBlockOpt(x, y);
+    auto block = GetBlockOpt(x, y);
     block = SandBlock(x * snaps::BLOCK_SIZE, y * snaps::BLOCK_SIZE);
 }
 
 void SceneTest::AddWall(int x, int y) const {
-    auto& block = GetBlockOpt(x, y);
+    auto block = GetBlockOpt(x, y);
     block = StoneBlock(x * snaps::BLOCK_SIZE, y * snaps::BLOCK_SIZE);
 }
 
-snaps::Block & SceneTest::GetBlock(const int x, const int y) const {
-    auto& blockOpt = GetBlockOpt(x, y);
+void SceneTest::SetFriction(const int x, const int y, const float friction) const {
+    snaps::Material material = m_Grid->Materials()[GetBlock(x, y).Material];
+    material.Friction = friction;
+    GetBlock(x, y).Material = m_Grid->Materials().Add(material);
+}
+
+void SceneTest::SetInvMass(const int x, const int y, const float invMass) const {
+    snaps::Material material = m_Grid->Materials()[GetBlock(x, y).Material];
+    material.InvMass = invMass;
+    GetBlock(x, y).Material = m_Grid->Materials().Add(material);
+}
+
+snaps::BlockRef SceneTest::GetBlock(const int x, const int y) const {
+    auto blockOpt = GetBlockOpt(x, y);
     assert(blockOpt.has_value());
     return blockOpt.value();
 }
 
-std::optional<snaps::Block>& SceneTest::GetBlockOpt(const int x, const int y) const {
+snaps::Grid::Cell SceneTest::GetBlockOpt(const int x, const int y) const {
     assert(m_Grid);
     assert(x >= 0 and x < m_Grid->Width());
     assert(y >= 0 and y < m_Grid->Height());
@@ -5,12 +5,15 @@
 #include <gtest/gtest.h>
 
 struct SceneTest : ::testing::Test {
-    void InitializeTestScene(int gridWidth, int gridHeight);
+    void InitializeTestScene(int gridWidth, int gridHeight, snaps::GridLayout layout = snaps::GridLayout::RowMajor);
     void TearDown() override;
     void AddSand(int x, int y) const;
     void AddWall(int x, int y) const;
-    snaps::Block& GetBlock(int x, int y) const;
-    std::optional<snaps::Block>& GetBlockOpt(int x, int y) const;
+    // Gives the block its own material, a copy of the current one with the property changed.
+    void SetFriction(int x, int y, float friction) const;
+    void SetInvMass(int x, int y, float invMass) const;
+    snaps::BlockRef GetBlock(int x, int y) const;
+    snaps::Grid::Cell GetBlockOpt(int x, int y) const;
 
     std::unique_ptr<snaps::Grid> m_Grid;
     std::unique_ptr<snaps::SnapsEngine> m_Engine;
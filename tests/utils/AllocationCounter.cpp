@@ -0,0 +1,26 @@
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<std::size_t> allocationCount = 0;
+}
+
+std::size_t GetAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+// Array and nothrow versions of the operators forward to these ones by default.
+// Over-aligned allocations are not counted. Nothing in the engine uses over-aligned types.
+void* operator new(const std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Number of heap allocations made by the whole test process so far, from any thread.
+// Counted by the replaced global operator new, see AllocationCounter.cpp.
+std::size_t GetAllocationCount();
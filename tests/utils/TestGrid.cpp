@@ -1,7 +1,9 @@
 #include "TestGrid.hpp"
+#include <random>
 
 namespace {
 constexpr Color STONE_COLOR = {128, 128, 128, 255};
+constexpr Color SAND_COLOR = {194, 178, 128, 255};
 
 snaps::Block CopyAtPos(snaps::Block block, int x, int y) {
     block.WorldPosition = {static_cast<float>(x) * snaps::BLOCK_SIZE, static_cast<float>(y) * snaps::BLOCK_SIZE};
@@ -22,12 +24,51 @@ void AddBorder(snaps::Grid& grid, const snaps::Block& block) {
 }
 }
 
-snaps::Grid MakeTestGrid(const int width, const int height) {
-    snaps::Grid grid(width, height);
+snaps::Block BlockAt(const int x, const int y, const bool isDynamic, const Vector2 velocity) {
+    return snaps::Block {
+        .WorldPosition = {static_cast<float>(x * snaps::BLOCK_SIZE), static_cast<float>(y * snaps::BLOCK_SIZE)},
+        .Velocity = velocity,
+        .IsDynamic = isDynamic
+    };
+}
+
+snaps::Grid MakeTestGrid(const int width, const int height, const snaps::GridLayout layout) {
+    snaps::Grid grid(width, height, layout);
+    [[maybe_unused]] const snaps::MaterialId stone = grid.Materials().Add({.FillColor = STONE_COLOR});
+    [[maybe_unused]] const snaps::MaterialId sand = grid.Materials().Add({.FillColor = SAND_COLOR});
+    assert(stone == materials::STONE and sand == materials::SAND);
+
     snaps::Block block{
-        .FillColor = STONE_COLOR,
+        .Material = materials::STONE,
         .IsDynamic = false
     };
     AddBorder(grid, block);
     return grid;
 }
+
+std::vector<snaps::BlockId> AddRandomBlocks(snaps::Grid& grid, const RandomBlocks& blocks) {
+    const int endX = blocks.Width > 0 ? blocks.X + blocks.Width : grid.Width();
+    const int endY = blocks.Height > 0 ? blocks.Y + blocks.Height : grid.Height();
+    std::mt19937 random(blocks.Seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const Vector2 maxVelocity = blocks.MaxCellsPerStep * (snaps::BLOCK_SIZE / blocks.DeltaTime);
+    std::vector<snaps::BlockId> ids;
+    for (int y = blocks.Y; y < endY; y++) {
+        for (int x = blocks.X; x < endX; x++) {
+            const bool isFloor = blocks.Border != RandomBlocks::Edges::None and y == endY - 1;
+            const bool isWall = blocks.Border == RandomBlocks::Edges::Walls and (x == blocks.X or x == endX - 1 or y == blocks.Y);
+            const int value = isFloor or isWall ? 0 : percent(random);
+            if (isFloor or isWall or value < blocks.StaticPercent) {
+                snaps::Block block = BlockAt(x, y, false);
+                block.Material = blocks.StaticMaterial;
+                grid.At(x, y) = block;
+            } else if (value < blocks.StaticPercent + blocks.DynamicPercent) {
+                const Vector2 velocity = {unit(random) * maxVelocity.x, unit(random) * maxVelocity.y};
+                grid.At(x, y) = BlockAt(x, y, true, velocity);
+                ids.push_back(grid.GetBlockId(x, y));
+            }
+        }
+    }
+    return ids;
+}
@@ -1,5 +1,34 @@
 #pragma once
 
 #include "snaps/Grid.hpp"
+#include <vector>
 
-snaps::Grid MakeTestGrid(int width, int height);
+// Materials available in every test grid.
+namespace materials {
+constexpr snaps::MaterialId STONE = 1;
+constexpr snaps::MaterialId SAND = 2;
+}
+
+// Block at the start of the cell, e.g. to be placed into the same cell of a grid.
+snaps::Block BlockAt(int x, int y, bool isDynamic, Vector2 velocity = {0.0f, 0.0f});
+
+snaps::Grid MakeTestGrid(int width, int height, snaps::GridLayout layout = snaps::GridLayout::RowMajor);
+
+// Blocks placed at random into an area of a grid, see AddRandomBlocks().
+struct RandomBlocks {
+    unsigned Seed = 1;
+    int X = 0; // Top left cell of the area
+    int Y = 0;
+    int Width = 0; // Zero for the rest of the grid
+    int Height = 0;
+    enum class Edges { None, Floor, Walls };
+    Edges Border = Edges::None; // Static blocks along the bottom or all edges of the area
+    int StaticPercent = 0; // Chance of a cell to get a static block
+    int DynamicPercent = 0; // Chance of a cell to get a dynamic block
+    Vector2 MaxCellsPerStep = {0.0f, 0.0f}; // Dynamic blocks get a random velocity up to this speed along each axis
+    float DeltaTime = 1.0f / 60.0f; // Of the steps the speed is given for
+    snaps::MaterialId StaticMaterial = snaps::MaterialTable::DEFAULT;
+};
+
+// Returns the ids of the dynamic blocks, in the order they were placed.
+std::vector<snaps::BlockId> AddRandomBlocks(snaps::Grid& grid, const RandomBlocks& blocks);
@@ -2,6 +2,7 @@
 #include "GridCheckers.hpp"
 #include "snaps/Grid.hpp"
 #include "snaps/SnapsEngine.hpp"
+#include <deque>
 #include <map>
 
 #define EXPECT_SCENE(scene, checker) (scene)->AddCheck((checker), __FILE__, __LINE__, false)
@@ -189,10 +189,11 @@ void TestScenePreview::DrawFramePreview() {
         DrawPixelGrid(gridWidth, gridHeight, Color{40, 40, 40, 255});
     }
 
-    for (const auto& block: grid.Data()) {
+    for (std::size_t i = 0; i < grid.Size(); i++) {
+        const auto block = grid.At(i);
         if (block.has_value()) {
             auto [x, y] = ToWindowCoordinates(*block);
-            DrawRectangle(x, y, snaps::BLOCK_SIZE, snaps::BLOCK_SIZE, block->FillColor);
+            DrawRectangle(x, y, snaps::BLOCK_SIZE, snaps::BLOCK_SIZE, grid.Materials()[block->Material].FillColor);
         }
     }
 
@@ -388,7 +389,7 @@ void TestScenePreview::ShowReplayButtons() {
     GuiDrawTextWithBg(TextFormat("%.3f s", timeSinceStartInMs), textRect, TEXT_ALIGN_CENTER, WHITE);
 }
 
-static std::vector<std::pair<std::string, std::string> > GetInspectData(const std::optional<snaps::Block>& block) {
+static std::vector<std::pair<std::string, std::string> > GetInspectData(const std::optional<snaps::Block>& block, const snaps::MaterialTable& materials) {
     if (not block.has_value()) return {std::make_pair("Empty", "")};
 
     auto formatFloat = [](const float value) {
@@ -405,18 +406,21 @@ static std::vector<std::pair<std::string, std::string> > GetInspectData(const st
     result.emplace_back("WorldPosition", formatVector(block->WorldPosition));
     result.emplace_back("Velocity", formatVector(block->Velocity));
     result.emplace_back("IsDynamic", formatBool(block->IsDynamic));
-    result.emplace_back("InvMass", formatFloat(block->InvMass));
-    result.emplace_back("Friction", formatFloat(block->Friction));
+    result.emplace_back("Material", std::to_string(block->Material));
+    result.emplace_back("InvMass", formatFloat(materials[block->Material].InvMass));
+    result.emplace_back("Friction", formatFloat(materials[block->Material].Friction));
     result.emplace_back("Acceleration", formatVector(block->Acceleration));
+    result.emplace_back("IsSleeping", formatBool(block->IsSleeping));
     return result;
 }
 
 void TestScenePreview::ShowTileInspection() {
     if (not m_SelectedGridPosition) return;
 
-    const std::optional<snaps::Block>& block = GetSelectedGrid().At(m_SelectedGridPosition->first, m_SelectedGridPosition->second);
+    const snaps::Grid& grid = GetSelectedGrid();
+    const std::optional<snaps::Block>& block = grid.At(m_SelectedGridPosition->first, m_SelectedGridPosition->second);
 
-    const std::vector<std::pair<std::string, std::string> > inspectData = GetInspectData(block);
+    const std::vector<std::pair<std::string, std::string> > inspectData = GetInspectData(block, grid.Materials());
 
     Rectangle inspectPanelRect = {
         .x = 10,